@@ -1,9 +1,13 @@
 #pragma once
 
+#include <atomic>
 #include <iterator>
+#include <tuple>
+#include <utility>
 #include <vector>
 #include "Try.h"
 #include "Future.h"
+#include "Promise.h"
 
 namespace async_framework
 {
@@ -49,37 +53,339 @@ namespace async_framework
             results.reserve(n);
             for (auto iter = begin; iter != end; ++iter)
             {
-                results.push_back(std::move(iter->results()));
+                results.push_back(std::move(iter->result()));
             }
             return Future<std::vector<Try<T>>>(std::move(results));
         }
 
         Promise<std::vector<Try<T>>> promise;
         auto future = promise.getFuture();
-        // 使用共享指针，回调，在析构函数里面setValue。
-        // 使用共享指针管理Context，只有所有features都设置了value, Context才会销毁，然后
-        // 在析构函数里面设置值。
+        // Context只分配一次，pending是还没有结果的Future数加上当前函数自己，
+        // 减到0时在析构函数里面setValue。
         struct Context
         {
-            Context(size_t n, Promise<std::vector<Try<T>>> p_) : results(n), p(std::move(p_)) {}
+            Context(size_t n, Promise<std::vector<Try<T>>> p_) : results(n), p(std::move(p_)), pending(n + 1) {}
             ~Context() { p.setValue(std::move(results)); }
+            void release()
+            {
+                if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete this;
+                }
+            }
             std::vector<Try<T>> results;
             Promise<std::vector<Try<T>>> p;
+            std::atomic<size_t> pending;
         };
 
-        auto ctx = std::make_shared<Context>(n, std::move(promise));
+        auto ctx = new Context(n, std::move(promise));
         for (size_t i = 0; i < n; ++i, ++begin)
         {
             if (begin->hasResult())
             {
                 ctx->results[i] = std::move(begin->result());
+                ctx->release();
+            }
+            else
+            {
+                begin->setContinuation([ctx, i](Try<T> &&t) mutable
+                                       {
+                    ctx->results[i] = std::move(t);
+                    ctx->release(); });
+            }
+        }
+        ctx->release();
+        return future;
+    }
+
+    // collectAll - the variadic version, for futures of different types.
+    //
+    // For `Future<T1>, Future<T2>, ...`, the return type is
+    // `Future<std::tuple<Try<T1>, Try<T2>, ...>>`.
+    //
+    // e.g. auto [x, y] = collectAll(std::move(intFuture), std::move(floatFuture)).get();
+    template <typename... Ts>
+    inline Future<std::tuple<Try<Ts>...>> collectAll(Future<Ts> &&...futures)
+    {
+        using Result = std::tuple<Try<Ts>...>;
+
+        Promise<Result> promise;
+        auto future = promise.getFuture();
+        struct Context
+        {
+            explicit Context(Promise<Result> p_) : p(std::move(p_)), pending(sizeof...(Ts) + 1) {}
+            ~Context() { p.setValue(std::move(results)); }
+            void release()
+            {
+                if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete this;
+                }
+            }
+            Result results;
+            Promise<Result> p;
+            std::atomic<size_t> pending;
+        };
+
+        auto ctx = new Context(std::move(promise));
+        auto collectOne = [ctx]<size_t I, typename T>(std::integral_constant<size_t, I>, Future<T> &f)
+        {
+            if (f.hasResult())
+            {
+                std::get<I>(ctx->results) = std::move(f.result());
+                ctx->release();
+            }
+            else
+            {
+                f.setContinuation([ctx](Try<T> &&t) mutable
+                                  {
+                    std::get<I>(ctx->results) = std::move(t);
+                    ctx->release(); });
+            }
+        };
+        [&]<size_t... Is>(std::index_sequence<Is...>)
+        {
+            (collectOne(std::integral_constant<size_t, Is>{}, futures), ...);
+        }(std::index_sequence_for<Ts...>{});
+        ctx->release();
+        return future;
+    }
+
+    // collectAny - get the first result of a range of futures.
+    //
+    // The returned future has the index of the first future that got a
+    // result, together with that result (a value or an exception). The
+    // results of the other futures are dropped. The range must not be empty.
+    template <std::input_iterator Iterator>
+    inline Future<std::pair<size_t, Try<typename std::iterator_traits<Iterator>::value_type::value_type>>>
+    collectAny(Iterator begin, Iterator end)
+    {
+        using T = typename std::iterator_traits<Iterator>::value_type::value_type;
+        using Result = std::pair<size_t, Try<T>>;
+        size_t n = std::distance(begin, end);
+        logicAssert(n > 0, "collectAny on an empty range");
+
+        for (auto iter = begin; iter != end; ++iter)
+        {
+            if (iter->hasResult())
+            {
+                return Future<Result>(Result(std::distance(begin, iter), std::move(iter->result())));
+            }
+        }
+
+        Promise<Result> promise;
+        auto future = promise.getFuture();
+        // 第一个完成的Future设置结果，最后一个释放Context
+        struct Context
+        {
+            Context(size_t n, Promise<Result> p_) : p(std::move(p_)), pending(n) {}
+            void release()
+            {
+                if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete this;
+                }
+            }
+            Promise<Result> p;
+            std::atomic<bool> done{false};
+            std::atomic<size_t> pending;
+        };
+
+        auto ctx = new Context(n, std::move(promise));
+        for (size_t i = 0; i < n; ++i, ++begin)
+        {
+            begin->setContinuation([ctx, i](Try<T> &&t) mutable
+                                   {
+                if (!ctx->done.exchange(true, std::memory_order_acq_rel))
+                {
+                    ctx->p.setValue(Try<Result>(Result(i, std::move(t))));
+                }
+                ctx->release(); });
+        }
+        return future;
+    }
+
+    // collectN - collect the first n results of a range of futures.
+    //
+    // The returned future has the first n results in the order they arrived,
+    // each paired with the index of its future. It gets its value as soon as
+    // n futures have a result; the later results are dropped. n must not be
+    // larger than the size of the range.
+    template <std::input_iterator Iterator>
+    inline Future<std::vector<std::pair<size_t, Try<typename std::iterator_traits<Iterator>::value_type::value_type>>>>
+    collectN(Iterator begin, Iterator end, size_t n)
+    {
+        using T = typename std::iterator_traits<Iterator>::value_type::value_type;
+        using Result = std::vector<std::pair<size_t, Try<T>>>;
+        size_t total = std::distance(begin, end);
+        logicAssert(n <= total, "collectN needs at least n futures");
+        if (n == 0)
+        {
+            return Future<Result>(Result());
+        }
+
+        Promise<Result> promise;
+        auto future = promise.getFuture();
+        // arrived给每个结果分配位置，stored数到n的那个结果负责setValue
+        struct Context
+        {
+            Context(size_t total, size_t n_, Promise<Result> p_) : n(n_), results(n_), p(std::move(p_)), pending(total + 1) {}
+            void collect(size_t i, Try<T> &&t)
+            {
+                auto slot = arrived.fetch_add(1, std::memory_order_relaxed);
+                if (slot < n)
+                {
+                    results[slot] = std::make_pair(i, std::move(t));
+                    if (stored.fetch_add(1, std::memory_order_acq_rel) + 1 == n)
+                    {
+                        p.setValue(std::move(results));
+                    }
+                }
+                release();
+            }
+            void release()
+            {
+                if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete this;
+                }
+            }
+            const size_t n;
+            Result results;
+            Promise<Result> p;
+            std::atomic<size_t> arrived{0};
+            std::atomic<size_t> stored{0};
+            std::atomic<size_t> pending;
+        };
+
+        auto ctx = new Context(total, n, std::move(promise));
+        for (size_t i = 0; i < total; ++i, ++begin)
+        {
+            if (begin->hasResult())
+            {
+                ctx->collect(i, std::move(begin->result()));
             }
             else
             {
                 begin->setContinuation([ctx, i](Try<T> &&t) mutable
-                                       { ctx->results[i] = std::move(t); });
+                                       { ctx->collect(i, std::move(t)); });
             }
         }
+        ctx->release();
+        return future;
+    }
+
+    // collectAllWindowed - like collectAll, but for a range of callables
+    // that start a task and return its `Future<T>`.
+    //
+    // At most maxConcurrency of the callables are started at once. Each time
+    // a future gets a result, the next callable is started from the thread
+    // that completed it. An exception thrown by a callable becomes the result
+    // of its task. The returned future is `Future<std::vector<Try<T>>>`, in
+    // the order of the range.
+    //
+    // The range is not copied, so it must stay valid until the returned
+    // future has a result.
+    //
+    // e.g. std::vector<std::function<Future<int>()>> tasks = ...;
+    //      auto results = collectAllWindowed(8, tasks.begin(), tasks.end()).get();
+    template <std::random_access_iterator Iterator>
+    inline auto collectAllWindowed(size_t maxConcurrency, Iterator begin, Iterator end)
+    {
+        using F = typename std::iterator_traits<Iterator>::value_type;
+        using T = typename IsFuture<std::invoke_result_t<F &>>::Inner;
+        static_assert(IsFuture<std::invoke_result_t<F &>>::value, "collectAllWindowed needs callables that return a Future");
+        using Result = std::vector<Try<T>>;
+        size_t n = std::distance(begin, end);
+        if (n == 0)
+        {
+            return Future<Result>(Result());
+        }
+        if (maxConcurrency == 0 || maxConcurrency > n)
+        {
+            maxConcurrency = n;
+        }
+
+        Promise<Result> promise;
+        auto future = promise.getFuture();
+        struct Context
+        {
+            Context(Iterator begin_, size_t n, size_t window, Promise<Result> p_)
+                : begin(begin_), total(n), results(n), p(std::move(p_)), next(window), pending(n + 1)
+            {
+            }
+            ~Context() { p.setValue(std::move(results)); }
+
+            // 就绪的Future在循环里直接处理，避免一长串就绪的任务递归过深。
+            // release()之后只有还有任务没完成时才能继续访问Context。
+            void start(size_t i)
+            {
+                for (;;)
+                {
+                    auto f = launch(i);
+                    if (!f.hasResult())
+                    {
+                        f.setContinuation([this, i](Try<T> &&t) mutable
+                                          { complete(i, std::move(t)); });
+                        return;
+                    }
+                    results[i] = std::move(f.result());
+                    i = next.fetch_add(1, std::memory_order_relaxed);
+                    bool more = i < total;
+                    release();
+                    if (!more)
+                    {
+                        return;
+                    }
+                }
+            }
+
+            void complete(size_t i, Try<T> &&t)
+            {
+                results[i] = std::move(t);
+                auto j = next.fetch_add(1, std::memory_order_relaxed);
+                bool more = j < total;
+                release();
+                if (more)
+                {
+                    start(j);
+                }
+            }
+
+            Future<T> launch(size_t i)
+            {
+                try
+                {
+                    return begin[i]();
+                }
+                catch (...)
+                {
+                    return makeReadyFuture<T>(std::current_exception());
+                }
+            }
+
+            void release()
+            {
+                if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete this;
+                }
+            }
+
+            Iterator begin;
+            size_t total;
+            Result results;
+            Promise<Result> p;
+            std::atomic<size_t> next;
+            std::atomic<size_t> pending;
+        };
+
+        auto ctx = new Context(begin, n, maxConcurrency, std::move(promise));
+        for (size_t i = 0; i < maxConcurrency; ++i)
+        {
+            ctx->start(i);
+        }
+        ctx->release();
         return future;
     }
 
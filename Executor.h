@@ -4,18 +4,35 @@
 #include <cstdint>
 #include <functional>
 #include <ratio>
+#include <span>
 #include <string>
 #include <thread>
 #include <coroutine>
+#include <vector>
 #include "MoveWrapper.h"
-#include "move_only_function.h"
+#include "util/move_only_function.h"
+#include "util/WorkerStat.h"
 
 namespace async_framework
 {
     // executor的状态信息，保存了executor中等待执行的任务数
+    //
+    // Executors that track per-worker statistics also fill the executed and
+    // steal counters and `workers`, one entry per worker with its queue depth
+    // and HDR-style histograms of queueing latency and run time. Executors
+    // that don't leave them zero/empty.
+    //
+    // Elastic executors report their current and peak thread count and how
+    // many compensating threads were started for blocked workers.
     struct ExecutorStat
     {
         size_t pendingTaskCount = 0;
+        uint64_t executedTaskCount = 0;
+        uint64_t stealCount = 0;
+        size_t threadNum = 0;
+        size_t peakThreadNum = 0;
+        uint64_t compensateCount = 0;
+        std::vector<util::WorkerStat> workers;
         ExecutorStat() = default;
     };
 
@@ -64,6 +81,10 @@ namespace async_framework
         // The schedulable function. Func should accept no argument and
         // return void.
         using Func = std::function<void()>;
+        // The move-only task of the allocation-free schedule path. Closures
+        // no larger than util::kTaskInlineSize bytes (configured by
+        // ASYNC_FRAMEWORK_TASK_INLINE_SIZE) are stored inline.
+        using TaskFunc = util::TaskFunc;
         class TimeAwaitable;
         class TimeAwaiter;
 
@@ -105,23 +126,115 @@ namespace async_framework
         // can't always execute the work immediately when other works are
         // waiting.
 
-        virtual bool schedule(Func func, uint64_t schedule_info)
+        // Bits [4, 12) of schedule_info carry an optional NUMA node hint,
+        // encoded as node + 1 so that 0 means no preference. Executors
+        // without NUMA support ignore it.
+        static constexpr uint64_t kNodeHintShift = 4;
+        static constexpr uint64_t kNodeHintMask = uint64_t(0xFF) << kNodeHintShift;
+
+        static constexpr uint64_t nodeHint(uint32_t node)
+        {
+            return (uint64_t(node + 1) << kNodeHintShift) & kNodeHintMask;
+        }
+        // 返回schedule_info中的node编号，没有指定时返回-1
+        static constexpr int32_t nodeOfHint(uint64_t schedule_info)
+        {
+            return static_cast<int32_t>((schedule_info & kNodeHintMask) >> kNodeHintShift) - 1;
+        }
+
+        virtual bool schedule(Func func, [[maybe_unused]] uint64_t schedule_info)
         {
             return schedule(std::move(func));
         }
 
-        bool schedule_move_only(util::move_only_function<void()> func)
+        // Schedule a move-only task. Executors that can queue TaskFunc
+        // directly should override scheduleTask to avoid wrapping it into a
+        // Func; the default implementation wraps it and calls schedule.
+        bool scheduleTask(TaskFunc task)
+        {
+            return scheduleTask(std::move(task), static_cast<uint64_t>(Priority::DEFAULT));
+        }
+
+        virtual bool scheduleTask(TaskFunc task, uint64_t schedule_info)
+        {
+            MoveWrapper<TaskFunc> tmp(std::move(task));
+            return schedule([task = tmp]()
+                            { task.get()(); },
+                            schedule_info);
+        }
+
+        // Resume a coroutine in the executor. This is the fast path for
+        // coroutine resumption, an executor may queue the handle itself
+        // without any wrapper.
+        bool scheduleHandle(std::coroutine_handle<> handle)
+        {
+            return scheduleHandle(handle, static_cast<uint64_t>(Priority::DEFAULT));
+        }
+
+        virtual bool scheduleHandle(std::coroutine_handle<> handle, uint64_t schedule_info)
+        {
+            return schedule([handle]()
+                            { handle.resume(); },
+                            schedule_info);
+        }
+
+        // Schedule a task so that tasks with the same key run one at a time in
+        // submission order, without a lock per key. Executors pin each key to
+        // one worker (or run everything in order) and do not steal keyed
+        // tasks; tasks without a key are unaffected. Executors that cannot
+        // keep the order throw.
+        bool scheduleByKey(uint64_t key, TaskFunc task)
+        {
+            return scheduleByKey(key, std::move(task), static_cast<uint64_t>(Priority::DEFAULT));
+        }
+
+        virtual bool scheduleByKey([[maybe_unused]] uint64_t key, [[maybe_unused]] TaskFunc task, [[maybe_unused]] uint64_t schedule_info)
+        {
+            throw std::logic_error("Not implemented");
+        }
+
+        // Schedule a batch of functions. Executors may override it to enqueue
+        // the whole batch under one lock and wake workers once; the default
+        // schedules them one by one. Return the number of leading functions
+        // that were scheduled, the caller is responsible for the rest.
+        size_t scheduleBatch(std::span<Func> funcs)
+        {
+            return scheduleBatch(funcs, static_cast<uint64_t>(Priority::DEFAULT));
+        }
+
+        virtual size_t scheduleBatch(std::span<Func> funcs, uint64_t schedule_info)
+        {
+            size_t scheduled = 0;
+            // 传副本，调度失败时funcs中的函数仍然有效
+            while (scheduled < funcs.size() && schedule(funcs[scheduled], schedule_info))
+                scheduled++;
+            return scheduled;
+        }
+
+        // The coroutine handle variant of scheduleBatch.
+        size_t scheduleHandleBatch(std::span<const std::coroutine_handle<>> handles)
+        {
+            return scheduleHandleBatch(handles, static_cast<uint64_t>(Priority::DEFAULT));
+        }
+
+        virtual size_t scheduleHandleBatch(std::span<const std::coroutine_handle<>> handles, uint64_t schedule_info)
+        {
+            size_t scheduled = 0;
+            while (scheduled < handles.size() && scheduleHandle(handles[scheduled], schedule_info))
+                scheduled++;
+            return scheduled;
+        }
+
+        // Takes a TaskFunc directly, so the closure is not first boxed into a
+        // move_only_function with a smaller inline buffer.
+        bool schedule_move_only(TaskFunc func)
         {
-            MoveWrapper<decltype(func)> tmp(std::move(func));
-            return schedule([func = tmp]()
-                            { func.get()(); });
+            return scheduleTask(std::move(func));
         }
 
-        bool schedule_move_only(util::move_only_function<void()> func, uint64_t schedule_info)
+        bool schedule_move_only(TaskFunc func, uint64_t schedule_info)
         {
-            MoveWrapper<decltype(func)> tmp(std::move(func));
-            return schedule([func = tmp]()
-                            { func.get()(); });
+            return scheduleTask(std::move(func), schedule_info);
         }
 
         // Return true if caller runs in the executor.
@@ -164,6 +277,35 @@ namespace async_framework
         // to schedule current execution after some time
         TimeAwaitable after(Duration dur, uint64_t schedule_info);
 
+        // Identify a timer started by scheduleTimer. A token with id 0 refers
+        // to no timer and cannot be cancelled.
+        struct TimerToken
+        {
+            uintptr_t id = 0;
+            uint64_t seq = 0;
+        };
+
+        // Run func after dur and return a token for cancelTimer. Executors
+        // that cannot cancel timers run func the same way as after() does
+        // and return an empty token.
+        TimerToken scheduleTimer(Func func, Duration dur)
+        {
+            return scheduleTimer(std::move(func), dur, static_cast<uint64_t>(Priority::DEFAULT));
+        }
+
+        virtual TimerToken scheduleTimer(Func func, Duration dur, uint64_t schedule_info)
+        {
+            schedule(std::move(func), dur, schedule_info);
+            return TimerToken{};
+        }
+
+        // Cancel a timer that has not fired yet. Return false if it already
+        // fired, was cancelled before, or the executor cannot cancel timers.
+        virtual bool cancelTimer([[maybe_unused]] TimerToken token)
+        {
+            return false;
+        }
+
         // IOExecutor accepts IO read/after requests.
         // Return nullptr if the executor doesn't offer an IOExecutor.
         virtual IOExecutor *getIOExecutor()
@@ -181,7 +323,7 @@ namespace async_framework
                 .detach();
         }
 
-        virtual void schedule(Func func, Duration dur, uint64_t schedule_info)
+        virtual void schedule(Func func, Duration dur, [[maybe_unused]] uint64_t schedule_info)
         {
             schedule(std::move(func), dur);
         }
@@ -209,7 +351,7 @@ namespace async_framework
         {
             ex_->schedule(std::move(continuation), dur_, schedule_info_);
         }
-        void resume() const noexcept {}
+        void await_resume() const noexcept {}
 
     private:
         Executor *ex_;
@@ -222,7 +364,7 @@ namespace async_framework
     {
     public:
         TimeAwaitable(Executor *ex, Executor::Duration dur, uint64_t schedule_info) : ex_(ex), dur_(dur), schedule_info_(schedule_info) {}
-        auto coAwait()
+        auto coAwait(Executor *)
         {
             return Executor::TimeAwaiter(ex_, dur_, schedule_info_);
         }
@@ -1,9 +1,9 @@
 #pragma once
 
-#include <condition_variable>
-#include <mutex>
+#include <chrono>
 #include <type_traits>
 #include "Executor.h"
+#include "FutureChain.h"
 #include "FutureState.h"
 #include "LocalState.h"
 #include "Traits.h"
@@ -20,7 +20,8 @@ namespace async_framework
     // could be able to appear in different thread.
     //
     // To get the value of Future synchronously, user should use `get()`
-    // method. It would blocking the current thread by using condition variable.
+    // method. It blocks the current thread on the state word (a futex), see
+    // `wait()`, `wait_for()` and `wait_until()`.
     //
     // To get the value of Future asynchronously, user could use `thenValue(F)`
     // or `thenTry(F)`. See the separate comments for details.
@@ -31,6 +32,15 @@ namespace async_framework
     // User should get a Future by calling `Promise::getFuture()` instead of
     // constructing a Future directly. If the user want a ready future indeed,
     // he should call makeReadyFuture().
+    //
+    // thenValue(F)/thenTry(F) on a future that has no result yet don't create
+    // a Promise per hop. The hops are fused into one chain (see FutureChain.h)
+    // whose stages run inline, one after another, once the original future
+    // gets its result. The whole chain costs one allocation and is scheduled
+    // at most once, in the executor of the original future. `via()` to another
+    // executor ends the chain: the hops after it form a new chain that runs in
+    // the new executor. Define ASYNC_FRAMEWORK_NO_FUTURE_FUSION to get a
+    // Promise per hop instead.
 
     template <typename T>
     class Future
@@ -54,7 +64,7 @@ namespace async_framework
             }
         }
 
-        Future(Try<inner_value_type> &&t) : sharedState_(nullptr), localState(std::move(t)) {}
+        Future(Try<inner_value_type> &&t) : sharedState_(nullptr), localState_(std::move(t)) {}
 
         ~Future()
         {
@@ -62,12 +72,23 @@ namespace async_framework
             {
                 sharedState_->detachOne();
             }
+            if (chain_)
+            {
+                // 丢弃的Future上的then仍然要执行
+                if (!sink_)
+                {
+                    finish([](Try<inner_value_type> &&) {});
+                }
+                chain_->deref();
+            }
         }
 
         Future(const Future &) = delete;
         Future &operator=(const Future &) = delete;
 
-        Future(Future &&other) : sharedState_(other.sharedState_), localState_(std::move(other.localState_))
+        Future(Future &&other) : sharedState_(other.sharedState_), localState_(std::move(other.localState_)),
+                                 chain_(std::exchange(other.chain_, nullptr)), tail_(std::exchange(other.tail_, nullptr)),
+                                 sink_(std::exchange(other.sink_, nullptr))
         {
             other.sharedState_ = nullptr;
         }
@@ -78,6 +99,9 @@ namespace async_framework
             {
                 std::swap(sharedState_, other.sharedState_);
                 localState_ = std::move(other.localState_);
+                std::swap(chain_, other.chain_);
+                std::swap(tail_, other.tail_);
+                std::swap(sink_, other.sink_);
             }
             return *this;
         }
@@ -90,12 +114,22 @@ namespace async_framework
     public:
         bool valid() const
         {
-            return sharedState_ != nullptr || localState_.hasResult();
+            return sharedState_ != nullptr || chain_ != nullptr || localState_.hasResult();
         }
 
+        // A fused future installs its chain only when it gets a continuation
+        // or is waited on, before that it reports no result.
         bool hasResult() const
         {
-            return localState_.hasResult() || sharedState_->hasResult();
+            if (sharedState_)
+            {
+                return sharedState_->hasResult();
+            }
+            if (chain_)
+            {
+                return sink_ != nullptr && sink_->ready();
+            }
+            return localState_.hasResult();
         }
 
         std::add_rvalue_reference_t<T> value() &&
@@ -170,40 +204,29 @@ namespace async_framework
         }
 
         // Implemention for get() to wait synchronously.
+        //
+        // The thread sleeps on the FutureState's state word, no continuation
+        // is installed. A future that already has a result returns at once.
         void wait()
         {
-            logicAssert(valid(), "Future is broken.");
-            if (hasResult())
-            {
-                return;
-            }
-
-            // wait in the same executor may cause deadlock.
-            assert(!currentThreadInExecutor());
-
-            // the state is a shared state
-            Promise<T> promise;
-            auto future = promise.getFuture();
+            waitImpl(nullptr);
+        }
 
-            // following continuation is simpl, execute inplace
-            sharedState_->setExecutor(nullptr);
+        // Wait until the future has a result or the timeout passes. Returns
+        // whether the future has a result. The future can still be used after
+        // a timeout, e.g. waited on again or continued with then*().
+        template <typename Rep, typename Period>
+        bool wait_for(const std::chrono::duration<Rep, Period> &timeout)
+        {
+            return wait_until(std::chrono::steady_clock::now() + timeout);
+        }
 
-            std::mutex mtx;
-            std::condition_variable cv;
-            std::atomic<bool> done{false};
-            // must wait utill p has set the value
-            sharedState_->setContinuation([&mtx, &cv, &done, p = std::move(promise)](Try<T> &t) mutable
-                                          {
-                std::unique_lock<std::mutex> lock(mtx);
-                p.setValue(std::move(t));
-                done.store(true, std::memory_order_relaxed);
-                cv.notify_one(); });
-
-            std::unique_lock<std::mutex> lock(mtx);
-            cv.wait(lock, [&done]()
-                    { return done.load(std::memory_order_relaxed); });
-            *this = std::move(future);
-            assert(sharedState_->hasResult());
+        template <typename Clock, typename Duration>
+        bool wait_until(const std::chrono::time_point<Clock, Duration> &deadline)
+        {
+            auto steadyDeadline = std::chrono::steady_clock::now() +
+                                  std::chrono::ceil<std::chrono::steady_clock::duration>(deadline - Clock::now());
+            return waitImpl(&steadyDeadline);
         }
 
         // Set the executor for the future. This only works for rvalue.
@@ -254,6 +277,15 @@ namespace async_framework
         void
         setExecutor(Executor *ex)
         {
+            if (chain_)
+            {
+                if (ex == chain_->executor())
+                {
+                    return;
+                }
+                // via边界：之后的then在新的executor中执行
+                materialize();
+            }
             if (sharedState_)
             {
                 sharedState_->setExecutor(ex);
@@ -266,6 +298,10 @@ namespace async_framework
 
         Executor *getExecutor()
         {
+            if (chain_)
+            {
+                return chain_->executor();
+            }
             if (sharedState_)
             {
                 return sharedState_->getExecutor();
@@ -280,7 +316,11 @@ namespace async_framework
         void setContinuation(F &&func)
         {
             assert(valid());
-            if (sharedState_)
+            if (chain_)
+            {
+                finish(std::forward<F>(func));
+            }
+            else if (sharedState_)
             {
                 sharedState_->setContinuation(std::forward<F>(func));
             }
@@ -293,6 +333,11 @@ namespace async_framework
         bool currentThreadInExecutor() const
         {
             assert(valid());
+            if (chain_)
+            {
+                auto ex = chain_->executor();
+                return ex != nullptr && ex->currentThreadInExecutor();
+            }
             if (sharedState_)
             {
                 // caller in executor?
@@ -310,11 +355,25 @@ namespace async_framework
         }
 
     private:
-        template <typename T>
-        static decltype(auto) getTry(T &self)
+        template <typename>
+        friend class Future;
+
+        // A future in the middle of a fused chain.
+        Future(detail::ChainBase *chain, detail::ChainStage<inner_value_type> **tail)
+            : sharedState_(nullptr), chain_(chain), tail_(tail)
         {
+        }
+
+        template <typename Self>
+        static decltype(auto) getTry(Self &self)
+        {
+            using TryRef = decltype(self.localState_.getTry());
             logicAssert(self.valid(), "Future is broken.");
-            logicAssert(self.localState_.hasResult() || self.sharedState_.hasResult(), "Future is not ready");
+            logicAssert(self.hasResult(), "Future is not ready");
+            if (self.chain_)
+            {
+                return static_cast<TryRef>(self.sink_->getTry());
+            }
             if (self.sharedState_)
             {
                 return self.sharedState_->getTry();
@@ -332,6 +391,14 @@ namespace async_framework
             logicAssert(valid(), "Future is broken.");
             using T2 = typename R::ReturnsFuture::Inner;
 
+#ifndef ASYNC_FRAMEWORK_NO_FUTURE_FUSION
+            // 还没有结果时融合进then链，已经有结果时直接按原来的方式执行
+            if (chain_ || (sharedState_ && !sharedState_->hasResult()))
+            {
+                return fuse<F, R>(std::forward<F>(func));
+            }
+#endif
+
             if (!sharedState_)
             {
                 if constexpr (R::ReturnsFuture::value)
@@ -382,10 +449,103 @@ namespace async_framework
             return newFuture;
         }
 
+        bool waitImpl(const std::chrono::steady_clock::time_point *deadline)
+        {
+            logicAssert(valid(), "Future is broken.");
+            if (hasResult())
+            {
+                if (sink_)
+                {
+                    takeSinkResult();
+                }
+                return true;
+            }
+
+            // wait in the same executor may cause deadlock.
+            assert(!currentThreadInExecutor());
+
+            if (chain_)
+            {
+                // 没有期限时直接等链的最后一个stage；有期限时超时后Future还要能继续使用，
+                // 先落到一个FutureState上再等待
+                if (deadline == nullptr)
+                {
+                    if (!sink_)
+                    {
+                        finish([](Try<inner_value_type> &&) {});
+                    }
+                    sink_->wait();
+                    takeSinkResult();
+                    return true;
+                }
+                materialize();
+            }
+            return sharedState_->waitResult(deadline);
+        }
+
+        // Append a stage to the fused chain, starting one if needed.
+        template <typename F, typename R>
+        Future<typename R::ReturnsFuture::Inner> fuse(F &&func)
+        {
+            using T2 = typename R::ReturnsFuture::Inner;
+            logicAssert(!sink_, "Future already has a continuation");
+            if (!chain_)
+            {
+                auto chain = new detail::Chain<inner_value_type>(sharedState_);
+                sharedState_ = nullptr;
+                chain_ = chain;
+                tail_ = chain->head();
+            }
+            auto stage = chain_->template emplace<detail::ThenStage<T, F, R>>(std::forward<F>(func));
+            *tail_ = stage;
+            tail_ = nullptr;
+            return Future<T2>(std::exchange(chain_, nullptr), stage->next());
+        }
+
+        // Terminate the fused chain with func and install it.
+        template <typename F>
+        void finish(F &&func)
+        {
+            logicAssert(!sink_, "Future already has a continuation");
+            auto sink = chain_->template emplace<detail::ContinuationSink<inner_value_type, F>>(chain_, std::forward<F>(func));
+            *tail_ = sink;
+            tail_ = nullptr;
+            sink_ = sink;
+            chain_->install();
+        }
+
+        // After wait() the chain has run: move its result into localState_,
+        // so the future can be continued or moved to another executor like a
+        // ready plain future.
+        void takeSinkResult()
+        {
+            auto ex = chain_->executor();
+            localState_ = LocalState<inner_value_type>(std::move(sink_->getTry()));
+            localState_.setExecutor(ex);
+            sink_ = nullptr;
+            std::exchange(chain_, nullptr)->deref();
+        }
+
+        // Turn a fused future into a plain one, backed by a FutureState with
+        // the executor of the chain.
+        void materialize()
+        {
+            Promise<T> promise;
+            auto future = promise.getFuture();
+            future.sharedState_->setExecutor(chain_->executor());
+            finish([p = std::move(promise)](Try<inner_value_type> &&t) mutable
+                   { p.setValue(std::move(t)); });
+            *this = std::move(future);
+        }
+
     private:
         FutureState<inner_value_type> *sharedState_;
         // Ready-Future does not have a Promise, an inline state is faster.
         LocalState<inner_value_type> localState_;
+        // 融合的then链，sharedState_此时已交给chain_
+        detail::ChainBase *chain_ = nullptr;
+        detail::ChainStage<inner_value_type> **tail_ = nullptr;
+        detail::ChainSink<inner_value_type> *sink_ = nullptr;
 
     private:
         template <typename Iter>
@@ -0,0 +1,368 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "Executor.h"
+#include "FutureState.h"
+#include "Traits.h"
+#include "Try.h"
+#include "util/Futex.h"
+#include "util/SizeClassPool.h"
+
+namespace async_framework
+{
+    template <typename T>
+    class Future;
+
+    namespace detail
+    {
+        // A fused then-chain.
+        //
+        // `f.thenValue(a).thenTry(b).thenValue(c)` on a pending future doesn't
+        // create a Promise and a FutureState per hop. The first then takes the
+        // future's FutureState over and every hop appends a stage to one
+        // chain. The stages are placed in the chain's own arena. When the
+        // final future gets a continuation (or is dropped), the chain installs
+        // a single continuation into the original FutureState, which runs all
+        // stages inline, one after another, on the thread that runs it.
+        //
+        // The chain is reference counted: the Future owns one reference and the
+        // installed continuation owns another one until the last stage
+        // returns. The last stage keeps the final result, so the Future can
+        // still read it after the continuation ran, just like FutureState.
+        //
+        // Users should **never** use these types directly.
+
+        class ChainNode
+        {
+        public:
+            ChainNode() = default;
+            ChainNode(const ChainNode &) = delete;
+            ChainNode &operator=(const ChainNode &) = delete;
+            virtual ~ChainNode() = default;
+
+        private:
+            friend class ChainBase;
+            ChainNode *owned_ = nullptr;
+            // 不在arena中，需要单独delete
+            bool standalone_ = false;
+        };
+
+        template <typename T>
+        class ChainStage : public ChainNode
+        {
+        public:
+            virtual void run(Try<T> &&value) = 0;
+        };
+
+        class ChainBase
+        {
+        public:
+            static constexpr size_t kInlineSize = 320;
+            static constexpr size_t kBlockSize = util::SizeClassPool::kMaxSize - 16;
+
+            ChainBase() = default;
+            ChainBase(const ChainBase &) = delete;
+            ChainBase &operator=(const ChainBase &) = delete;
+
+#ifndef ASYNC_FRAMEWORK_NO_FUTURE_STATE_POOL
+            static void *operator new(std::size_t size)
+            {
+                return util::SizeClassPool::allocate(size);
+            }
+
+            static void operator delete(void *p, std::size_t size) noexcept
+            {
+                util::SizeClassPool::deallocate(p, size);
+            }
+#endif
+
+            virtual Executor *executor() const = 0;
+            // 把整条链作为一个continuation安装到原始的FutureState上
+            virtual void install() = 0;
+
+            void ref() noexcept
+            {
+                refs_.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void deref() noexcept
+            {
+                if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete this;
+                }
+            }
+
+            template <typename Node, typename... Args>
+            Node *emplace(Args &&...args)
+            {
+                Node *node;
+                auto p = allocate(sizeof(Node), alignof(Node));
+                if (p != nullptr)
+                {
+                    node = ::new (p) Node(std::forward<Args>(args)...);
+                }
+                else
+                {
+                    node = new Node(std::forward<Args>(args)...);
+                    node->standalone_ = true;
+                }
+                node->owned_ = nodes_;
+                nodes_ = node;
+                return node;
+            }
+
+        protected:
+            virtual ~ChainBase()
+            {
+                while (nodes_ != nullptr)
+                {
+                    auto node = nodes_;
+                    nodes_ = node->owned_;
+                    if (node->standalone_)
+                    {
+                        delete node;
+                    }
+                    else
+                    {
+                        node->~ChainNode();
+                    }
+                }
+                while (blocks_ != nullptr)
+                {
+                    auto block = blocks_;
+                    blocks_ = block->next;
+                    util::SizeClassPool::deallocate(block, sizeof(Block));
+                }
+            }
+
+        private:
+            struct alignas(16) Block
+            {
+                Block *next;
+                alignas(16) char data[kBlockSize];
+            };
+
+            // 内联的arena用完后从SizeClassPool取新的block
+            void *allocate(size_t size, size_t align)
+            {
+                if (size > kBlockSize || align > 16)
+                {
+                    return nullptr;
+                }
+                auto offset = (used_ + align - 1) & ~(align - 1);
+                if (offset + size > capacity_)
+                {
+                    auto block = static_cast<Block *>(util::SizeClassPool::allocate(sizeof(Block)));
+                    block->next = blocks_;
+                    blocks_ = block;
+                    current_ = block->data;
+                    capacity_ = kBlockSize;
+                    offset = 0;
+                }
+                used_ = offset + size;
+                return current_ + offset;
+            }
+
+            std::atomic<uint32_t> refs_{1};
+            alignas(16) char arena_[kInlineSize];
+            char *current_ = arena_;
+            size_t used_ = 0;
+            size_t capacity_ = kInlineSize;
+            ChainNode *nodes_ = nullptr;
+            Block *blocks_ = nullptr;
+        };
+
+        // T is the value type of the original FutureState.
+        template <typename T>
+        class Chain final : public ChainBase
+        {
+        public:
+            // 接管origin上Future持有的引用
+            explicit Chain(FutureState<T> *origin) : origin_(origin) {}
+
+            ChainStage<T> **head()
+            {
+                return &head_;
+            }
+
+            Executor *executor() const override
+            {
+                return origin_->getExecutor();
+            }
+
+            void install() override
+            {
+                ref();
+                // 链在结果到达后才安装时也要回到origin的executor中执行
+                origin_->setContinuation([this](Try<T> &&value)
+                                         { head_->run(std::move(value)); },
+                                         false);
+            }
+
+        private:
+            ~Chain() override
+            {
+                origin_->detachOne();
+            }
+
+            FutureState<T> *origin_;
+            ChainStage<T> *head_ = nullptr;
+        };
+
+        // One thenValue/thenTry hop. T is the value type of the future the hop
+        // was called on and R describes the callable, as in Future::thenImpl.
+        template <typename T, typename F, typename R>
+        class ThenStage final : public ChainStage<std::conditional_t<std::is_void_v<T>, Unit, T>>
+        {
+        private:
+            using T2 = typename R::ReturnsFuture::Inner;
+            using In = std::conditional_t<std::is_void_v<T>, Unit, T>;
+            using Out = std::conditional_t<std::is_void_v<T2>, Unit, T2>;
+
+        public:
+            explicit ThenStage(F &&func) : func_(std::forward<F>(func)) {}
+
+            ChainStage<Out> **next()
+            {
+                return &next_;
+            }
+
+            void run(Try<In> &&value) override
+            {
+                // 最后一个stage返回时整条链可能已经释放了，之后不能再访问成员
+                auto next = next_;
+                if (!R::isTry && value.hasError())
+                {
+                    next->run(Try<Out>(value.getException()));
+                    return;
+                }
+                if constexpr (R::ReturnsFuture::value)
+                {
+                    auto future = invoke(std::move(value));
+                    future.setContinuation([next](Try<Out> &&t)
+                                           { next->run(std::move(t)); });
+                }
+                else
+                {
+                    auto result = makeTryCall(std::move(func_), argument(value));
+                    if constexpr (std::is_void_v<T2>)
+                    {
+                        next->run(Try<Out>(result));
+                    }
+                    else
+                    {
+                        next->run(std::move(result));
+                    }
+                }
+            }
+
+        private:
+            static decltype(auto) argument(Try<In> &value)
+            {
+                if constexpr (std::is_void_v<T>)
+                {
+                    return static_cast<Try<void>>(value);
+                }
+                else
+                {
+                    return std::move(value);
+                }
+            }
+
+            Future<T2> invoke(Try<In> &&value)
+            {
+                try
+                {
+                    return std::move(func_)(argument(value));
+                }
+                catch (...)
+                {
+                    return Future<T2>(Try<Out>(std::current_exception()));
+                }
+            }
+
+            std::decay_t<F> func_;
+            ChainStage<Out> *next_ = nullptr;
+        };
+
+        // The last stage. It keeps the result for the Future, calls the
+        // continuation and releases the reference held by the installation.
+        template <typename T>
+        class ChainSink : public ChainStage<T>
+        {
+        public:
+            bool ready() const noexcept
+            {
+                return ready_.load(std::memory_order_acquire) == kReady;
+            }
+
+            // Block until the last stage ran, for Future::wait().
+            void wait()
+            {
+                uint32_t expected = kPending;
+                if (ready_.compare_exchange_strong(expected, kWaiting, std::memory_order_acquire))
+                {
+                    do
+                    {
+                        util::futexWait(ready_, kWaiting);
+                    } while (!ready());
+                }
+            }
+
+            Try<T> &getTry() noexcept
+            {
+                return result_;
+            }
+
+        protected:
+            static constexpr uint32_t kPending = 0;
+            static constexpr uint32_t kReady = 1;
+            // 有线程阻塞在wait()中，设置结果时需要唤醒
+            static constexpr uint32_t kWaiting = 2;
+
+            void setReady() noexcept
+            {
+                if (ready_.exchange(kReady, std::memory_order_acq_rel) == kWaiting)
+                {
+                    util::futexWakeAll(ready_);
+                }
+            }
+
+            Try<T> result_;
+            std::atomic<uint32_t> ready_{kPending};
+        };
+
+        template <typename T, typename F>
+        class ContinuationSink final : public ChainSink<T>
+        {
+        public:
+            ContinuationSink(ChainBase *chain, F &&func) : chain_(chain), func_(std::forward<F>(func)) {}
+
+            void run(Try<T> &&value) override
+            {
+                struct Release
+                {
+                    ChainBase *chain;
+                    ~Release()
+                    {
+                        chain->deref();
+                    }
+                } release{chain_};
+                this->result_ = std::move(value);
+                this->setReady();
+                func_(std::move(this->result_));
+            }
+
+        private:
+            ChainBase *chain_;
+            std::decay_t<F> func_;
+        };
+    } // namespace detail
+} // namespace async_framework
@@ -2,34 +2,45 @@
 
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <iostream>
 #include <stdexcept>
 
 #include "Common.h"
 #include "Executor.h"
 #include "Try.h"
+#include "util/Futex.h"
+#include "util/SizeClassPool.h"
 #include "util/move_only_function.h"
 
+// FutureState中continuation的内联缓冲大小，编译时可以重新定义
+#ifndef ASYNC_FRAMEWORK_CONTINUATION_INLINE_SIZE
+#define ASYNC_FRAMEWORK_CONTINUATION_INLINE_SIZE 48
+#endif
+
 namespace async_framework
 {
     namespace detail
     {
-        enum class State : uint8_t
+        // 32位，阻塞等待时直接在state上futex
+        enum class State : uint32_t
         {
             START = 0,
             ONLY_RESULT = 1 << 0,
             ONLY_CONTINUATION = 1 << 1,
+            // START并且有线程阻塞在Future::wait中
+            WAITING = 1 << 2,
             DONE = 1 << 5,
         };
 
         constexpr State operator|(State lhs, State rhs)
         {
-            return State((uint8_t)lhs | (uint8_t)rhs);
+            return State((uint32_t)lhs | (uint32_t)rhs);
         }
 
         constexpr State operator&(State lhs, State rhs)
         {
-            return State((uint8_t)lhs & (uint8_t)rhs);
+            return State((uint32_t)lhs & (uint32_t)rhs);
         }
     } // namespace detail
 
@@ -39,12 +50,20 @@ namespace async_framework
     // the thread safety and call executor to schedule when necessary.
     //
     // Users should **never** use FutureState directly.
+    //
+    // FutureStates are allocated from util::SizeClassPool, so a Promise/Future
+    // round trip usually takes no malloc, even when the state is released on
+    // another thread. Define ASYNC_FRAMEWORK_NO_FUTURE_STATE_POOL to use the
+    // global allocator instead, e.g. when hunting memory errors with ASan.
+    // Continuations up to ASYNC_FRAMEWORK_CONTINUATION_INLINE_SIZE bytes,
+    // which covers a then-lambda holding a Promise and a few captures, are
+    // stored inside the state.
 
     template <typename T>
     class FutureState
     {
     private:
-        using Continuation = util::move_only_function<void(Try<T> &&value)>;
+        using Continuation = util::move_only_function<void(Try<T> &&value), ASYNC_FRAMEWORK_CONTINUATION_INLINE_SIZE>;
 
     private:
         // A helper to help FutureState to count the references to guarantee
@@ -71,7 +90,7 @@ namespace async_framework
             }
 
             ContinuationReference &operator=(const ContinuationReference &) = delete;
-            ContinuationReference(ContinuationReference &&other) : fs_(std::exception(other.fs_, nullptr)) {}
+            ContinuationReference(ContinuationReference &&other) noexcept : fs_(std::exchange(other.fs_, nullptr)) {}
 
             ContinuationReference &operator=(ContinuationReference &&) = delete;
 
@@ -100,12 +119,12 @@ namespace async_framework
             }
 
         private:
-            FutureState<T *> fs_ = nullptr;
+            FutureState<T> *fs_ = nullptr;
         };
 
     public:
         FutureState() : state_(detail::State::START), attached_(0), continuationRef_(0),
-                        executor_(nullptr), context_(Executor::NULLCTX), promiseRef_(0), forceSched_(false) {}
+                        executor_(nullptr), context_(Executor::NULLCTX), promiseRef_(0), forceSched_(false)
         {
         }
 
@@ -117,6 +136,29 @@ namespace async_framework
         FutureState(FutureState &&) = delete;
         FutureState &operator=(FutureState &&) = delete;
 
+#ifndef ASYNC_FRAMEWORK_NO_FUTURE_STATE_POOL
+        static void *operator new(std::size_t size)
+        {
+            return util::SizeClassPool::allocate(size);
+        }
+
+        static void operator delete(void *p, std::size_t size) noexcept
+        {
+            util::SizeClassPool::deallocate(p, size);
+        }
+
+        // 超过默认对齐的T不经过pool
+        static void *operator new(std::size_t size, std::align_val_t align)
+        {
+            return ::operator new(size, align);
+        }
+
+        static void operator delete(void *p, std::size_t size, std::align_val_t align) noexcept
+        {
+            ::operator delete(p, size, align);
+        }
+#endif
+
     public:
         bool hasResult() const noexcept
         {
@@ -198,7 +240,7 @@ namespace async_framework
         {
             if (executor_)
             {
-                context_ = executor_.checkout();
+                context_ = executor_->checkout();
             }
         }
 
@@ -234,9 +276,20 @@ namespace async_framework
                 {
                     return;
                 }
-                assert(state_.load(std::memory_order_relaxed) == detail::State::ONLY_CONTINUATION);
+                assert(state != detail::State::START);
+                [[fallthrough]];
+            case detail::State::WAITING:
+                // 只有等待的线程在超时后才会把WAITING改成ONLY_CONTINUATION
+                if (state == detail::State::WAITING &&
+                    state_.compare_exchange_strong(state, detail::State::ONLY_RESULT, std::memory_order_acq_rel))
+                {
+                    util::futexWakeAll(state_);
+                    return;
+                }
+                [[fallthrough]];
             case detail::State::ONLY_CONTINUATION:
-                if (state_.compare_exchange_strong(state, detail::State::DONE, std::memory_order_release))
+                // 前面失败的CAS不带acquire，这里需要acq_rel才能看到另一方写入的continuation
+                if (state_.compare_exchange_strong(state, detail::State::DONE, std::memory_order_acq_rel))
                 {
                     scheduleContinuation(false);
                     return;
@@ -245,14 +298,16 @@ namespace async_framework
                 logicAssert(false, "State Transfer Error");
             }
         }
+        // 结果已经就绪时continuation默认在当前线程直接执行；inplace为false时
+        // 与结果后到时一样按executor调度，融合的then链依赖这一点
         template <typename F>
-        void setContinuation(F &&func)
+        void setContinuation(F &&func, bool inplace = true)
         {
             logicAssert(!hasContinuation(), "FutureState already has a continuation");
             new (&continuation_) Continuation([func = std::move(func)](Try<T> &&v) mutable
                                               { func(std::forward<Try<T>>(v)); });
             auto state = state_.load(std::memory_order_acquire);
-            switch (case)
+            switch (state)
             {
             case detail::State::START:
                 if (state_.compare_exchange_strong(state, detail::State::ONLY_CONTINUATION, std::memory_order_release))
@@ -260,16 +315,55 @@ namespace async_framework
                     return;
                 }
                 assert(state_.load(std::memory_order_relaxed) == detail::State::ONLY_RESULT);
+                [[fallthrough]];
+            case detail::State::WAITING:
+                // Future::wait超时之后又安装continuation
+                if (state == detail::State::WAITING &&
+                    state_.compare_exchange_strong(state, detail::State::ONLY_CONTINUATION, std::memory_order_release))
+                {
+                    return;
+                }
+                [[fallthrough]];
             case detail::State::ONLY_RESULT:
-                if (state_.compare_exchange_strong(state, detail::State::DONE, std::memory_order_release))
+                // 同setResult，需要看到另一方写入的结果
+                if (state_.compare_exchange_strong(state, detail::State::DONE, std::memory_order_acq_rel))
                 {
-                    scheduleCOntinuation(true);
+                    scheduleContinuation(inplace);
                     return;
                 }
             default:
                 logicAssert(false, "State Transfer Error");
             }
         }
+
+        // Block until the state has a result, or the deadline passes. Used
+        // by Future::wait(), so the state must not have a continuation. No
+        // continuation is installed: the waiter marks the state WAITING and
+        // sleeps on the state word, and setResult() wakes it only then.
+        // Returns whether the result is there.
+        bool waitResult(const std::chrono::steady_clock::time_point *deadline = nullptr)
+        {
+            auto state = state_.load(std::memory_order_acquire);
+            for (;;)
+            {
+                if (state == detail::State::ONLY_RESULT || state == detail::State::DONE)
+                {
+                    return true;
+                }
+                logicAssert(state != detail::State::ONLY_CONTINUATION, "FutureState already has a continuation");
+                if (state == detail::State::START &&
+                    !state_.compare_exchange_weak(state, detail::State::WAITING, std::memory_order_acquire))
+                {
+                    continue;
+                }
+                if (!util::futexWait(state_, detail::State::WAITING, deadline))
+                {
+                    return hasResult();
+                }
+                state = state_.load(std::memory_order_acquire);
+            }
+        }
+
         bool currentThreadInExecutor() const
         {
             if (!executor_)
@@ -298,7 +392,7 @@ namespace async_framework
                     bool ret;
                     if (Executor::NULLCTX == context_)
                     {
-                        ret = executor_->schedule([fsRef = std::move(guard)]() mutable
+                        ret = executor_->scheduleTask([fsRef = std::move(guard)]() mutable
                                                   {
                             auto ref = std::move(fsRef);
                             auto fs = ref.getFutureState();
@@ -319,7 +413,7 @@ namespace async_framework
                     if (!ret)
                         throw std::runtime_error("schedule continuation in executor failed");
                 }
-                catch (std::execution &e)
+                catch (std::exception &e)
                 {
                     // reschedule failed, execute inplace
                     continuation_(std::move(try_value_));
@@ -348,10 +442,10 @@ namespace async_framework
         std::atomic<uint8_t> continuationRef_;
         Try<T> try_value_;
         // 确保不会被默认初始化
-        Union
+        union
         {
             Continuation continuation_;
-        }
+        };
         Executor *executor_;
         Executor::Context context_;
         std::atomic<std::size_t> promiseRef_;
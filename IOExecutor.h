@@ -37,6 +37,21 @@ namespace async_framework
     };
 
     using AIOCallback = std::function<void(io_event_t &)>;
+
+    namespace util
+    {
+        class BufferPool;
+    }
+
+    // A completion record owned by the caller, for example embedded in a
+    // coroutine's awaiter. Submitting with a record instead of an AIOCallback
+    // allocates nothing: the IOExecutor passes the record's address to the
+    // kernel as the request's user data and calls complete(record, event)
+    // when the request finishes. The record must stay alive until then.
+    struct IOCompletion
+    {
+        void (*complete)(IOCompletion *record, io_event_t &event) = nullptr;
+    };
     // The IOExecutor would accept IO read/write requests.
     // After the user implements an IOExecutor, he should associate
     // the IOExecutor with the corresponding Executor implementation.
@@ -53,5 +68,38 @@ namespace async_framework
     public:
         virtual void submitIO(int fd, iocb_cmd cmd, void *buffer, size_t length, __off_t offset, AIOCallback cbfn) = 0;
         virtual void submitIOV(int fd, iocb_cmd cmd, const iovec_t *iov, size_t count, __off_t offset, AIOCallback cbfn) = 0;
+
+        // 使用调用者的完成记录提交。默认实现把记录包装成AIOCallback，
+        // 只捕获一个指针，std::function不会分配内存
+        virtual void submitIO(int fd, iocb_cmd cmd, void *buffer, size_t length, __off_t offset, IOCompletion *completion)
+        {
+            submitIO(fd, cmd, buffer, length, offset, [completion](io_event_t &event)
+                     { completion->complete(completion, event); });
+        }
+
+        virtual void submitIOV(int fd, iocb_cmd cmd, const iovec_t *iov, size_t count, __off_t offset, IOCompletion *completion)
+        {
+            submitIOV(fd, cmd, iov, count, offset, [completion](io_event_t &event)
+                      { completion->complete(completion, event); });
+        }
+
+        // Attaches a pool of aligned IO buffers. Callers such as coro_file
+        // allocate their buffers from bufferPool(). Backends that can pin
+        // memory register the pool's arena with the kernel and serve pooled
+        // buffers without per-IO page mapping. Returns false when the backend
+        // could not set the pool up; the pool can still be used as plain memory.
+        virtual bool setBufferPool(util::BufferPool *pool)
+        {
+            bufferPool_ = pool;
+            return true;
+        }
+
+        util::BufferPool *bufferPool() const
+        {
+            return bufferPool_;
+        }
+
+    protected:
+        util::BufferPool *bufferPool_ = nullptr;
     };
 } // namespace async_framework
\ No newline at end of file
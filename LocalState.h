@@ -21,7 +21,7 @@ namespace async_framework
 
     public:
         LocalState() : executor_(nullptr) {}
-        LocalState(T &&v) try_value_(std::forward<T>(v)), executor_(nullptr) {}
+        LocalState(T &&v) : try_value_(std::forward<T>(v)), executor_(nullptr) {}
         LocalState(Try<T> &&t) : try_value_(std::move(t)), executor_(nullptr) {}
 
         ~LocalState() {}
@@ -10,7 +10,7 @@ namespace async_framework
     public:
         MoveWrapper() = default;
         MoveWrapper(T &&value) : value_(std::move(value)) {}
-        MoveWrapper(const MoveWrapper &other) : value_(move(other.value_)) {}
+        MoveWrapper(const MoveWrapper &other) : value_(std::move(other.value_)) {}
         MoveWrapper(MoveWrapper &&other) : value_(std::move(other.value_)) {}
 
         // 禁止拷贝和移动对象
@@ -53,11 +53,11 @@ namespace async_framework
             return *this;
         }
 
-        Promise(Promise<T> &&other) : sharedState_(std::exchange(other.sharedState_, nullptr)), hasFuture_(std::exchange(other.hasFuture_, nullptr))
+        Promise(Promise<T> &&other) noexcept : sharedState_(std::exchange(other.sharedState_, nullptr)), hasFuture_(std::exchange(other.hasFuture_, false))
         {
         }
 
-        Promise &operator=(Promise<T> &&other)
+        Promise &operator=(Promise<T> &&other) noexcept
         {
             std::swap(sharedState_, other.sharedState_);
             std::swap(hasFuture_, other.hasFuture_);
@@ -0,0 +1,503 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "Common.h"
+#include "Executor.h"
+#include "Try.h"
+#include "util/SizeClassPool.h"
+
+namespace async_framework
+{
+    // SharedPromise/SharedFuture broadcast one result to any number of
+    // consumers, e.g. a config reload or a cache fill that many requests wait
+    // for.
+    //
+    // Unlike Future, a SharedFuture can be copied and waited on many times.
+    // Every waiter is a node that the waiter itself provides: the awaiter in
+    // the coroutine frame, the uthread's stack or the thread calling `get()`.
+    // The nodes form a lock-free intrusive list in the shared state, so adding
+    // a waiter takes a CAS and no allocation. Setting the result walks the
+    // list once and wakes every waiter. Consumers read the result as
+    // `const T&` straight from the shared state, without copying.
+    //
+    // The reference stays valid as long as a SharedFuture or the SharedPromise
+    // of the state is alive.
+    //
+    // e.g.
+    //  SharedPromise<Config> promise;
+    //  auto future = promise.getFuture();
+    //  // in a Lazy
+    //  const Config &config = co_await future;
+    //  // in a uthread
+    //  const Config &config = uthread::await(future.via(ex));
+    //  // in a thread outside any executor
+    //  const Config &config = future.get();
+
+    template <typename T>
+    class SharedPromise;
+
+    namespace detail
+    {
+        // A waiter of a SharedFuture. notify is called once, after the
+        // result is set. The node may be gone when notify returns.
+        struct SharedWaiter
+        {
+            SharedWaiter *next = nullptr;
+            void (*notify)(SharedWaiter *waiter) = nullptr;
+        };
+
+        template <typename T>
+        class SharedState
+        {
+        public:
+            SharedState() = default;
+            SharedState(const SharedState &) = delete;
+            SharedState &operator=(const SharedState &) = delete;
+
+#ifndef ASYNC_FRAMEWORK_NO_FUTURE_STATE_POOL
+            static void *operator new(std::size_t size)
+            {
+                return util::SizeClassPool::allocate(size);
+            }
+
+            static void operator delete(void *p, std::size_t size) noexcept
+            {
+                util::SizeClassPool::deallocate(p, size);
+            }
+
+            static void *operator new(std::size_t size, std::align_val_t align)
+            {
+                return ::operator new(size, align);
+            }
+
+            static void operator delete(void *p, std::size_t size, std::align_val_t align) noexcept
+            {
+                ::operator delete(p, size, align);
+            }
+#endif
+
+            void attach() noexcept
+            {
+                refs_.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void detach() noexcept
+            {
+                if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete this;
+                }
+            }
+
+            bool hasResult() const noexcept
+            {
+                return waiters_.load(std::memory_order_acquire) == ready();
+            }
+
+            const Try<T> &getTry() const noexcept
+            {
+                return result_;
+            }
+
+            // 已经有结果时返回false，waiter不会被通知
+            bool addWaiter(SharedWaiter *waiter) noexcept
+            {
+                auto head = waiters_.load(std::memory_order_acquire);
+                do
+                {
+                    if (head == ready())
+                    {
+                        return false;
+                    }
+                    waiter->next = head;
+                } while (!waiters_.compare_exchange_weak(head, waiter, std::memory_order_release, std::memory_order_acquire));
+                return true;
+            }
+
+            void setResult(Try<T> &&value)
+            {
+                logicAssert(!hasResult(), "SharedPromise already has a result");
+                result_ = std::move(value);
+                // 一次exchange取下整个链表，之后加入的waiter会直接看到结果
+                auto waiter = waiters_.exchange(ready(), std::memory_order_acq_rel);
+                while (waiter != nullptr)
+                {
+                    // notify之后waiter可能已经被释放
+                    auto next = waiter->next;
+                    waiter->notify(waiter);
+                    waiter = next;
+                }
+            }
+
+        private:
+            static SharedWaiter *ready() noexcept
+            {
+                return reinterpret_cast<SharedWaiter *>(uintptr_t(1));
+            }
+
+            Try<T> result_;
+            std::atomic<SharedWaiter *> waiters_{nullptr};
+            std::atomic<uint32_t> refs_{1};
+        };
+
+        template <typename T, typename F>
+        class SharedCallback : public SharedWaiter
+        {
+        public:
+            SharedCallback(SharedState<T> *state, F &&func) : state_(state), func_(std::forward<F>(func))
+            {
+                state_->attach();
+                notify = &SharedCallback::onNotify;
+            }
+
+            ~SharedCallback()
+            {
+                state_->detach();
+            }
+
+            static void *operator new(std::size_t size)
+            {
+                return util::SizeClassPool::allocate(size);
+            }
+
+            static void operator delete(void *p, std::size_t size) noexcept
+            {
+                util::SizeClassPool::deallocate(p, size);
+            }
+
+            void run()
+            {
+                func_(state_->getTry());
+            }
+
+        private:
+            static void onNotify(SharedWaiter *waiter)
+            {
+                auto self = static_cast<SharedCallback *>(waiter);
+                struct Release
+                {
+                    SharedCallback *self;
+                    ~Release() { delete self; }
+                } release{self};
+                self->run();
+            }
+
+            SharedState<T> *state_;
+            std::decay_t<F> func_;
+        };
+
+        // The awaiter is the waiter node, it lives in the coroutine frame.
+        template <typename T>
+        class SharedFutureAwaiter : public SharedWaiter
+        {
+        public:
+            SharedFutureAwaiter(SharedState<T> *state, Executor *ex) : state_(state), ex_(ex)
+            {
+                state_->attach();
+                notify = &SharedFutureAwaiter::onNotify;
+            }
+
+            SharedFutureAwaiter(SharedFutureAwaiter &&other) : SharedFutureAwaiter(other.state_, other.ex_) {}
+            SharedFutureAwaiter &operator=(const SharedFutureAwaiter &) = delete;
+
+            ~SharedFutureAwaiter()
+            {
+                state_->detach();
+            }
+
+            bool await_ready() const noexcept
+            {
+                return state_->hasResult();
+            }
+
+            bool await_suspend(std::coroutine_handle<> continuation) noexcept
+            {
+                continuation_ = continuation;
+                return state_->addWaiter(this);
+            }
+
+            decltype(auto) await_resume() const
+            {
+                if constexpr (std::is_void_v<T>)
+                {
+                    state_->getTry().value();
+                }
+                else
+                {
+                    return state_->getTry().value();
+                }
+            }
+
+        private:
+            static void onNotify(SharedWaiter *waiter)
+            {
+                auto self = static_cast<SharedFutureAwaiter *>(waiter);
+                // 已经在协程所属的executor中时直接resume，否则调度回去
+                auto ex = self->ex_;
+                auto continuation = self->continuation_;
+                if (ex == nullptr || ex->currentThreadInExecutor() || !ex->scheduleHandle(continuation))
+                {
+                    continuation.resume();
+                }
+            }
+
+            SharedState<T> *state_;
+            Executor *ex_;
+            std::coroutine_handle<> continuation_;
+        };
+    } // namespace detail
+
+    template <typename T>
+    class SharedFuture
+    {
+    public:
+        using value_type = T;
+
+        SharedFuture() = default;
+
+        SharedFuture(const SharedFuture &other) : state_(other.state_), executor_(other.executor_)
+        {
+            if (state_)
+            {
+                state_->attach();
+            }
+        }
+
+        SharedFuture(SharedFuture &&other) noexcept
+            : state_(std::exchange(other.state_, nullptr)), executor_(std::exchange(other.executor_, nullptr))
+        {
+        }
+
+        SharedFuture &operator=(SharedFuture other) noexcept
+        {
+            std::swap(state_, other.state_);
+            std::swap(executor_, other.executor_);
+            return *this;
+        }
+
+        ~SharedFuture()
+        {
+            if (state_)
+            {
+                state_->detach();
+            }
+        }
+
+    public:
+        bool valid() const
+        {
+            return state_ != nullptr;
+        }
+
+        bool hasResult() const
+        {
+            logicAssert(valid(), "SharedFuture is broken");
+            return state_->hasResult();
+        }
+
+        // Require hasResult() == true.
+        const Try<T> &result() const
+        {
+            logicAssert(hasResult(), "SharedFuture is not ready");
+            return state_->getTry();
+        }
+
+        // Require hasResult() == true. Rethrows the exception if any.
+        decltype(auto) value() const
+        {
+            if constexpr (std::is_void_v<T>)
+            {
+                result().value();
+            }
+            else
+            {
+                return result().value();
+            }
+        }
+
+        // Block the current thread until the result is set. Like
+        // Future::get(), it shouldn't be called in an executor thread.
+        decltype(auto) get() const
+        {
+            wait();
+            return value();
+        }
+
+        void wait() const
+        {
+            logicAssert(valid(), "SharedFuture is broken");
+            if (state_->hasResult())
+            {
+                return;
+            }
+            assert(!(executor_ && executor_->currentThreadInExecutor()));
+
+            struct Waiter : detail::SharedWaiter
+            {
+                std::atomic<bool> done{false};
+            } waiter;
+            waiter.notify = [](detail::SharedWaiter *w)
+            {
+                auto self = static_cast<Waiter *>(w);
+                self->done.store(true, std::memory_order_release);
+                self->done.notify_one();
+            };
+            if (state_->addWaiter(&waiter))
+            {
+                waiter.done.wait(false, std::memory_order_acquire);
+            }
+        }
+
+        // Call func(const Try<T>&) once the result is set, on the thread that
+        // sets it, or right away if the result is already there. Each callback
+        // takes one small allocation from util::SizeClassPool.
+        template <typename F>
+        void addCallback(F &&func) const
+        {
+            logicAssert(valid(), "SharedFuture is broken");
+            if (state_->hasResult())
+            {
+                func(state_->getTry());
+                return;
+            }
+            auto callback = new detail::SharedCallback<T, F>(state_, std::forward<F>(func));
+            if (!state_->addWaiter(callback))
+            {
+                std::unique_ptr<detail::SharedCallback<T, F>> guard(callback);
+                callback->run();
+            }
+        }
+
+        // The executor that uthread::await() resumes the uthread in. It
+        // belongs to this handle only, other copies are not affected.
+        SharedFuture via(Executor *executor) const
+        {
+            SharedFuture ret(*this);
+            ret.executor_ = executor;
+            return ret;
+        }
+
+        Executor *getExecutor() const
+        {
+            return executor_;
+        }
+
+        // co_await in a Lazy. The coroutine is resumed in its executor.
+        auto coAwait(Executor *ex) const
+        {
+            logicAssert(valid(), "SharedFuture is broken");
+            return detail::SharedFutureAwaiter<T>(state_, ex);
+        }
+
+    public:
+        // Used by the awaiters, not supposed to be public.
+        bool addWaiter(detail::SharedWaiter *waiter) const
+        {
+            logicAssert(valid(), "SharedFuture is broken");
+            return state_->addWaiter(waiter);
+        }
+
+    private:
+        friend class SharedPromise<T>;
+
+        explicit SharedFuture(detail::SharedState<T> *state) : state_(state)
+        {
+            state_->attach();
+        }
+
+        detail::SharedState<T> *state_ = nullptr;
+        Executor *executor_ = nullptr;
+    };
+
+    template <typename T>
+    class SharedPromise
+    {
+    private:
+        // 与Promise一样，void时用Unit占位，只用于setValue的参数
+        using value_type = std::conditional_t<std::is_void_v<T>, Unit, T>;
+
+    public:
+        SharedPromise() : state_(new detail::SharedState<T>()) {}
+
+        // A SharedPromise destroyed without a result breaks its futures.
+        ~SharedPromise()
+        {
+            if (state_)
+            {
+                if (!state_->hasResult())
+                {
+                    try
+                    {
+                        throw std::runtime_error("Promise is broken");
+                    }
+                    catch (...)
+                    {
+                        state_->setResult(Try<T>(std::current_exception()));
+                    }
+                }
+                state_->detach();
+            }
+        }
+
+        SharedPromise(const SharedPromise &) = delete;
+        SharedPromise &operator=(const SharedPromise &) = delete;
+
+        SharedPromise(SharedPromise &&other) noexcept : state_(std::exchange(other.state_, nullptr)) {}
+
+        SharedPromise &operator=(SharedPromise &&other) noexcept
+        {
+            std::swap(state_, other.state_);
+            return *this;
+        }
+
+    public:
+        bool valid() const
+        {
+            return state_ != nullptr;
+        }
+
+        // May be called any number of times.
+        SharedFuture<T> getFuture() const
+        {
+            logicAssert(valid(), "SharedPromise is broken");
+            return SharedFuture<T>(state_);
+        }
+
+        void setException(std::exception_ptr error)
+        {
+            logicAssert(valid(), "SharedPromise is broken");
+            state_->setResult(Try<T>(error));
+        }
+
+        void setValue(value_type &&v)
+            requires(!std::is_void_v<T>)
+        {
+            logicAssert(valid(), "SharedPromise is broken");
+            state_->setResult(Try<T>(std::move(v)));
+        }
+
+        void setValue(Try<T> &&t)
+        {
+            logicAssert(valid(), "SharedPromise is broken");
+            state_->setResult(std::move(t));
+        }
+
+        void setValue()
+            requires(std::is_void_v<T>)
+        {
+            logicAssert(valid(), "SharedPromise is broken");
+            state_->setResult(Try<T>());
+        }
+
+    private:
+        detail::SharedState<T> *state_ = nullptr;
+    };
+} // namespace async_framework
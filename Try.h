@@ -39,7 +39,7 @@ namespace async_framework
         {
             if (other.hasError())
             {
-                value_.tmplate emplace<std::exception_ptr>(other._error);
+                value_.template emplace<std::exception_ptr>(other.error_);
             }
             else
             {
@@ -77,7 +77,7 @@ namespace async_framework
     public:
         constexpr bool available() const noexcept
         {
-            return !hasError();
+            return !std::holds_alternative<std::monostate>(value_);
         }
 
         constexpr bool hasError() const noexcept
@@ -94,20 +94,20 @@ namespace async_framework
         T &value() &
         {
             checkHasTry();
-            std::get<T>(value_);
+            return std::get<T>(value_);
         }
 
         // 这里一个右值调用value，所以直接将其保存的值move返回
         const T &&value() const &&
         {
             checkHasTry();
-            std::move(std::get<T>(value_));
+            return std::move(std::get<T>(value_));
         }
 
         T &&value() &&
         {
             checkHasTry();
-            std::move(std::get<T>(value_));
+            return std::move(std::get<T>(value_));
         }
 
         template <typename... Args>
@@ -187,7 +187,7 @@ namespace async_framework
             return *this;
         }
 
-        void value()
+        void value() const
         {
             if (error_)
             {
@@ -195,7 +195,7 @@ namespace async_framework
             }
         }
 
-        bool hasError()
+        bool hasError() const
         {
             return error_.operator bool();
         }
@@ -205,7 +205,12 @@ namespace async_framework
             error_ = error;
         }
 
-        std::exception_ptr getError()
+        std::exception_ptr getError() const
+        {
+            return error_;
+        }
+
+        std::exception_ptr getException() const
         {
             return error_;
         }
@@ -250,7 +255,7 @@ namespace async_framework
                 return Try<T>(std::invoke(std::forward<F>(f), std::forward<Args>(args)...));
             }
         }
-        catch
+        catch (...)
         {
             return Try<T>(std::current_exception());
         }
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cerrno>
+#include <coroutine>
+#include <cstdint>
+#include "../Executor.h"
+#include "../IOExecutor.h"
+#include "./Lazy.h"
+
+namespace async_framework
+{
+    namespace coro
+    {
+        namespace detail
+        {
+            // The awaiter is the IOCompletion record itself. It lives in the
+            // awaiting coroutine's frame until the IO finishes, so submitting
+            // an IO allocates nothing and completing it is one indirect call
+            // that stores the result and resumes the coroutine.
+            class IOAwaiter : public IOCompletion
+            {
+            public:
+                IOAwaiter(IOExecutor *io, Executor *ex, int fd, iocb_cmd cmd, void *buffer, size_t length, off_t offset)
+                    : io_(io), ex_(ex), fd_(fd), cmd_(cmd), buffer_(buffer), length_(length), offset_(offset)
+                {
+                    complete = &IOAwaiter::onComplete;
+                }
+
+                bool await_ready() const noexcept
+                {
+                    return false;
+                }
+
+                bool await_suspend(std::coroutine_handle<> continuation)
+                {
+                    if (io_ == nullptr)
+                    {
+                        result_ = -ENOSYS;
+                        return false;
+                    }
+                    continuation_ = continuation;
+                    if (cmd_ == IOCB_CMD_PREADV || cmd_ == IOCB_CMD_PWRITEV)
+                        io_->submitIOV(fd_, cmd_, static_cast<const iovec_t *>(buffer_), length_, offset_, this);
+                    else
+                        io_->submitIO(fd_, cmd_, buffer_, length_, offset_, this);
+                    return true;
+                }
+
+                // 返回传输的字节数，出错时返回负的errno
+                int64_t await_resume() const noexcept
+                {
+                    return result_;
+                }
+
+            private:
+                static void onComplete(IOCompletion *record, io_event_t &event)
+                {
+                    auto self = static_cast<IOAwaiter *>(record);
+                    self->result_ = static_cast<int64_t>(event.res);
+                    // 已经在协程所属的executor中时直接resume，否则调度回去
+                    auto ex = self->ex_;
+                    if (ex == nullptr || ex->currentThreadInExecutor() || !ex->scheduleHandle(self->continuation_))
+                        self->continuation_.resume();
+                }
+
+                IOExecutor *io_;
+                Executor *ex_;
+                int fd_;
+                iocb_cmd cmd_;
+                void *buffer_;
+                size_t length_;
+                off_t offset_;
+                int64_t result_ = 0;
+                std::coroutine_handle<> continuation_;
+            };
+
+            class IOAwaitable
+            {
+            public:
+                IOAwaitable(IOExecutor *io, int fd, iocb_cmd cmd, void *buffer, size_t length, off_t offset)
+                    : io_(io), fd_(fd), cmd_(cmd), buffer_(buffer), length_(length), offset_(offset)
+                {
+                }
+
+                // 没有指定IOExecutor时使用当前executor的IOExecutor
+                auto coAwait(Executor *ex)
+                {
+                    auto io = io_;
+                    if (io == nullptr && ex != nullptr)
+                        io = ex->getIOExecutor();
+                    return IOAwaiter(io, ex, fd_, cmd_, buffer_, length_, offset_);
+                }
+
+            private:
+                IOExecutor *io_;
+                int fd_;
+                iocb_cmd cmd_;
+                void *buffer_;
+                size_t length_;
+                off_t offset_;
+            };
+        } // namespace detail
+
+        // Awaitables for IO submitted to an IOExecutor. They can only be
+        // awaited in a Lazy. Without an explicit IOExecutor, the IO goes to
+        // the IOExecutor of the Lazy's executor. The result is the number of
+        // bytes transferred, or a negative errno (-ENOSYS when there is no
+        // IOExecutor).
+        //
+        // The buffer (and iovec array) must stay valid until the co_await
+        // returns. The coroutine is resumed on its executor.
+        //
+        // e.g. int64_t n = co_await asyncRead(fd, buf, sizeof(buf), 0);
+        inline detail::IOAwaitable asyncRead(IOExecutor *io, int fd, void *buffer, size_t length, off_t offset)
+        {
+            return detail::IOAwaitable(io, fd, IOCB_CMD_PREAD, buffer, length, offset);
+        }
+
+        inline detail::IOAwaitable asyncRead(int fd, void *buffer, size_t length, off_t offset)
+        {
+            return asyncRead(nullptr, fd, buffer, length, offset);
+        }
+
+        inline detail::IOAwaitable asyncWrite(IOExecutor *io, int fd, const void *buffer, size_t length, off_t offset)
+        {
+            return detail::IOAwaitable(io, fd, IOCB_CMD_PWRITE, const_cast<void *>(buffer), length, offset);
+        }
+
+        inline detail::IOAwaitable asyncWrite(int fd, const void *buffer, size_t length, off_t offset)
+        {
+            return asyncWrite(nullptr, fd, buffer, length, offset);
+        }
+
+        inline detail::IOAwaitable asyncReadv(IOExecutor *io, int fd, const iovec_t *iov, size_t count, off_t offset)
+        {
+            return detail::IOAwaitable(io, fd, IOCB_CMD_PREADV, const_cast<iovec_t *>(iov), count, offset);
+        }
+
+        inline detail::IOAwaitable asyncReadv(int fd, const iovec_t *iov, size_t count, off_t offset)
+        {
+            return asyncReadv(nullptr, fd, iov, count, offset);
+        }
+
+        inline detail::IOAwaitable asyncWritev(IOExecutor *io, int fd, const iovec_t *iov, size_t count, off_t offset)
+        {
+            return detail::IOAwaitable(io, fd, IOCB_CMD_PWRITEV, const_cast<iovec_t *>(iov), count, offset);
+        }
+
+        inline detail::IOAwaitable asyncWritev(int fd, const iovec_t *iov, size_t count, off_t offset)
+        {
+            return asyncWritev(nullptr, fd, iov, count, offset);
+        }
+
+        // datasync为true时只同步数据(fdatasync)
+        inline detail::IOAwaitable asyncFsync(IOExecutor *io, int fd, bool datasync = false)
+        {
+            return detail::IOAwaitable(io, fd, datasync ? IOCB_CMD_FDSYNC : IOCB_CMD_FSYNC, nullptr, 0, 0);
+        }
+
+        inline detail::IOAwaitable asyncFsync(int fd, bool datasync = false)
+        {
+            return asyncFsync(nullptr, fd, datasync);
+        }
+    } // namespace coro
+} // namespace async_framework
@@ -285,7 +285,7 @@ namespace async_framework
                 SimpleCollectAnyVariadicPairAwaiter(Ts &&...inputs)
                     : inputs_(std::move(inputs)...) {}
 
-                auto coAwait(Executor *ex)
+                auto coAwait(Executor *)
                 {
                     return CollectAnyVariadicPairAwaiter(std::move(inputs_));
                 }
@@ -298,11 +298,11 @@ namespace async_framework
                 using InputType = std::tuple<LazyType<Ts>...>;
 
                 CollectAnyVariadicAwaiter(LazyType<Ts> &&...inputs)
-                    : input_(std::make_unique<InputType>(std::move(inputs))),
+                    : input_(std::make_unique<InputType>(std::move(inputs)...)),
                       result_(nullptr) {}
 
                 CollectAnyVariadicAwaiter(InputType &&inputs)
-                    : inputs_(std::make_unique<InputType>(std::move(inputs))),
+                    : input_(std::make_unique<InputType>(std::move(inputs))),
                       result_(nullptr) {}
 
                 CollectAnyVariadicAwaiter(const CollectAnyVariadicAwaiter &) = delete;
@@ -360,7 +360,7 @@ namespace async_framework
                     await_suspend_impl(std::make_index_sequence<sizeof...(Ts)>{}, std::move(continuation));
                 }
 
-                void await_resume()
+                auto await_resume()
                 {
                     assert(result_ != nullptr);
                     return std::move(result_->value());
@@ -386,7 +386,7 @@ namespace async_framework
                 SimpleCollectAnyAwaitable(std::vector<LazyType, InAlloc> &&input, Callback callback)
                     : input_(std::move(input)), callback_(std::move(callback)) {}
 
-                auto coAwait(Executor *ex)
+                auto coAwait(Executor *)
                 {
                     if constexpr (std::is_same_v<Callback, Unit>)
                     {
@@ -408,7 +408,7 @@ namespace async_framework
                 SimpleCollectAnyVariadicAwaiter(LazyType<Ts> &&...inputs)
                     : inputs_(std::move(inputs)...) {}
 
-                auto coAwait(Executor *ex)
+                auto coAwait(Executor *)
                 {
                     return CollectAnyVariadicAwaiter(std::move(inputs_));
                 }
@@ -424,9 +424,9 @@ namespace async_framework
                     output_.resize(input_.size());
                 }
 
-                CollectAllAwaiter(CollectAllAwaiter &&other) = delete;
+                CollectAllAwaiter(CollectAllAwaiter &&other) = default;
                 CollectAllAwaiter(const CollectAllAwaiter &) = delete;
-                CollectAllAwaiter &operator=(cosnt CollectAllAwaiter &) = delete;
+                CollectAllAwaiter &operator=(const CollectAllAwaiter &) = delete;
 
                 inline bool await_ready() const noexcept
                 {
@@ -437,6 +437,21 @@ namespace async_framework
                 {
                     auto promise_type = std::coroutine_handle<LazyPromiseBase>::from_address(continuation.address()).promise();
                     auto executor = promise_type.executor_;
+                    // Para时把连续的、同一个executor上的任务攒成一批，一次提交
+                    std::vector<Executor::Func> batch;
+                    Executor *batchExecutor = nullptr;
+                    if constexpr (Para)
+                        batch.reserve(input_.size());
+                    auto flush = [&]()
+                    {
+                        if (batch.empty())
+                            return;
+                        auto scheduled = batchExecutor->scheduleBatch(batch);
+                        // 调度失败的任务就地执行
+                        for (auto i = scheduled; i < batch.size(); i++)
+                            batch[i]();
+                        batch.clear();
+                    };
                     for (size_t i = 0; i < input_.size(); ++i)
                     {
                         auto &exec = input_[i].coro_.promise().executor_;
@@ -460,18 +475,24 @@ namespace async_framework
                             {
                                 AS_LIKELY
                                 {
-                                    exec->schedule(func);
+                                    if (exec != batchExecutor)
+                                    {
+                                        flush();
+                                        batchExecutor = exec;
+                                    }
+                                    batch.emplace_back(std::move(func));
                                     continue;
                                 }
                             }
                         }
                         func();
-                        event_.setAwaitingCoro(continuation);
-                        auto awaitingCoro = event_.down();
-                        if (awaitingCoro)
-                        {
-                            awaitingCoro.resume();
-                        }
+                    }
+                    flush();
+                    event_.setAwaitingCoro(continuation);
+                    auto awaitingCoro = event_.down();
+                    if (awaitingCoro)
+                    {
+                        awaitingCoro.resume();
                     }
                 }
 
@@ -493,7 +514,7 @@ namespace async_framework
                 SimpleCollectAllAwaitable(Container &&input, OAlloc out_alloc)
                     : input_(std::move(input)), out_alloc_(out_alloc) {}
 
-                auto coAwait(Executor *ex)
+                auto coAwait(Executor *)
                 {
                     return CollectAllAwaiter<Container, OAlloc, Para>(std::move(input_), out_alloc_);
                 }
@@ -590,9 +611,23 @@ namespace async_framework
                     auto promise_type = std::coroutine_handle<LazyPromiseBase>::from_address(continuation.address()).promise();
                     auto executor = promise_type.executor_;
                     event_.setAwaitingCoro(continuation);
+                    // Para时和vector版本一样，把连续的、同一个executor上的任务攒成一批，一次提交
+                    std::array<Executor::Func, Para ? sizeof...(Ts) : 0> batch;
+                    size_t batchSize = 0;
+                    Executor *batchExecutor = nullptr;
+                    auto flush = [&]()
+                    {
+                        if (batchSize == 0)
+                            return;
+                        auto scheduled = batchExecutor->scheduleBatch(std::span<Executor::Func>(batch.data(), batchSize));
+                        // 调度失败的任务就地执行
+                        for (auto i = scheduled; i < batchSize; i++)
+                            batch[i]();
+                        batchSize = 0;
+                    };
                     // fold expression
                     (
-                        [executor, this](auto &lazy, auto &result)
+                        [&](auto &lazy, auto &result)
                         {
                             auto &&exec = lazy.coro_.promise().executor_;
                             if (exec == nullptr)
@@ -611,16 +646,26 @@ namespace async_framework
                             if constexpr (Para == true && sizeof...(Ts) > 1)
                             {
                                 if (exec != nullptr)
-                                    AS_LIKELY { exec->schedule(std::move(func)); }
-                                else
-                                    AS_UNLIKELY { func(); }
-                            }
-                            else
-                            {
-                                func();
+                                    AS_LIKELY
+                                    {
+                                        if (exec != batchExecutor)
+                                        {
+                                            flush();
+                                            batchExecutor = exec;
+                                        }
+                                        batch[batchSize++] = std::move(func);
+                                        return;
+                                    }
                             }
+                            func();
                         }(std::get<index>(inputs_), std::get<index>(results_)),
-                        ...)
+                        ...);
+                    flush();
+                    // 构造时多计的一次在所有任务都启动之后才减掉
+                    if (auto awaitingCoro = event_.down(); awaitingCoro)
+                    {
+                        awaitingCoro.resume();
+                    }
                 }
 
                 void await_suspend(std::coroutine_handle<> continuation)
@@ -646,7 +691,7 @@ namespace async_framework
                 SimpleCollectAllVariadicAwaiter(LazyType<Ts> &&...inputs)
                     : inputs_(std::move(inputs)...) {}
 
-                auto coAwait(Executor *ex)
+                auto coAwait(Executor *)
                 {
                     return CollectAllVariadicAwaiter<Para, LazyType, Ts...>(std::move(inputs_));
                 }
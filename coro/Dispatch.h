@@ -1,7 +1,7 @@
 #pragma once
 
-#include "./Common.h"
-#include "./Executor.h"
+#include "../Common.h"
+#include "../Executor.h"
 #include "./Lazy.h"
 #include <coroutine>
 
@@ -63,7 +63,7 @@ namespace async_framework
                     }
                     Executor *old_ex = h.promise().executor_;
                     ChangeLaziessExecutorTo(h, ex_);
-                    bool succ = ex_->schedule(std::move(h));
+                    bool succ = ex_->scheduleHandle(h);
                     // cannot access *this after schedule.
                     // If the scheduling fails, we must change the executor back to its
                     // original value, as the user may catch exceptions and handle them
@@ -101,11 +101,18 @@ namespace async_framework
             };
         } // namespace detail
 
-        inline detail::DispatchAwaitable diapatch(Executor *ex)
+        // co_await dispatch(ex)把当前Lazy及其调用链切换到ex上继续执行
+        inline detail::DispatchAwaitable dispatch(Executor *ex)
         {
             logicAssert(ex != nullptr, "dispatch's param should not be nullptr");
             return detail::DispatchAwaitable(ex);
         }
 
+        // 旧的拼写，保留给已有的调用者
+        inline detail::DispatchAwaitable diapatch(Executor *ex)
+        {
+            return dispatch(ex);
+        }
+
     } // namespace coro
 } // namespace async_framework
\ No newline at end of file
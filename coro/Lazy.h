@@ -100,7 +100,7 @@ namespace async_framework
                         // schedule_info is YIELD here, which avoid executor always
                         // run handle immediately when other works are waiting, which may
                         // cause deadlock.
-                        executor_->schedule(std::move(handle), static_cast<uint64_t>(Executor::Priority::YIELD));
+                        executor_->scheduleHandle(handle, static_cast<uint64_t>(Executor::Priority::YIELD));
                     }
 
                     void await_resume() noexcept {}
@@ -245,6 +245,16 @@ namespace async_framework
                         }
                 }
 
+                Try<void> tryResult() noexcept
+                {
+                    if (exception_ != nullptr)
+                        AS_UNLIKELY
+                        {
+                            return Try<void>(exception_);
+                        }
+                    return Try<void>();
+                }
+
             public:
                 std::exception_ptr exception_{nullptr};
             };
@@ -351,7 +361,7 @@ namespace async_framework
                         {
                             auto &pr = this->handle_.promise();
                             logicAssert(pr.executor_, "RescheduleLazy need executor");
-                            pr.executor_->schedule(this->handle_);
+                            pr.executor_->scheduleHandle(this->handle_);
                         }
                         else
                         {
@@ -372,7 +382,7 @@ namespace async_framework
                     {
                         if constexpr (reschedule)
                         {
-                            logicAssert(fasle, "RescheduleLazy should be only allowed in DetachedCoroutine");
+                            logicAssert(false, "RescheduleLazy should be only allowed in DetachedCoroutine");
                         }
                         // derived lazy inherits executor
                         this->handle_.promise().executor_ = ex;
@@ -609,7 +619,7 @@ namespace async_framework
             template <isDerivedFromLazyLocal LazyLocal, typename... Args>
             Lazy<T> setLazyLocal(Args &&...args) &&
             {
-                logicAssert(this->coro_ operator bool(), "Lazy do not have a coroutine handle. Maybe the allocation failed or you're using a used Lazy");
+                logicAssert(this->coro_.operator bool(), "Lazy do not have a coroutine handle. Maybe the allocation failed or you're using a used Lazy");
                 if constexpr (std::is_move_constructible_v<LazyLocal>)
                 {
                     return setLazyLocalImpl<LazyLocal>(std::move(*this), LazyLocal{std::forward<Args>(args)...});
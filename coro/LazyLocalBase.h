@@ -58,7 +58,7 @@ namespace async_framework::coro
         {
             if (T::classof(base))
             {
-                return static_assert<T *>(base);
+                return static_cast<T *>(base);
             }
             else
             {
@@ -79,7 +79,7 @@ namespace async_framework::coro
         {
             if (T::classof(base))
             {
-                return static_assert<T *>(base);
+                return static_cast<T *>(base);
             }
             else
             {
@@ -3,6 +3,7 @@
 #include <mutex>
 #include <coroutine>
 #include <cassert>
+#include "../Executor.h"
 
 namespace async_framework
 {
@@ -112,7 +113,7 @@ namespace async_framework
                 }
                 assert(waitersHead != nullptr);
                 waiters_ = waitersHead->next_;
-                waitersHead->awaitingCoroutine_.resume();
+                waitersHead->resume();
             }
 
         private:
@@ -128,14 +129,31 @@ namespace async_framework
                 }
 
                 void await_resume() noexcept {}
-                // FIXME: LockAwaiter should implement coAwait to avoid to fall in
-                // ViaAsyncAwaiter.
+
+                // 不经过ViaAsyncAwaiter：它会把拿到锁的协程checkin回挂起时的worker，
+                // 锁在多个worker的协程之间交接时每次都要唤醒一个休眠的线程。
+                // 这里把协程交给unlock时所在的executor调度，unlock方是worker时任务放入它的LIFO槽
+                LockAwaiter coAwait(Executor *ex) noexcept
+                {
+                    ex_ = ex;
+                    return *this;
+                }
 
             protected:
                 Mutex &mutex_;
+                Executor *ex_ = nullptr;
 
             private:
                 friend Mutex;
+
+                void resume() noexcept
+                {
+                    auto handle = awaitingCoroutine_;
+                    // 没有executor或者调度失败时在unlock的线程中直接恢复
+                    if (ex_ == nullptr || !ex_->scheduleHandle(handle))
+                        handle.resume();
+                }
+
                 std::coroutine_handle<> awaitingCoroutine_;
                 LockAwaiter *next_;
             };
@@ -144,6 +162,13 @@ namespace async_framework
             {
             public:
                 using LockAwaiter::LockAwaiter;
+
+                ScopedLockAwaiter coAwait(Executor *ex) noexcept
+                {
+                    ex_ = ex;
+                    return *this;
+                }
+
                 [[nodiscard]] std::unique_lock<Mutex> await_resume() noexcept
                 {
                     return std::unique_lock<Mutex>{mutex_, std::adopt_lock};
@@ -187,7 +212,8 @@ namespace async_framework
                         // Try to queue this waiter to the list of waiters.
                         void *newValue = awaiter;
                         awaiter->next_ = static_cast<LockAwaiter *>(oldValue);
-                        if (state_.compare_exchange_strong(oldValue, newValue, std::memory_order_acquire, std::memory_order_relaxed))
+                        // release: unlock()取出链表后会读取awaiter的各个字段
+                        if (state_.compare_exchange_strong(oldValue, newValue, std::memory_order_release, std::memory_order_relaxed))
                         {
                             return true;
                         }
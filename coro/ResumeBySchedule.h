@@ -25,7 +25,7 @@ namespace async_framework::coro
                 future_.setContinuation([continuation, ex](Try<T> &&t) mutable
                                         {
                     if(ex != nullptr){
-                        ex->schedule(continuation);
+                        ex->scheduleHandle(continuation);
                     }else{
                         continuation.resume();
                     } });
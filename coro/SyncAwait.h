@@ -1,9 +1,11 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include "../Common.h"
 #include "../Executor.h"
 #include "../Try.h"
-#include "../util/Condition.h"
+#include "../util/Futex.h"
 
 namespace async_framework
 {
@@ -19,15 +21,26 @@ namespace async_framework
             {
                 logicAssert(!executor->currentThreadInExecutor(), "do not sync await in the same executor with Lazy");
             }
-            util::Condition cond;
             using ValueType = typename std::decay_t<LazyType>::ValueType;
 
+            // 0: 未完成，1: 完成，2: 有线程在futex上等待，只有这时才需要唤醒
+            std::atomic<uint32_t> state{0};
             Try<ValueType> value;
-            std::move(std::forward<LazyType>(lazy)).start([&cond, &value](Try<ValueType> result)
+            std::move(std::forward<LazyType>(lazy)).start([&state, &value](Try<ValueType> result)
                                                           {
                 value = std::move(result);
-                cond.release(); });
-            cond.acquire();
+                if (state.exchange(1, std::memory_order_acq_rel) == 2)
+                {
+                    util::futexWakeAll(state);
+                } });
+            uint32_t expected = 0;
+            if (state.compare_exchange_strong(expected, 2, std::memory_order_acquire))
+            {
+                do
+                {
+                    util::futexWait(state, uint32_t(2));
+                } while (state.load(std::memory_order_acquire) != 1);
+            }
             return std::move(value).value();
         }
 
@@ -26,7 +26,7 @@ namespace async_framework
                     FinalAwaiter final_suspend() noexcept { return FinalAwaiter(ctx_); }
                     struct FinalAwaiter
                     {
-                        FinalAwaiter(Executor::Context ctx) : ctx_(ctx_) {}
+                        FinalAwaiter(Executor::Context ctx) : ctx_(ctx) {}
                         bool await_ready() const noexcept { return false; }
 
                         template <typename PromiseType>
@@ -90,6 +90,7 @@ namespace async_framework
                         pr.ctx_ = pr.ex_->checkout();
                     }
                     pr.continuation_ = continuation;
+                    return coro_;
                 }
 
             private:
@@ -117,7 +118,7 @@ namespace async_framework
                 {
                     if constexpr (std::is_same_v<AwaitSuspendResultType, bool>)
                     {
-                        bool should_suspend = awaiter_.await_suspend(viaCoroutine_.getWrappedContinuation(continuation););
+                        bool should_suspend = awaiter_.await_suspend(viaCoroutine_.getWrappedContinuation(continuation));
                         // TODO: if should_suspend is false, checkout/checkin should not be
                         // called.
                         if (should_suspend == false)
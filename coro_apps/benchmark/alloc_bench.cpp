@@ -0,0 +1,196 @@
+// 统计各个调度路径每次提交的堆分配次数和耗时。替换全局operator new计数，
+// 包括worker线程中的分配。
+// schedule(Func): std::function超过自身的小对象缓冲就要分配；
+// scheduleTask/schedule_move_only: 闭包不超过kTaskInlineSize时放在TaskFunc的内联缓冲中；
+// scheduleHandle: co_await Yield{}恢复协程，不需要包装；
+// future via: Promise/Future的continuation经过executor执行。
+//
+// g++ -std=c++20 -O2 -I../.. alloc_bench.cpp -o alloc_bench -ltbb -lpthread
+// ./alloc_bench [threads] [ops]
+#include "../../Future.h"
+#include "../../Promise.h"
+#include "../../coro/Lazy.h"
+#include "../../coro/SyncAwait.h"
+#include "../../executors/SimpleExecutor.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace async_framework;
+
+namespace
+{
+    std::atomic<size_t> allocations{0};
+}
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new(size_t size, std::align_val_t align)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    auto a = static_cast<size_t>(align);
+    if (auto p = std::aligned_alloc(a, (size + a - 1) / a * a))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Config
+    {
+        size_t threads = 2;
+        size_t ops = 200000;
+    };
+
+    struct Counter
+    {
+        std::atomic<size_t> done{0};
+        size_t target = 0;
+
+        void add()
+        {
+            if (done.fetch_add(1, std::memory_order_acq_rel) + 1 == target)
+                done.notify_one();
+        }
+
+        void wait()
+        {
+            for (auto n = done.load(std::memory_order_acquire); n != target; n = done.load(std::memory_order_acquire))
+                done.wait(n, std::memory_order_acquire);
+        }
+    };
+
+    // 闭包捕获的负载，Bytes决定闭包的大小
+    template <size_t Bytes>
+    struct Payload
+    {
+        Counter *counter;
+        std::array<char, Bytes> data{};
+
+        void operator()() const
+        {
+            counter->add();
+        }
+    };
+
+    template <size_t Bytes>
+    struct MoveOnlyPayload : Payload<Bytes>
+    {
+        MoveOnlyPayload(Counter *c) : Payload<Bytes>{c} {}
+        MoveOnlyPayload(MoveOnlyPayload &&) noexcept = default;
+        MoveOnlyPayload(const MoveOnlyPayload &) = delete;
+    };
+
+    struct Measure
+    {
+        const char *name;
+        size_t ops;
+        size_t startAllocations = allocations.load(std::memory_order_relaxed);
+        Clock::time_point start = Clock::now();
+
+        ~Measure()
+        {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            auto n = allocations.load(std::memory_order_relaxed) - startAllocations;
+            std::printf("%-26s ops=%zu allocs/op=%.2f per-op=%.1fns\n", name, ops, static_cast<double>(n) / ops,
+                        static_cast<double>(ns) / ops);
+        }
+    };
+
+    template <typename Submit>
+    void runSubmit(const char *name, Executor &ex, size_t ops, Submit &&submit)
+    {
+        Counter counter;
+        counter.target = ops;
+        {
+            Measure measure{name, ops};
+            for (size_t i = 0; i < ops; i++)
+                submit(ex, &counter);
+            counter.wait();
+        }
+    }
+
+    void runYield(Executor &ex, size_t ops)
+    {
+        auto loop = [](size_t n) -> coro::Lazy<>
+        {
+            for (size_t i = 0; i < n; i++)
+                co_await coro::Yield{};
+        };
+        Measure measure{"scheduleHandle (Yield)", ops};
+        coro::syncAwait(loop(ops).via(&ex));
+    }
+
+    void runFutureVia(Executor &ex, size_t ops)
+    {
+        Counter counter;
+        counter.target = ops;
+        {
+            Measure measure{"future via+thenValue", ops};
+            for (size_t i = 0; i < ops; i++)
+            {
+                Promise<int> p;
+                p.getFuture().via(&ex).thenValue([&counter](int)
+                                                 { counter.add(); });
+                p.setValue(1);
+            }
+            counter.wait();
+        }
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Config config;
+    if (argc > 1)
+        config.threads = std::strtoul(argv[1], nullptr, 10);
+    if (argc > 2)
+        config.ops = std::strtoul(argv[2], nullptr, 10);
+    executors::SimpleExecutor ex(config.threads);
+    std::printf("threads=%zu kTaskInlineSize=%zu\n", config.threads, util::kTaskInlineSize);
+
+    runSubmit("schedule(Func) 8B", ex, config.ops, [](Executor &ex, Counter *c)
+              { ex.schedule(Payload<0>{c}); });
+    runSubmit("schedule(Func) 40B", ex, config.ops, [](Executor &ex, Counter *c)
+              { ex.schedule(Payload<32>{c}); });
+    runSubmit("scheduleTask 40B", ex, config.ops, [](Executor &ex, Counter *c)
+              { ex.scheduleTask(Payload<32>{c}); });
+    runSubmit("scheduleTask 104B", ex, config.ops, [](Executor &ex, Counter *c)
+              { ex.scheduleTask(Payload<96>{c}); });
+    runSubmit("schedule_move_only 40B", ex, config.ops, [](Executor &ex, Counter *c)
+              { ex.schedule_move_only(MoveOnlyPayload<32>{c}); });
+    runYield(ex, config.ops);
+    runFutureVia(ex, config.ops);
+    return 0;
+}
@@ -0,0 +1,138 @@
+// Promise/Future往返的耗时和每次往返的堆分配次数。
+// 和池化之前的实现比较时，用第二条命令重新编译: 不使用FutureState的内存池，
+// continuation的内联缓冲退回move_only_function默认的16字节。
+//
+// g++ -std=c++20 -O2 -I../.. future_bench.cpp -o future_bench -ltbb -lpthread
+// g++ -std=c++20 -O2 -I../.. -DASYNC_FRAMEWORK_NO_FUTURE_STATE_POOL -DASYNC_FRAMEWORK_CONTINUATION_INLINE_SIZE=16 future_bench.cpp -o future_bench_unpooled -ltbb -lpthread
+// ./future_bench [ops] [threads]
+#include "../../Future.h"
+#include "../../Promise.h"
+#include "../../executors/SimpleExecutor.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace async_framework;
+
+namespace
+{
+    std::atomic<size_t> allocations{0};
+}
+
+void *operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Config
+    {
+        size_t ops = 1000000;
+        size_t threads = 2;
+    };
+
+    template <typename Body>
+    void measure(const char *name, size_t ops, Body &&body)
+    {
+        auto startAllocations = allocations.load(std::memory_order_relaxed);
+        auto start = Clock::now();
+        body();
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        auto n = allocations.load(std::memory_order_relaxed) - startAllocations;
+        std::printf("%-22s ops=%zu allocs/op=%.2f per-op=%.1fns\n", name, ops, static_cast<double>(n) / ops,
+                    static_cast<double>(ns) / ops);
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Config config;
+    if (argc > 1)
+        config.ops = std::strtoul(argv[1], nullptr, 10);
+    if (argc > 2)
+        config.threads = std::strtoul(argv[2], nullptr, 10);
+#ifdef ASYNC_FRAMEWORK_NO_FUTURE_STATE_POOL
+    const char *variant = "unpooled";
+#else
+    const char *variant = "pooled";
+#endif
+    std::printf("FutureState %s, continuation inline size %d\n", variant, ASYNC_FRAMEWORK_CONTINUATION_INLINE_SIZE);
+    executors::SimpleExecutor ex(config.threads);
+
+    // 同一个线程内setValue再get
+    measure("set+get", config.ops, [&]
+            {
+        for (size_t i = 0; i < config.ops; i++)
+        {
+            Promise<int> p;
+            auto f = p.getFuture();
+            p.setValue(int(i));
+            if (std::move(f).get() != int(i))
+                std::abort();
+        } });
+
+    // 先挂continuation再setValue，continuation就地执行
+    measure("thenValue x1", config.ops, [&]
+            {
+        for (size_t i = 0; i < config.ops; i++)
+        {
+            Promise<int> p;
+            auto f = p.getFuture().thenValue([](int x)
+                                             { return x + 1; });
+            p.setValue(int(i));
+            if (std::move(f).get() != int(i) + 1)
+                std::abort();
+        } });
+
+    // continuation捕获32字节，超过默认的16字节内联缓冲
+    measure("thenValue x3 capture", config.ops, [&]
+            {
+        for (size_t i = 0; i < config.ops; i++)
+        {
+            uint64_t a = i, b = i + 1, c = i + 2, d = i + 3;
+            Promise<uint64_t> p;
+            auto f = p.getFuture()
+                         .thenValue([a, b, c, d](uint64_t x)
+                                    { return x + a + b + c + d; })
+                         .thenValue([a, b, c, d](uint64_t x)
+                                    { return x - a - b - c - d; })
+                         .thenValue([](uint64_t x)
+                                    { return x; });
+            p.setValue(i);
+            if (std::move(f).get() != i)
+                std::abort();
+        } });
+
+    // 在worker上setValue，FutureState在另一个线程释放
+    measure("cross-thread", config.ops / 10, [&]
+            {
+        for (size_t i = 0; i < config.ops / 10; i++)
+        {
+            Promise<int> p;
+            auto f = p.getFuture().via(&ex).thenValue([](int x)
+                                                      { return x + 1; });
+            ex.schedule_move_only([p = std::move(p), i]() mutable
+                                  { p.setValue(int(i)); });
+            if (std::move(f).get() != int(i) + 1)
+                std::abort();
+        } });
+    return 0;
+}
@@ -0,0 +1,117 @@
+// 比较coro::Mutex、coro::SpinLock和SerialExecutor(strand)保护同一个计数器的开销。
+// 每个协程循环加锁、自增、解锁，strand则把自增作为任务提交。
+//
+// g++ -std=c++20 -O2 -I../.. lock_bench.cpp -o lock_bench -ltbb -lpthread
+// ./lock_bench [threads] [coroutines] [increments]
+#include "../../coro/Collect.h"
+#include "../../coro/Mutex.h"
+#include "../../coro/SpinLock.h"
+#include "../../coro/SyncAwait.h"
+#include "../../executors/SerialExecutor.h"
+#include "../../executors/SimpleExecutor.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace async_framework;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Config
+    {
+        size_t threads = 4;
+        size_t coroutines = 8;
+        size_t increments = 200000;
+    };
+
+    void report(const char *name, const Config &config, Clock::time_point start, size_t counter)
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        std::printf("%-10s threads=%zu coroutines=%zu counter=%zu total=%.1fms per-op=%.1fns%s\n", name, config.threads,
+                    config.coroutines, counter, ns / 1e6, static_cast<double>(ns) / config.increments,
+                    counter == config.increments ? "" : " MISMATCH");
+    }
+
+    template <typename Lock>
+    void runLock(const char *name, const Config &config)
+    {
+        executors::SimpleExecutor ex(config.threads);
+        Lock lock;
+        size_t counter = 0;
+        auto worker = [&](size_t n) -> coro::Lazy<>
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                co_await lock.coLock();
+                counter++;
+                lock.unlock();
+            }
+        };
+        std::vector<coro::Lazy<>> workers;
+        for (size_t i = 0; i < config.coroutines; i++)
+        {
+            auto begin = config.increments * i / config.coroutines;
+            auto end = config.increments * (i + 1) / config.coroutines;
+            workers.push_back(worker(end - begin));
+        }
+        auto start = Clock::now();
+        coro::syncAwait([&]() -> coro::Lazy<>
+                        { co_await coro::collectAllPara(std::move(workers)); }()
+                                                                                   .via(&ex));
+        report(name, config, start, counter);
+    }
+
+    void runStrand(const Config &config)
+    {
+        executors::SimpleExecutor ex(config.threads);
+        executors::SerialExecutor strand(&ex);
+        size_t counter = 0;
+        std::atomic<size_t> done{0};
+        auto worker = [&](size_t n) -> coro::Lazy<>
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                strand.schedule([&]
+                                {
+                    // strand中的任务一次只执行一个，counter不需要同步
+                    counter++;
+                    if (done.fetch_add(1, std::memory_order_release) + 1 == config.increments)
+                        done.notify_one(); });
+            }
+            co_return;
+        };
+        std::vector<coro::Lazy<>> workers;
+        for (size_t i = 0; i < config.coroutines; i++)
+        {
+            auto begin = config.increments * i / config.coroutines;
+            auto end = config.increments * (i + 1) / config.coroutines;
+            workers.push_back(worker(end - begin));
+        }
+        auto start = Clock::now();
+        coro::syncAwait([&]() -> coro::Lazy<>
+                        { co_await coro::collectAllPara(std::move(workers)); }()
+                                                                                   .via(&ex));
+        for (auto n = done.load(std::memory_order_acquire); n != config.increments; n = done.load(std::memory_order_acquire))
+            done.wait(n, std::memory_order_acquire);
+        report("strand", config, start, counter);
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Config config;
+    if (argc > 1)
+        config.threads = std::strtoul(argv[1], nullptr, 10);
+    if (argc > 2)
+        config.coroutines = std::strtoul(argv[2], nullptr, 10);
+    if (argc > 3)
+        config.increments = std::strtoul(argv[3], nullptr, 10);
+    runLock<coro::Mutex>("Mutex", config);
+    runLock<coro::SpinLock>("SpinLock", config);
+    runStrand(config);
+    return 0;
+}
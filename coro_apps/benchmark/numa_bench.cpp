@@ -0,0 +1,164 @@
+// 验证NUMA感知调度的局部性收益。每个缓冲由某个node上的worker分配并首次写入，
+// 页面落在该node的内存上，之后提交扫描缓冲的内存密集任务:
+// local: 扫描任务带上缓冲所在的node提示，留在本node执行；
+// remote: 故意提示到下一个node，每次读都跨node；
+// unbound: 不绑核、不带提示，相当于以前的ThreadPool，分配和扫描落在哪里都有可能。
+// 空闲worker最终会跨node偷取，remote测到的差距是下限。只有一个node的机器上三者应该接近。
+//
+// g++ -std=c++20 -O2 -I../.. numa_bench.cpp -o numa_bench -ltbb -lpthread
+// ./numa_bench [threads] [chunk-mb] [chunks-per-worker] [passes]
+#include "../../util/ThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace async_framework;
+using util::ThreadPool;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Config
+    {
+        size_t threads = std::thread::hardware_concurrency();
+        size_t chunkMb = 16;
+        size_t chunksPerWorker = 2;
+        size_t passes = 4;
+    };
+
+    struct Chunk
+    {
+        std::unique_ptr<uint64_t[]> data;
+        size_t words = 0;
+        // 分配时的node编号，-1表示不指定
+        int32_t node = -1;
+    };
+
+    struct Counter
+    {
+        std::atomic<size_t> done{0};
+        size_t target = 0;
+
+        void add()
+        {
+            if (done.fetch_add(1, std::memory_order_acq_rel) + 1 == target)
+                done.notify_one();
+        }
+
+        void wait()
+        {
+            for (auto n = done.load(std::memory_order_acquire); n != target; n = done.load(std::memory_order_acquire))
+                done.wait(n, std::memory_order_acquire);
+        }
+    };
+
+    std::atomic<uint64_t> sink{0};
+
+    // 在node上的worker中分配并写入每个缓冲，页面在首次写入时分配到该node
+    std::vector<Chunk> allocate(ThreadPool &pool, const Config &config, bool hinted)
+    {
+        std::vector<Chunk> chunks;
+        for (size_t i = 0; i < static_cast<size_t>(pool.getThreadNum()) * config.chunksPerWorker; i++)
+        {
+            Chunk chunk;
+            chunk.words = config.chunkMb * 1024 * 1024 / sizeof(uint64_t);
+            if (hinted)
+                chunk.node = static_cast<int32_t>(pool.getWorkerNode(i % pool.getThreadNum()));
+            chunks.push_back(std::move(chunk));
+        }
+        Counter counter;
+        counter.target = chunks.size();
+        for (auto &chunk : chunks)
+        {
+            pool.scheduleById([&chunk, &counter]
+                              {
+                chunk.data.reset(new uint64_t[chunk.words]);
+                for (size_t i = 0; i < chunk.words; i++)
+                    chunk.data[i] = i;
+                counter.add(); },
+                              -1, ThreadPool::kDefaultPriority, chunk.node);
+        }
+        counter.wait();
+        return chunks;
+    }
+
+    // nodeOf返回扫描任务的node提示，name为空时只预热不输出
+    template <typename NodeOf>
+    void scan(const char *name, ThreadPool &pool, const std::vector<Chunk> &chunks, const Config &config, NodeOf &&nodeOf)
+    {
+        Counter counter;
+        counter.target = chunks.size();
+        auto start = Clock::now();
+        for (auto &chunk : chunks)
+        {
+            pool.scheduleById([&chunk, &counter, passes = config.passes]
+                              {
+                uint64_t sum = 0;
+                for (size_t p = 0; p < passes; p++)
+                    for (size_t i = 0; i < chunk.words; i++)
+                        sum += chunk.data[i];
+                sink.fetch_add(sum, std::memory_order_relaxed);
+                counter.add(); },
+                              -1, ThreadPool::kDefaultPriority, nodeOf(chunk));
+        }
+        counter.wait();
+        if (!name)
+            return;
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        double bytes = static_cast<double>(chunks.size()) * config.chunkMb * 1024 * 1024 * config.passes;
+        std::printf("%-8s threads=%zu nodes=%zu chunks=%zu total=%.1fms bandwidth=%.2fGB/s\n", name, static_cast<size_t>(pool.getThreadNum()),
+                    pool.getNodeNum(), chunks.size(), ns / 1e6, bytes / ns);
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Config config;
+    if (argc > 1)
+        config.threads = std::strtoul(argv[1], nullptr, 10);
+    if (argc > 2)
+        config.chunkMb = std::strtoul(argv[2], nullptr, 10);
+    if (argc > 3)
+        config.chunksPerWorker = std::strtoul(argv[3], nullptr, 10);
+    if (argc > 4)
+        config.passes = std::strtoul(argv[4], nullptr, 10);
+    {
+        ThreadPool pool(config.threads, false, true, ThreadPool::QUEUE_TYPE::WORK_STEALING_DEQUE);
+        if (pool.getNodeNum() < 2)
+            std::printf("only one NUMA node, local and remote are expected to match\n");
+        // 按worker顺序列出的node编号，remote把任务提示到列表中的下一个node
+        std::vector<int32_t> nodes;
+        for (int32_t i = 0; i < pool.getThreadNum(); i++)
+        {
+            auto node = static_cast<int32_t>(pool.getWorkerNode(i));
+            if (nodes.empty() || nodes.back() != node)
+                nodes.push_back(node);
+        }
+        auto chunks = allocate(pool, config, true);
+        scan(nullptr, pool, chunks, config, [](const Chunk &chunk)
+             { return chunk.node; });
+        scan("local", pool, chunks, config, [](const Chunk &chunk)
+             { return chunk.node; });
+        scan("remote", pool, chunks, config, [&](const Chunk &chunk)
+             {
+            size_t i = 0;
+            while (nodes[i] != chunk.node)
+                i++;
+            return nodes[(i + 1) % nodes.size()]; });
+    }
+    {
+        ThreadPool pool(config.threads, false, false, ThreadPool::QUEUE_TYPE::WORK_STEALING_DEQUE);
+        auto chunks = allocate(pool, config, false);
+        scan(nullptr, pool, chunks, config, [](const Chunk &)
+             { return -1; });
+        scan("unbound", pool, chunks, config, [](const Chunk &)
+             { return -1; });
+    }
+    return 0;
+}
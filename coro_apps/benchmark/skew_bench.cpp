@@ -0,0 +1,212 @@
+// 突发提交下各个placement策略造成的队列长度偏斜。采样线程定期读取每个worker的
+// pendingTaskCount，统计worker之间队列长度的方差和最大值。
+// external: 多个外部线程一次提交一批任务后休眠一会儿；
+// internal: 每批任务由worker中的任务提交，CALLER_LOCAL会把整批留在提交者的队列里。
+// 使用MUTEX_QUEUE，分别在关闭和打开enableWorkSteal时测量。
+//
+// g++ -std=c++20 -O2 -I../.. skew_bench.cpp -o skew_bench -ltbb -lpthread
+// ./skew_bench [threads] [submitters] [bursts] [burst-size] [task-us]
+#include "../../util/ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace async_framework;
+using util::PLACEMENT_TYPE;
+using util::ThreadPool;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Config
+    {
+        size_t threads = 8;
+        size_t submitters = 2;
+        size_t bursts = 200;
+        size_t burstSize = 64;
+        size_t taskUs = 2;
+    };
+
+    struct Policy
+    {
+        const char *name;
+        PLACEMENT_TYPE type;
+    };
+
+    constexpr Policy kPolicies[] = {
+        {"random", PLACEMENT_TYPE::RANDOM},
+        {"two-choices", PLACEMENT_TYPE::TWO_CHOICES},
+        {"round-robin", PLACEMENT_TYPE::ROUND_ROBIN},
+        {"caller-local", PLACEMENT_TYPE::CALLER_LOCAL},
+    };
+
+    struct Counter
+    {
+        std::atomic<size_t> done{0};
+        size_t target = 0;
+
+        void add()
+        {
+            if (done.fetch_add(1, std::memory_order_acq_rel) + 1 == target)
+                done.notify_one();
+        }
+
+        void wait()
+        {
+            for (auto n = done.load(std::memory_order_acquire); n != target; n = done.load(std::memory_order_acquire))
+                done.wait(n, std::memory_order_acquire);
+        }
+    };
+
+    // 忙等模拟一个很短的任务
+    void work(size_t us)
+    {
+        auto end = Clock::now() + std::chrono::microseconds(us);
+        while (Clock::now() < end)
+        {
+        }
+    }
+
+    // 队列长度的采样统计，只统计有任务排队的样本
+    class Sampler
+    {
+    public:
+        explicit Sampler(ThreadPool &pool) : pool_(pool), thread_([this]
+                                                                  { run(); }) {}
+
+        ~Sampler()
+        {
+            stop();
+        }
+
+        void stop()
+        {
+            stop_.store(true, std::memory_order_relaxed);
+            if (thread_.joinable())
+                thread_.join();
+        }
+
+        void print(const char *workload, const char *policy, bool steal) const
+        {
+            auto n = samples_ ? static_cast<double>(samples_) : 1.0;
+            std::printf("%-8s %-12s steal=%d samples=%zu mean-depth=%.1f variance=%.1f max-depth=%.1f\n", workload, policy, steal,
+                        samples_, meanSum_ / n, varianceSum_ / n, maxSum_ / n);
+        }
+
+    private:
+        void run()
+        {
+            while (!stop_.load(std::memory_order_relaxed))
+            {
+                auto stats = pool_.getWorkerStats();
+                size_t workers = static_cast<size_t>(pool_.getThreadNum());
+                double sum = 0, sq = 0, max = 0;
+                for (size_t i = 0; i < workers; i++)
+                {
+                    double depth = static_cast<double>(stats[i].pendingTaskCount);
+                    sum += depth;
+                    sq += depth * depth;
+                    max = std::max(max, depth);
+                }
+                if (sum > 0)
+                {
+                    double mean = sum / workers;
+                    meanSum_ += mean;
+                    varianceSum_ += sq / workers - mean * mean;
+                    maxSum_ += max;
+                    samples_++;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+
+        ThreadPool &pool_;
+        std::atomic<bool> stop_{false};
+        size_t samples_ = 0;
+        double meanSum_ = 0;
+        double varianceSum_ = 0;
+        double maxSum_ = 0;
+        std::thread thread_;
+    };
+
+    void runExternal(const Config &config, const Policy &policy, bool steal)
+    {
+        ThreadPool pool(config.threads, steal, false, ThreadPool::QUEUE_TYPE::MUTEX_QUEUE, ThreadPool::IdlePolicy(),
+                        ThreadPool::ElasticPolicy(), policy.type);
+        Counter counter;
+        counter.target = config.submitters * config.bursts * config.burstSize;
+        Sampler sampler(pool);
+        std::vector<std::thread> submitters;
+        for (size_t s = 0; s < config.submitters; s++)
+        {
+            submitters.emplace_back([&]
+                                    {
+                for (size_t b = 0; b < config.bursts; b++)
+                {
+                    for (size_t i = 0; i < config.burstSize; i++)
+                        pool.scheduleById([&]
+                                          {
+                            work(config.taskUs);
+                            counter.add(); });
+                    // 两批之间的间隔大约是一批任务在所有worker上执行完的时间
+                    std::this_thread::sleep_for(std::chrono::microseconds(config.burstSize * config.taskUs / config.threads));
+                } });
+        }
+        for (auto &thread : submitters)
+            thread.join();
+        counter.wait();
+        sampler.stop();
+        sampler.print("external", policy.name, steal);
+    }
+
+    void runInternal(const Config &config, const Policy &policy, bool steal)
+    {
+        ThreadPool pool(config.threads, steal, false, ThreadPool::QUEUE_TYPE::MUTEX_QUEUE, ThreadPool::IdlePolicy(),
+                        ThreadPool::ElasticPolicy(), policy.type);
+        Counter counter;
+        counter.target = config.submitters * config.bursts * config.burstSize;
+        Sampler sampler(pool);
+        for (size_t b = 0; b < config.submitters * config.bursts; b++)
+        {
+            pool.scheduleById([&]
+                              {
+                for (size_t i = 0; i < config.burstSize; i++)
+                    pool.scheduleById([&]
+                                      {
+                        work(config.taskUs);
+                        counter.add(); }); });
+            std::this_thread::sleep_for(std::chrono::microseconds(config.burstSize * config.taskUs / config.threads / config.submitters));
+        }
+        counter.wait();
+        sampler.stop();
+        sampler.print("internal", policy.name, steal);
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Config config;
+    if (argc > 1)
+        config.threads = std::strtoul(argv[1], nullptr, 10);
+    if (argc > 2)
+        config.submitters = std::strtoul(argv[2], nullptr, 10);
+    if (argc > 3)
+        config.bursts = std::strtoul(argv[3], nullptr, 10);
+    if (argc > 4)
+        config.burstSize = std::strtoul(argv[4], nullptr, 10);
+    if (argc > 5)
+        config.taskUs = std::strtoul(argv[5], nullptr, 10);
+    for (bool steal : {false, true})
+    {
+        for (auto &policy : kPolicies)
+            runExternal(config, policy, steal);
+        for (auto &policy : kPolicies)
+            runInternal(config, policy, steal);
+    }
+    return 0;
+}
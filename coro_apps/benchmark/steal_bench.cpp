@@ -0,0 +1,129 @@
+// 比较ThreadPool两种队列在1/4/16/64个worker下调度短任务的吞吐。
+// spawn: 每个任务在worker内部再提交两个子任务，直到给定深度，走worker本地的push/pop和偷取；
+// inject: 一个外部线程连续提交任务，走外部提交(注入队列)的路径。
+//
+// g++ -std=c++20 -O2 -I../.. steal_bench.cpp -o steal_bench -ltbb -lpthread
+// ./steal_bench [roots] [depth] [inject-tasks] [threads...]
+#include "../../util/ThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace async_framework;
+using util::ThreadPool;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Config
+    {
+        size_t roots = 64;
+        size_t depth = 12;
+        size_t injectTasks = 500000;
+        std::vector<size_t> threads{1, 4, 16, 64};
+    };
+
+    struct Mode
+    {
+        const char *name;
+        bool enableWorkSteal;
+        ThreadPool::QUEUE_TYPE queueType;
+    };
+
+    constexpr Mode kModes[] = {
+        {"mutex", false, ThreadPool::QUEUE_TYPE::MUTEX_QUEUE},
+        {"mutex+steal", true, ThreadPool::QUEUE_TYPE::MUTEX_QUEUE},
+        {"chase-lev", false, ThreadPool::QUEUE_TYPE::WORK_STEALING_DEQUE},
+    };
+
+    struct Counter
+    {
+        std::atomic<size_t> done{0};
+        size_t target = 0;
+
+        void add()
+        {
+            if (done.fetch_add(1, std::memory_order_acq_rel) + 1 == target)
+                done.notify_one();
+        }
+
+        void wait()
+        {
+            for (auto n = done.load(std::memory_order_acquire); n != target; n = done.load(std::memory_order_acquire))
+                done.wait(n, std::memory_order_acquire);
+        }
+    };
+
+    void spawn(ThreadPool *pool, Counter *counter, size_t depth)
+    {
+        if (depth > 0)
+        {
+            for (int i = 0; i < 2; i++)
+                pool->scheduleById([pool, counter, depth]
+                                   { spawn(pool, counter, depth - 1); });
+        }
+        counter->add();
+    }
+
+    void report(const char *workload, const Mode &mode, size_t threads, size_t tasks, Clock::time_point start)
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+        std::printf("%-7s %-12s threads=%-3zu tasks=%zu total=%.1fms throughput=%.2fM/s\n", workload, mode.name, threads, tasks,
+                    ns / 1e6, tasks * 1e3 / ns);
+    }
+
+    void runSpawn(const Config &config, const Mode &mode, size_t threads)
+    {
+        ThreadPool pool(threads, mode.enableWorkSteal, false, mode.queueType);
+        Counter counter;
+        // 每棵树有2^(depth+1)-1个任务
+        counter.target = config.roots * ((size_t(2) << config.depth) - 1);
+        auto start = Clock::now();
+        for (size_t i = 0; i < config.roots; i++)
+            pool.scheduleById([&pool, &counter, depth = config.depth]
+                              { spawn(&pool, &counter, depth); });
+        counter.wait();
+        report("spawn", mode, threads, counter.target, start);
+    }
+
+    void runInject(const Config &config, const Mode &mode, size_t threads)
+    {
+        ThreadPool pool(threads, mode.enableWorkSteal, false, mode.queueType);
+        Counter counter;
+        counter.target = config.injectTasks;
+        auto start = Clock::now();
+        for (size_t i = 0; i < config.injectTasks; i++)
+            pool.scheduleById([&counter]
+                              { counter.add(); });
+        counter.wait();
+        report("inject", mode, threads, counter.target, start);
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    Config config;
+    if (argc > 1)
+        config.roots = std::strtoul(argv[1], nullptr, 10);
+    if (argc > 2)
+        config.depth = std::strtoul(argv[2], nullptr, 10);
+    if (argc > 3)
+        config.injectTasks = std::strtoul(argv[3], nullptr, 10);
+    if (argc > 4)
+    {
+        config.threads.clear();
+        for (int i = 4; i < argc; i++)
+            config.threads.push_back(std::strtoul(argv[i], nullptr, 10));
+    }
+    for (auto threads : config.threads)
+    {
+        for (auto &mode : kModes)
+            runSpawn(config, mode, threads);
+        for (auto &mode : kModes)
+            runInject(config, mode, threads);
+    }
+    return 0;
+}
@@ -9,10 +9,10 @@
 #include <sys/socket.h>
 #include "IoContext.h"
 #include "Socket.h"
-#include "async_simple/coro/Lazy.h"
+#include "../../coro/Lazy.h"
 
 // 假设Socket::fd_已经是no_block模式
-async_simple::coro::Lazy<int> connect(Socket *sock, const sockaddr *serverAdder) {
+async_framework::coro::Lazy<int> connect(Socket *sock, const sockaddr *serverAdder) {
     int ret = ::connect(sock->fd_, serverAdder, sizeof(*serverAdder));
     while (ret == -1 && (errno == EINPROGRESS)) {
         if (sock->addEvents(EPOLLOUT)) {
@@ -24,7 +24,7 @@ async_simple::coro::Lazy<int> connect(Socket *sock, const sockaddr *serverAdder)
     co_return ret;
 }
 
-async_simple::coro::Lazy<int> send(Socket *sock, void *buffer, size_t len) {
+async_framework::coro::Lazy<int> send(Socket *sock, void *buffer, size_t len) {
     int ret = ::send(sock->fd_, buffer, len, 0);
     while (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
         if (sock->addEvents(EPOLLOUT)) {
@@ -36,7 +36,7 @@ async_simple::coro::Lazy<int> send(Socket *sock, void *buffer, size_t len) {
     co_return ret;
 }
 
-async_simple::coro::Lazy<int> recv(Socket *sock, void *buffer, size_t len) {
+async_framework::coro::Lazy<int> recv(Socket *sock, void *buffer, size_t len) {
     int ret = ::recv(sock->fd_, buffer, len, 0);
     while (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
         if (sock->addEvents(EPOLLIN)) {
@@ -48,7 +48,7 @@ async_simple::coro::Lazy<int> recv(Socket *sock, void *buffer, size_t len) {
     co_return ret;
 }
 
-async_simple::coro::Lazy<int> accept(Socket *sock) {
+async_framework::coro::Lazy<int> accept(Socket *sock) {
     struct sockaddr_storage addr{};
     socklen_t len = sizeof(addr);
     int ret = ::accept(sock->fd_, reinterpret_cast<sockaddr *>(&addr), &len);
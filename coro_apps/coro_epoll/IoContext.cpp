@@ -3,10 +3,11 @@
 //
 #include "IoContext.h"
 #include "Socket.h"
-#include "async_simple/coro/SpinLock.h"
+#include <vector>
+#include "../../coro/SpinLock.h"
 
 IoContext::IoContext(int maxEvents,
-                     async_simple::Executor *executor)
+                     async_framework::Executor *executor)
     : maxEvents_(maxEvents), executor_(executor) {
     epoll_fd_ = epoll_create1(0);
     if (epoll_fd_ == -1) {
@@ -25,6 +26,7 @@ IoContext::IoContext(IoContext &&other) {
     maxEvents_ = std::exchange(other.maxEvents_, 0);
     executor_ = std::exchange(other.executor_, nullptr);
     eventPool_ = std::exchange(other.eventPool_, nullptr);
+    aio_ = std::exchange(other.aio_, nullptr);
 }
 
 IoContext &IoContext::operator=(IoContext &&other) {
@@ -32,6 +34,7 @@ IoContext &IoContext::operator=(IoContext &&other) {
     std::swap(maxEvents_, other.maxEvents_);
     std::swap(executor_, other.executor_);
     std::swap(eventPool_, other.eventPool_);
+    std::swap(aio_, other.aio_);
     return *this;
 }
 
@@ -39,10 +42,46 @@ IoContext::~IoContext() {
     delete[] eventPool_;
 }
 
+bool IoContext::watch(async_framework::executors::SimpleIOExecutor *aio) {
+    if (aio == nullptr || aio->eventFd() < 0 || aio_ != nullptr) {
+        return false;
+    }
+    // ONESHOT: 收割完成后再重新监听，收割任务排队期间不会重复提交
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.ptr = aio;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, aio->eventFd(), &ev) == -1) {
+        return false;
+    }
+    aio_ = aio;
+    return true;
+}
+
+void IoContext::reapAio() {
+    auto reap = [aio = aio_, epoll_fd = epoll_fd_]() {
+        aio->reap();
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLONESHOT;
+        ev.data.ptr = aio;
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, aio->eventFd(), &ev);
+    };
+    if (executor_ == nullptr || !executor_->schedule(reap)) {
+        reap();
+    }
+}
+
 void IoContext::run() {
+    // 一轮epoll_wait就绪的协程攒成一批提交给executor，只唤醒一次worker
+    std::vector<std::coroutine_handle<>> ready;
+    ready.reserve(maxEvents_);
     while (true) {
         int nfds = epoll_wait(epoll_fd_, eventPool_, maxEvents_, -1);
+        ready.clear();
         for (int i = 0; i < nfds; ++i) {
+            if (aio_ != nullptr && eventPool_[i].data.ptr == aio_) {
+                reapAio();
+                continue;
+            }
             auto sock = static_cast<Socket *>(eventPool_[i].data.ptr);
             const auto events = eventPool_[i].events;
             sock->waited_events_ = events;
@@ -52,11 +91,19 @@ void IoContext::run() {
                 // 出错或者关闭，交给上层处理错误
                 ::close(sock->fd_);
                 sock->fd_ = -1;
-                executor_->schedule(sock->h_);
+                ready.push_back(sock->h_);
                 continue;
             }
             epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, sock->fd_, nullptr);
-            executor_->schedule(sock->h_);
+            ready.push_back(sock->h_);
+        }
+        size_t scheduled = 0;
+        if (executor_ != nullptr) {
+            scheduled = executor_->scheduleHandleBatch(ready);
+        }
+        // 没有executor或调度失败的协程在当前线程恢复
+        for (auto i = scheduled; i < ready.size(); ++i) {
+            ready[i].resume();
         }
     }
 }
@@ -6,13 +6,13 @@
 #define IOCONTEXT_H
 
 #include <sys/epoll.h>
-#include "async_simple/executors/SimpleExecutor.h"
+#include "../../executors/SimpleExecutor.h"
 
 class Socket;
 
 class IoContext {
 public:
-    IoContext(int maxEvents = 100, async_simple::Executor *executor = nullptr);
+    IoContext(int maxEvents = 100, async_framework::Executor *executor = nullptr);
     IoContext(const IoContext &other) = delete;
     IoContext &operator=(const IoContext &other) = delete;
     IoContext(IoContext &&other);
@@ -20,12 +20,19 @@ public:
     IoContext &operator=(IoContext &&other);
     ~IoContext();
     void run();
+    // 监听EVENTFD模式的SimpleIOExecutor，完成事件交给executor_的worker收割，
+    // 回调和协程恢复都发生在worker上，没有executor_时在run的线程中收割
+    bool watch(async_framework::executors::SimpleIOExecutor *aio);
+
+private:
+    void reapAio();
 
 public:
     int epoll_fd_;
     int maxEvents_;
-    async_simple::Executor *executor_;
+    async_framework::Executor *executor_;
     epoll_event *eventPool_;
+    async_framework::executors::SimpleIOExecutor *aio_ = nullptr;
 };
 
 #endif  // IOCONTEXT_H
\ No newline at end of file
@@ -41,14 +41,14 @@ bool Socket::attach2IoContext() {
         return false;
     const int epoll_fd = io_context_->epoll_fd_;
     epoll_event event{};
-    async_simple::coro::ScopedSpinLock Lock(io_state_lock_);
+    async_framework::coro::ScopedSpinLock Lock(io_state_lock_);
     event.events = listen_events_;
     event.data.ptr = this;
     const int ret = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd_, &event);
     return (ret != -1);
 }
 bool Socket::addEvents(const uint32_t events) {
-    async_simple::coro::ScopedSpinLock Lock(io_state_lock_);
+    async_framework::coro::ScopedSpinLock Lock(io_state_lock_);
     if ((listen_events_ & events) == events) {
         return true;
     }
@@ -60,7 +60,7 @@ bool Socket::addEvents(const uint32_t events) {
     return res != -1;
 }
 bool Socket::removeEvents(uint32_t events) {
-    async_simple::coro::ScopedSpinLock Lock(io_state_lock_);
+    async_framework::coro::ScopedSpinLock Lock(io_state_lock_);
     auto removed_events = listen_events_ & events;
     if (!removed_events)
         return true;
@@ -6,8 +6,8 @@
 #define SOCKET_H
 
 #include <IoContext.h>
-#include <async_simple/coro/SpinLock.h>
-#include <async_simple/executors/SimpleExecutor.h>
+#include "../../coro/SpinLock.h"
+#include "../../executors/SimpleExecutor.h"
 #include <fcntl.h>
 #include <sys/epoll.h>
 #include <coroutine>
@@ -47,7 +47,7 @@ public:
     // 实际监听到的事
     uint32_t waited_events_{0};
     // spin lock for listen_events_
-    async_simple::coro::SpinLock io_state_lock_{};
+    async_framework::coro::SpinLock io_state_lock_{};
     // 等待在当前socket的协程
     std::coroutine_handle<> h_{nullptr};
 };
@@ -7,7 +7,7 @@
 #include <asio/detail/socket_ops.hpp>
 #include "HookSysCall.hpp"
 
-async_simple::coro::Lazy<> client_send_impl(const sockaddr_in server_addr, IoContext *io_context, int nRound) {
+async_framework::coro::Lazy<> client_send_impl(const sockaddr_in server_addr, IoContext *io_context, int nRound) {
     Socket sock(AF_INET, SOCK_STREAM, 0, io_context);
     auto res = co_await connect(&sock, reinterpret_cast<const sockaddr *>((&server_addr)));
     if (res == -1) {
@@ -46,10 +46,10 @@ async_simple::coro::Lazy<> client_send_impl(const sockaddr_in server_addr, IoCon
     co_return;
 }
 
-async_simple::coro::Lazy<> client_send(IoContext *io_context, std::string host,
+async_framework::coro::Lazy<> client_send(IoContext *io_context, std::string host,
                                        int port, int nClients = 1024,
                                        int nRound = 1024) {
-    auto executor_ = co_await async_simple::CurrentExecutor{};
+    auto executor_ = co_await async_framework::CurrentExecutor{};
     sockaddr_in server_addr{};
     server_addr.sin_family = AF_INET;
     if (inet_pton(AF_INET, host.c_str(), &server_addr.sin_addr) != 1) {
@@ -68,7 +68,7 @@ async_simple::coro::Lazy<> client_send(IoContext *io_context, std::string host,
 }
 
 int main() {
-    async_simple::executors::SimpleExecutor executor{16};
+    async_framework::executors::SimpleExecutor executor{16};
     IoContext io_context(100, &executor);
 
     auto t = std::jthread(&IoContext::run, &io_context);
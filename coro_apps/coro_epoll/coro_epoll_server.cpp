@@ -1,14 +1,14 @@
 //
 // Created by xmh on 25-2-19.
 //
-#include <async_simple/coro/FutureAwaiter.h>
-#include <async_simple/executors/SimpleExecutor.h>
+#include "../../coro/FutureAwaiter.h"
+#include "../../executors/SimpleExecutor.h"
 #include <netinet/in.h>
 #include <memory>
 #include <thread>
 #include "HookSysCall.hpp"
 
-async_simple::coro::Lazy<> echo_server_impl(int fd, IoContext* io_context) {
+async_framework::coro::Lazy<> echo_server_impl(int fd, IoContext* io_context) {
     char buffer[2048] = {0};
     Socket sock(fd, io_context);
     while (true) {
@@ -40,10 +40,10 @@ async_simple::coro::Lazy<> echo_server_impl(int fd, IoContext* io_context) {
     co_return;
 }
 
-async_simple::coro::Lazy<> echo_server(Socket* server_sock) {
-    auto executor_ = co_await async_simple::CurrentExecutor{};
+async_framework::coro::Lazy<> echo_server(Socket* server_sock) {
+    auto executor_ = co_await async_framework::CurrentExecutor{};
     auto io_context = server_sock->io_context_;
-    async_simple::logicAssert(executor_,"executor is not allowed to be nullptr here!");
+    async_framework::logicAssert(executor_,"executor is not allowed to be nullptr here!");
     while (true) {
         auto fd = co_await accept(server_sock);
         if (fd == -1) {
@@ -90,7 +90,7 @@ int main() {
     }
 
     //
-    async_simple::executors::SimpleExecutor executor{16};
+    async_framework::executors::SimpleExecutor executor{16};
     IoContext io_context(100, &executor);
     Socket server_sock(server_fd, &io_context);
 
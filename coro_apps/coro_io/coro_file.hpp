@@ -17,9 +17,11 @@
 #include "../../Promise.h"
 #include "../../Traits.h"
 #include "../../coro/FutureAwaiter.h"
+#include "../../util/BufferPool.h"
 
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <span>
@@ -402,25 +404,101 @@ class basic_random_coro_file {
     open(filepath, open_flags);
   }
 
+  // Routes reads through aligned buffers taken from `pool`. With `direct`
+  // the file is opened with O_DIRECT, so reads skip the page cache and
+  // steady-state reads neither malloc nor page fault. Must be called before
+  // open(). With O_DIRECT, writes must use aligned offsets, sizes and
+  // buffers (e.g. a BufferPool::Buffer).
+  void set_buffer_pool(async_framework::util::BufferPool *pool,
+                       bool direct = true) {
+    buffer_pool_ = pool;
+    direct_ = pool != nullptr && direct;
+  }
+
+  async_framework::util::BufferPool *get_buffer_pool() { return buffer_pool_; }
+
   bool open(std::string_view filepath,
             std::ios::ios_base::openmode open_flags) {
     file_path_ = std::string{filepath};
+    int native_flags = to_flags(open_flags);
+#if !defined(ASIO_WINDOWS)
+    if (direct_) {
+      native_flags |= O_DIRECT;
+    }
+#endif
     if constexpr (execute_type == execution_type::thread_pool) {
-      return open_fd(filepath, to_flags(open_flags));
+      return open_fd(filepath, native_flags);
     }
     else {
 #if defined(ENABLE_FILE_IO_URING) || defined(ASIO_WINDOWS)
       return open_native_async_file<false>(async_random_file_,
                                            executor_wrapper_, filepath,
-                                           to_flags(open_flags));
+                                           static_cast<flags>(native_flags));
 #else
-      return open_fd(filepath, to_flags(open_flags));
+      return open_fd(filepath, native_flags);
 #endif
     }
   }
 
   async_framework::coro::Lazy<std::pair<std::error_code, size_t>> async_read_at(
       uint64_t offset, char *buf, size_t size) {
+    if (buffer_pool_ != nullptr) {
+      co_return co_await async_read_at_pooled(offset, buf, size);
+    }
+    co_return co_await async_read_at_impl(offset, buf, size);
+  }
+
+  // Reads straight into a pooled buffer without copying. offset and size
+  // must be aligned to BufferPool::kAlignment when the file uses O_DIRECT.
+  async_framework::coro::Lazy<std::pair<std::error_code, size_t>> async_read_at(
+      uint64_t offset, async_framework::util::BufferPool::Buffer &buffer,
+      size_t size) {
+    co_return co_await async_read_at_impl(offset, buffer.data(),
+                                          std::min(size, buffer.size()));
+  }
+
+ private:
+  // 按kAlignment对齐读入池中的buffer，再拷贝出请求的部分
+  async_framework::coro::Lazy<std::pair<std::error_code, size_t>>
+  async_read_at_pooled(uint64_t offset, char *buf, size_t size) {
+    constexpr uint64_t align = async_framework::util::BufferPool::kAlignment;
+    uint64_t end = offset + size;
+    uint64_t aligned_end = (end + align - 1) & ~(align - 1);
+    uint64_t pos = offset;
+    auto buffer = buffer_pool_->allocate(
+        std::min<uint64_t>(aligned_end - (offset & ~(align - 1)),
+                           async_framework::util::BufferPool::kMaxBufferSize));
+    if (!buffer) {
+      co_return std::make_pair(
+          std::make_error_code(std::errc::not_enough_memory), 0);
+    }
+    while (pos < end) {
+      uint64_t aligned = pos & ~(align - 1);
+      size_t length = std::min<uint64_t>(aligned_end - aligned, buffer.size());
+      auto [ec, read_size] =
+          co_await async_read_at_impl(aligned, buffer.data(), length);
+      if (ec) {
+        co_return std::make_pair(ec, pos - offset);
+      }
+      size_t skip = pos - aligned;
+      if (read_size <= skip) {
+        eof_ = true;
+        break;
+      }
+      size_t take = std::min<uint64_t>(read_size - skip, end - pos);
+      memcpy(buf + (pos - offset), buffer.data() + skip, take);
+      pos += take;
+      if (read_size < length) {
+        // 文件结束
+        eof_ = true;
+        break;
+      }
+    }
+    co_return std::make_pair(std::error_code{}, pos - offset);
+  }
+
+  async_framework::coro::Lazy<std::pair<std::error_code, size_t>>
+  async_read_at_impl(uint64_t offset, char *buf, size_t size) {
     if constexpr (execute_type == execution_type::thread_pool) {
       co_return co_await async_pread(offset, buf, size);
     }
@@ -445,6 +523,7 @@ class basic_random_coro_file {
     }
   }
 
+ public:
   async_framework::coro::Lazy<std::pair<std::error_code, size_t>> async_write_at(
       uint64_t offset, std::string_view buf) {
     if constexpr (execute_type == execution_type::thread_pool) {
@@ -657,6 +736,8 @@ class basic_random_coro_file {
   std::shared_ptr<int> prw_random_file_ = nullptr;  // pread/pwrite random file
   std::string file_path_;
   bool eof_ = false;
+  async_framework::util::BufferPool *buffer_pool_ = nullptr;
+  bool direct_ = false;
 };
 
 using random_coro_file = basic_random_coro_file<>;
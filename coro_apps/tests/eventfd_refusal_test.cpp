@@ -0,0 +1,58 @@
+// SimpleIOExecutor在EVENTFD模式下被io_submit拒绝(-EAGAIN)时不能丢失请求：
+// 没有在途请求时，被拒绝的请求要通过eventfd重新唤醒调用方，由reap()再次提交。
+// 使用fake_libaio中的替身libaio，不需要真实的AIO。
+//
+// g++ -std=c++20 -g -I../.. -Ifake_libaio eventfd_refusal_test.cpp -o eventfd_refusal_test -ltbb -lpthread
+// ./eventfd_refusal_test
+#include "../../executors/SimpleIOExecutor.h"
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <poll.h>
+#include <vector>
+
+using namespace async_framework;
+
+int main()
+{
+    char path[] = "/tmp/eventfd_refusal_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    unlink(path);
+    std::vector<char> data(1 << 16, 'q');
+    assert(pwrite(fd, data.data(), data.size(), 0) == static_cast<ssize_t>(data.size()));
+
+    executors::SimpleIOExecutor io(8, executors::SimpleIOExecutor::COMPLETION_MODE::EVENTFD);
+    bool inited = io.init();
+    assert(inited);
+
+    std::vector<char> buf(4096);
+    size_t polls = 0;
+    for (int i = 0; i < 2000; i++)
+    {
+        // 每轮先被拒绝0~3次
+        fakeAioRefusals = i % 4;
+        bool done = false;
+        io.submitIO(fd, IOCB_CMD_PREAD, buf.data(), buf.size(), 0, [&](io_event_t &event)
+                    {
+            assert(static_cast<int64_t>(event.res) == static_cast<int64_t>(buf.size()));
+            done = true; });
+        while (!done)
+        {
+            pollfd p{io.eventFd(), POLLIN, 0};
+            if (::poll(&p, 1, 1000) != 1)
+            {
+                std::printf("stuck at round %d\n", i);
+                return 1;
+            }
+            io.reap();
+            polls++;
+        }
+        assert(buf[0] == 'q');
+    }
+    io.destroy();
+    close(fd);
+    std::printf("ok polls=%zu\n", polls);
+    return 0;
+}
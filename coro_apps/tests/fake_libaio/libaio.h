@@ -0,0 +1,168 @@
+// 测试用的libaio替身，只实现SimpleIOExecutor用到的部分。
+// io_submit在调用线程同步完成读写并把事件放入队列；fakeAioRefusals大于0时，
+// 每次io_submit都先消耗一次额度并整体返回-EAGAIN，用来模拟内核拒绝提交。
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <sys/uio.h>
+#include <unistd.h>
+
+struct iocb;
+
+struct io_event
+{
+    void *data;
+    struct iocb *obj;
+    unsigned long res;
+    unsigned long res2;
+};
+
+struct io_iocb_common
+{
+    void *buf;
+    unsigned long nbytes;
+    long long offset;
+    char __pad3;
+    unsigned flags;
+    unsigned resfd;
+};
+
+struct iocb
+{
+    void *data;
+    unsigned key;
+    short aio_lio_opcode;
+    short aio_reqprio;
+    int aio_fildes;
+    union
+    {
+        struct io_iocb_common c;
+    } u;
+};
+
+struct io_context
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<io_event> events;
+    long maxEvents = 0;
+    long inflight = 0;
+};
+typedef struct io_context *io_context_t;
+
+// 剩余的拒绝次数
+inline std::atomic<int> fakeAioRefusals{0};
+
+inline int io_setup(int maxEvents, io_context_t *ctx)
+{
+    *ctx = new io_context;
+    (*ctx)->maxEvents = maxEvents;
+    return 0;
+}
+
+inline int io_destroy(io_context_t ctx)
+{
+    delete ctx;
+    return 0;
+}
+
+inline void io_set_eventfd(struct iocb *io, int fd)
+{
+    io->u.c.flags |= 1;
+    io->u.c.resfd = fd;
+}
+
+inline int io_submit(io_context_t ctx, long n, struct iocb **ios)
+{
+    if (fakeAioRefusals.load() > 0 && fakeAioRefusals.fetch_sub(1) > 0)
+    {
+        return -EAGAIN;
+    }
+    long i = 0;
+    for (; i < n; i++)
+    {
+        auto io = ios[i];
+        if (io->aio_fildes < 0)
+        {
+            if (i == 0)
+                return -EBADF;
+            break;
+        }
+        {
+            std::lock_guard lock(ctx->mutex);
+            if (ctx->inflight >= ctx->maxEvents)
+            {
+                if (i == 0)
+                    return -EAGAIN;
+                break;
+            }
+            ctx->inflight++;
+        }
+        long r = 0;
+        auto &c = io->u.c;
+        switch (io->aio_lio_opcode)
+        {
+        case 0:
+            r = pread(io->aio_fildes, c.buf, c.nbytes, c.offset);
+            break;
+        case 1:
+            r = pwrite(io->aio_fildes, c.buf, c.nbytes, c.offset);
+            break;
+        case 2:
+        case 3:
+            r = fsync(io->aio_fildes);
+            break;
+        case 7:
+            r = preadv(io->aio_fildes, static_cast<const iovec *>(c.buf), static_cast<int>(c.nbytes), c.offset);
+            break;
+        case 8:
+            r = pwritev(io->aio_fildes, static_cast<const iovec *>(c.buf), static_cast<int>(c.nbytes), c.offset);
+            break;
+        default:
+            break;
+        }
+        if (r < 0)
+            r = -errno;
+        {
+            std::lock_guard lock(ctx->mutex);
+            ctx->events.push_back(io_event{io->data, io, static_cast<unsigned long>(r), 0});
+        }
+        ctx->cv.notify_one();
+        if (c.flags & 1)
+        {
+            uint64_t one = 1;
+            (void)!write(static_cast<int>(c.resfd), &one, sizeof(one));
+        }
+    }
+    return static_cast<int>(i);
+}
+
+inline int io_getevents(io_context_t ctx, long minN, long maxN, struct io_event *out, struct timespec *timeout)
+{
+    std::unique_lock lock(ctx->mutex);
+    auto ready = [&]
+    { return static_cast<long>(ctx->events.size()) >= minN; };
+    if (timeout)
+    {
+        ctx->cv.wait_for(lock, std::chrono::seconds(timeout->tv_sec) + std::chrono::nanoseconds(timeout->tv_nsec), ready);
+    }
+    else
+    {
+        ctx->cv.wait(lock, ready);
+    }
+    long n = 0;
+    while (n < maxN && !ctx->events.empty())
+    {
+        out[n++] = ctx->events.front();
+        ctx->events.pop_front();
+        ctx->inflight--;
+    }
+    return static_cast<int>(n);
+}
@@ -0,0 +1,133 @@
+// Future::wait()之后还要能继续thenValue/via/get。wait()会把挂起的then链收拢成一个延续，
+// 之后再挂的回调必须接在已经完成的结果上，而不是丢失或者执行两次。
+//
+// g++ -std=c++20 -g -I../.. future_wait_then_test.cpp -o future_wait_then_test -ltbb -lpthread
+// ./future_wait_then_test
+#include "../../Future.h"
+#include "../../Promise.h"
+#include "../../executors/SimpleExecutor.h"
+#include <cassert>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+using namespace async_framework;
+
+namespace
+{
+    using Pool = util::ThreadPool;
+
+    // wait之后继续thenValue
+    void waitThenValue(Executor *ex)
+    {
+        Promise<int> p;
+        auto f = p.getFuture().via(ex).thenValue([](int x)
+                                                 { return x + 1; });
+        std::thread t([&]
+                      { p.setValue(1); });
+        f.wait();
+        t.join();
+        assert(f.hasResult());
+        auto g = std::move(f).thenValue([](int x)
+                                        { return x * 10; });
+        assert(std::move(g).get() == 20);
+    }
+
+    // wait之后切换到另一个executor继续
+    void waitThenVia(Executor *ex, Executor *other)
+    {
+        Promise<int> p;
+        auto f = p.getFuture().via(ex).thenValue([](int x)
+                                                 { return x + 1; });
+        std::thread t([&]
+                      { p.setValue(2); });
+        f.wait();
+        t.join();
+        auto g = std::move(f).via(other).thenValue([](int x)
+                                                   { return x * 10; });
+        assert(std::move(g).get() == 30);
+    }
+
+    // 重复wait
+    void waitTwice()
+    {
+        Promise<int> p;
+        auto f = p.getFuture().thenValue([](int x)
+                                         { return x + 1; });
+        p.setValue(5);
+        f.wait();
+        f.wait();
+        assert(std::move(f).get() == 6);
+    }
+
+    // wait之前结果已经就绪
+    void readyBeforeWait(Executor *ex)
+    {
+        Promise<std::string> p;
+        auto f = p.getFuture().via(ex).thenValue([](std::string s)
+                                                 { return s + "b"; });
+        p.setValue(std::string("a"));
+        f.wait();
+        assert(f.hasResult());
+        f.wait();
+        assert(std::move(f).thenValue([](std::string s)
+                                      { return s + "c"; })
+                   .get() == "abc");
+    }
+
+    // void结果中的异常在wait之后继续传递
+    void waitThenException()
+    {
+        Promise<void> p;
+        auto f = p.getFuture().thenValue([]
+                                         { throw std::runtime_error("x"); });
+        std::thread t([&]
+                      { p.setValue(); });
+        f.wait();
+        t.join();
+        bool caught = false;
+        try
+        {
+            std::move(f).thenTry([](Try<void> &&t)
+                                 { t.value(); })
+                .get();
+        }
+        catch (const std::runtime_error &)
+        {
+            caught = true;
+        }
+        assert(caught);
+    }
+
+    // setValue与wait并发
+    void stress(Executor *ex, Executor *other, int rounds)
+    {
+        for (int i = 0; i < rounds; i++)
+        {
+            Promise<int> p;
+            auto f = p.getFuture().via(ex).thenValue([](int x)
+                                                     { return x + 1; });
+            other->schedule([p = std::move(p), i]() mutable
+                            { p.setValue(int(i)); });
+            f.wait();
+            assert(std::move(f).thenValue([](int x)
+                                          { return x * 2; })
+                       .get() == 2 * (i + 1));
+        }
+    }
+} // namespace
+
+int main()
+{
+    executors::SimpleExecutor ex(2, Pool::QUEUE_TYPE::MUTEX_QUEUE);
+    executors::SimpleExecutor other(2, Pool::QUEUE_TYPE::MUTEX_QUEUE);
+    waitThenValue(&ex);
+    waitThenVia(&ex, &other);
+    waitTwice();
+    readyBeforeWait(&ex);
+    waitThenException();
+    stress(&ex, &other, 20000);
+    std::printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,62 @@
+// 没有executor的IoContext要在run()所在的线程里恢复就绪的协程。
+// 用socketpair的一端挂一个读协程，另一端写入3个字节，协程必须被唤醒并读到数据。
+//
+// g++ -std=c++20 -g -I../.. -I../coro_epoll ioctx_no_executor_test.cpp ../coro_epoll/IoContext.cpp ../coro_epoll/Socket.cpp -o ioctx_no_executor_test -ltbb -lpthread
+// ./ioctx_no_executor_test
+#include "../../coro/Lazy.h"
+#include "../coro_epoll/IoContext.h"
+#include "../coro_epoll/Socket.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace async_framework;
+
+namespace
+{
+    std::atomic<bool> done{false};
+
+    coro::Lazy<> reader(Socket *sock)
+    {
+        auto events = co_await SocketAwaiter(sock);
+        char buf[8];
+        auto n = ::read(sock->fd_, buf, sizeof(buf));
+        if ((events & EPOLLIN) && n == 3)
+        {
+            done = true;
+        }
+    }
+} // namespace
+
+int main()
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) != 0)
+    {
+        std::perror("socketpair");
+        return 1;
+    }
+    IoContext io(100);
+    Socket sock(fds[0], &io, EPOLLIN | EPOLLONESHOT);
+    reader(&sock).start([](auto &&) {});
+    // run()不会返回，测试结束时直接_exit
+    std::thread([&]
+                { io.run(); })
+        .detach();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    if (::write(fds[1], "abc", 3) != 3)
+    {
+        std::perror("write");
+        _exit(1);
+    }
+    for (int i = 0; i < 200 && !done; i++)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    std::printf(done ? "ok\n" : "reader was never resumed\n");
+    std::fflush(stdout);
+    _exit(done ? 0 : 1);
+}
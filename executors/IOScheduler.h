@@ -0,0 +1,485 @@
+#pragma once
+
+#include "../IOExecutor.h"
+#include "../util/BufferPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace async_framework
+{
+    namespace executors
+    {
+        // IOScheduler is a stage in front of another IOExecutor. It limits how
+        // many requests each fd has in flight, prefers foreground requests
+        // over background ones, and merges reads while they wait:
+        //
+        // - Requests beyond maxDepthPerFd queue per fd and class. A slot freed
+        //   on the fd goes to the foreground queue first. Background requests
+        //   never use more than half of the fd's depth, so foreground requests
+        //   always find room.
+        // - When a read leaves the queue, the contiguous or overlapping
+        //   IOCB_CMD_PREADs queued behind it on the same fd and class are
+        //   merged into one backend read of at most maxMergeBytes. The result
+        //   is copied back into each caller's buffer. Reads are never merged
+        //   across a queued write, fsync or vectored request. As with the
+        //   backends, requests in flight together may finish in any order.
+        // - Requests wait, and so can merge, while the fd is at its depth
+        //   limit. A Batch collects requests explicitly and hands them over
+        //   together, so they can merge even on an idle fd. There is no timed
+        //   merge window: a read on an idle fd is dispatched at once, because a
+        //   reader that waits for each read before issuing the next never has
+        //   two reads queued, and a window would only add to its latency.
+        //
+        // The class of a request is the class of the ClassScope active on the
+        // submitting thread, FOREGROUND by default. stat() reports the merge
+        // ratio and the submit-to-completion latency per class.
+        //
+        // All requests must complete before the IOScheduler is destroyed.
+        class IOScheduler : public IOExecutor
+        {
+        public:
+            enum class IO_CLASS
+            {
+                FOREGROUND = 0,
+                BACKGROUND,
+            };
+
+            struct ClassStat
+            {
+                // 调用者提交的请求数
+                uint64_t requests = 0;
+                // 发给后端的请求数
+                uint64_t dispatches = 0;
+                // 合并进其它读请求的请求数
+                uint64_t merged = 0;
+                uint64_t completed = 0;
+                uint64_t totalLatencyUs = 0;
+                uint64_t maxLatencyUs = 0;
+
+                // 平均每个后端请求包含的调用者请求数
+                double mergeRatio() const
+                {
+                    return dispatches == 0 ? 1.0 : static_cast<double>(dispatches + merged) / dispatches;
+                }
+
+                double averageLatencyUs() const
+                {
+                    return completed == 0 ? 0.0 : static_cast<double>(totalLatencyUs) / completed;
+                }
+            };
+
+            // 作用域内当前线程提交的请求属于cls
+            class ClassScope
+            {
+            public:
+                explicit ClassScope(IO_CLASS cls) : prev_(currentClass())
+                {
+                    currentClass() = cls;
+                }
+                ~ClassScope()
+                {
+                    currentClass() = prev_;
+                }
+                ClassScope(const ClassScope &) = delete;
+                ClassScope &operator=(const ClassScope &) = delete;
+
+            private:
+                IO_CLASS prev_;
+            };
+
+            class Batch;
+
+        public:
+            explicit IOScheduler(IOExecutor *backend, size_t maxDepthPerFd = 32, size_t maxMergeBytes = 1 << 20)
+                : backend_(backend), maxDepth_(std::max<size_t>(maxDepthPerFd, 1)),
+                  maxBackground_(std::max<size_t>(maxDepth_ / 2, 1)), maxMergeBytes_(maxMergeBytes) {}
+            virtual ~IOScheduler() {}
+            IOScheduler(const IOScheduler &) = delete;
+            IOScheduler &operator=(const IOScheduler &) = delete;
+
+        public:
+            void submitIO(int fd, iocb_cmd cmd, void *buffer, size_t length, off_t offset, AIOCallback cbfn) override
+            {
+                enqueue(new Request{fd, currentClass(), cmd, buffer, length, offset, std::move(cbfn)});
+            }
+
+            void submitIOV(int fd, iocb_cmd cmd, const iovec_t *iov, size_t count, off_t offset, AIOCallback cbfn) override
+            {
+                enqueue(new Request{fd, currentClass(), cmd, const_cast<iovec_t *>(iov), count, offset, std::move(cbfn)});
+            }
+
+            void submitIO(int fd, iocb_cmd cmd, void *buffer, size_t length, off_t offset, IOCompletion *completion) override
+            {
+                enqueue(new Request{fd, currentClass(), cmd, buffer, length, offset, nullptr, completion});
+            }
+
+            void submitIOV(int fd, iocb_cmd cmd, const iovec_t *iov, size_t count, off_t offset, IOCompletion *completion) override
+            {
+                enqueue(new Request{fd, currentClass(), cmd, const_cast<iovec_t *>(iov), count, offset, nullptr, completion});
+            }
+
+            // 合并读的临时buffer也从pool中分配
+            bool setBufferPool(util::BufferPool *pool) override
+            {
+                bufferPool_ = pool;
+                return backend_->setBufferPool(pool);
+            }
+
+            ClassStat stat(IO_CLASS cls) const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return stats_[static_cast<size_t>(cls)];
+            }
+
+            // 排队等待发给后端的请求数
+            size_t pendingCount() const
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                size_t count = 0;
+                for (auto &[fd, state] : fds_)
+                {
+                    count += state.queues[0].size() + state.queues[1].size();
+                }
+                return count;
+            }
+
+            IOExecutor *backend() const
+            {
+                return backend_;
+            }
+
+        private:
+            friend class Batch;
+            using Clock = std::chrono::steady_clock;
+
+            struct Request
+            {
+                int fd;
+                IO_CLASS cls;
+                iocb_cmd cmd;
+                void *buffer;
+                size_t length;
+                off_t offset;
+                AIOCallback func;
+                IOCompletion *record = nullptr;
+                Clock::time_point start = Clock::now();
+
+                void complete(int64_t res)
+                {
+                    io_event_t event{record, nullptr, static_cast<uint64_t>(res), 0};
+                    if (record != nullptr)
+                        record->complete(record, event);
+                    else
+                        func(event);
+                }
+            };
+
+            // 发给后端的一个请求，合并时包含多个调用者请求
+            struct Dispatch : IOCompletion
+            {
+                IOScheduler *scheduler;
+                int fd;
+                IO_CLASS cls;
+                off_t offset = 0;
+                size_t length = 0;
+                std::vector<Request *> requests;
+                // 合并读的临时buffer，pooled非空时来自bufferPool_
+                char *scratch = nullptr;
+                util::BufferPool::Buffer pooled;
+            };
+
+            struct FdState
+            {
+                size_t inflight = 0;
+                size_t backgroundInflight = 0;
+                std::deque<Request *> queues[2];
+            };
+
+            // 合并时最多向后查看的排队请求数
+            static constexpr size_t kMergeScan = 64;
+
+            static IO_CLASS &currentClass()
+            {
+                static thread_local IO_CLASS cls = IO_CLASS::FOREGROUND;
+                return cls;
+            }
+
+            void enqueue(Request *request)
+            {
+                enqueue(&request, 1);
+            }
+
+            // 先把一批请求都放入队列再取出，同一批中的读请求可以互相合并
+            void enqueue(Request *const *requests, size_t count)
+            {
+                std::vector<Dispatch *> dispatches;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    auto now = Clock::now();
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        auto request = requests[i];
+                        // 在Batch中等待的时间不算作延迟
+                        request->start = now;
+                        stats_[static_cast<size_t>(request->cls)].requests++;
+                        fds_[request->fd].queues[static_cast<size_t>(request->cls)].push_back(request);
+                    }
+                    for (size_t i = 0; i < count; i++)
+                    {
+                        pump(requests[i]->fd, dispatches);
+                    }
+                }
+                issue(dispatches);
+            }
+
+            // fd还有空余深度时从队列中取出请求，需要持有mutex_
+            void pump(int fd, std::vector<Dispatch *> &dispatches)
+            {
+                auto &state = fds_[fd];
+                while (state.inflight < maxDepth_)
+                {
+                    IO_CLASS cls;
+                    if (!state.queues[0].empty())
+                        cls = IO_CLASS::FOREGROUND;
+                    else if (!state.queues[1].empty() && state.backgroundInflight < maxBackground_)
+                        cls = IO_CLASS::BACKGROUND;
+                    else
+                        break;
+                    auto dispatch = take(fd, cls, state.queues[static_cast<size_t>(cls)]);
+                    state.inflight++;
+                    if (cls == IO_CLASS::BACKGROUND)
+                        state.backgroundInflight++;
+                    auto &stat = stats_[static_cast<size_t>(cls)];
+                    stat.dispatches++;
+                    stat.merged += dispatch->requests.size() - 1;
+                    dispatches.push_back(dispatch);
+                }
+            }
+
+            // 取出队首请求，是读请求时把与它相邻或重叠的读合并进来
+            Dispatch *take(int fd, IO_CLASS cls, std::deque<Request *> &queue)
+            {
+                auto dispatch = new Dispatch;
+                dispatch->complete = &IOScheduler::onComplete;
+                dispatch->scheduler = this;
+                dispatch->fd = fd;
+                dispatch->cls = cls;
+                auto head = queue.front();
+                queue.pop_front();
+                dispatch->requests.push_back(head);
+                dispatch->offset = head->offset;
+                dispatch->length = head->length;
+                if (head->cmd != IOCB_CMD_PREAD)
+                {
+                    return dispatch;
+                }
+                auto begin = head->offset;
+                auto end = head->offset + static_cast<off_t>(head->length);
+                bool extended = true;
+                while (extended)
+                {
+                    extended = false;
+                    auto scan = std::min(queue.size(), kMergeScan);
+                    for (size_t i = 0; i < scan; i++)
+                    {
+                        auto request = queue[i];
+                        if (request->cmd != IOCB_CMD_PREAD)
+                            break;
+                        auto requestEnd = request->offset + static_cast<off_t>(request->length);
+                        if (request->offset > end || requestEnd < begin)
+                            continue;
+                        auto newBegin = std::min(begin, request->offset);
+                        auto newEnd = std::max(end, requestEnd);
+                        if (static_cast<size_t>(newEnd - newBegin) > maxMergeBytes_)
+                            continue;
+                        begin = newBegin;
+                        end = newEnd;
+                        dispatch->requests.push_back(request);
+                        queue.erase(queue.begin() + i);
+                        extended = true;
+                        break;
+                    }
+                }
+                dispatch->offset = begin;
+                dispatch->length = static_cast<size_t>(end - begin);
+                return dispatch;
+            }
+
+            // 在mutex_之外把请求交给后端，后端可能在submit中直接完成请求
+            void issue(std::vector<Dispatch *> &dispatches)
+            {
+                for (auto dispatch : dispatches)
+                {
+                    auto head = dispatch->requests.front();
+                    if (dispatch->requests.size() == 1)
+                    {
+                        if (head->cmd == IOCB_CMD_PREADV || head->cmd == IOCB_CMD_PWRITEV)
+                            backend_->submitIOV(dispatch->fd, head->cmd, static_cast<const iovec_t *>(head->buffer), head->length, head->offset, dispatch);
+                        else
+                            backend_->submitIO(dispatch->fd, head->cmd, head->buffer, head->length, head->offset, dispatch);
+                        continue;
+                    }
+                    if (bufferPool_ != nullptr && dispatch->length <= util::BufferPool::kMaxBufferSize)
+                    {
+                        dispatch->pooled = bufferPool_->allocate(dispatch->length);
+                        dispatch->scratch = dispatch->pooled.data();
+                    }
+                    else
+                    {
+                        auto length = (dispatch->length + util::BufferPool::kAlignment - 1) / util::BufferPool::kAlignment * util::BufferPool::kAlignment;
+                        dispatch->scratch = static_cast<char *>(aligned_alloc(util::BufferPool::kAlignment, length));
+                    }
+                    if (dispatch->scratch == nullptr)
+                    {
+                        io_event_t event{dispatch, nullptr, static_cast<uint64_t>(-ENOMEM), 0};
+                        onComplete(dispatch, event);
+                        continue;
+                    }
+                    backend_->submitIO(dispatch->fd, IOCB_CMD_PREAD, dispatch->scratch, dispatch->length, dispatch->offset, dispatch);
+                }
+            }
+
+            static void onComplete(IOCompletion *record, io_event_t &event)
+            {
+                auto dispatch = static_cast<Dispatch *>(record);
+                auto self = dispatch->scheduler;
+                auto res = static_cast<int64_t>(event.res);
+                auto now = Clock::now();
+                std::vector<Dispatch *> dispatches;
+                {
+                    std::lock_guard<std::mutex> lock(self->mutex_);
+                    auto &state = self->fds_[dispatch->fd];
+                    state.inflight--;
+                    if (dispatch->cls == IO_CLASS::BACKGROUND)
+                        state.backgroundInflight--;
+                    auto &stat = self->stats_[static_cast<size_t>(dispatch->cls)];
+                    for (auto request : dispatch->requests)
+                    {
+                        auto latency = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - request->start).count());
+                        stat.completed++;
+                        stat.totalLatencyUs += latency;
+                        stat.maxLatencyUs = std::max(stat.maxLatencyUs, latency);
+                    }
+                    self->pump(dispatch->fd, dispatches);
+                    if (state.inflight == 0 && state.queues[0].empty() && state.queues[1].empty())
+                    {
+                        self->fds_.erase(dispatch->fd);
+                    }
+                }
+                self->issue(dispatches);
+                if (dispatch->requests.size() == 1)
+                {
+                    dispatch->requests.front()->complete(res);
+                }
+                else
+                {
+                    // 把合并读的结果分给每个请求
+                    for (auto request : dispatch->requests)
+                    {
+                        if (res < 0)
+                        {
+                            request->complete(res);
+                            continue;
+                        }
+                        auto skip = static_cast<int64_t>(request->offset - dispatch->offset);
+                        auto n = std::clamp<int64_t>(res - skip, 0, static_cast<int64_t>(request->length));
+                        if (n > 0)
+                            memcpy(request->buffer, dispatch->scratch + skip, static_cast<size_t>(n));
+                        request->complete(n);
+                    }
+                    if (!dispatch->pooled)
+                        free(dispatch->scratch);
+                }
+                for (auto request : dispatch->requests)
+                {
+                    delete request;
+                }
+                delete dispatch;
+            }
+
+        private:
+            IOExecutor *backend_;
+            size_t maxDepth_;
+            size_t maxBackground_;
+            size_t maxMergeBytes_;
+            // 保护fds_和stats_
+            mutable std::mutex mutex_;
+            std::unordered_map<int, FdState> fds_;
+            ClassStat stats_[2];
+        };
+
+        // Batch collects requests for an IOScheduler and hands them over
+        // together on submit(), so reads in the same batch merge even when
+        // their fd is idle. Nothing is sent before submit() (or the
+        // destructor), so don't wait for a request of a batch that hasn't
+        // been submitted yet. A batch holds no thread state: it may be kept
+        // across a co_await and submitted from another thread, but it is
+        // not thread safe itself.
+        //
+        // The class of a request is the ClassScope active when it is added.
+        //
+        // e.g.
+        //  IOScheduler::Batch batch(scheduler);
+        //  for (auto &block : blocks)
+        //      batch.submitIO(fd, IOCB_CMD_PREAD, block.data, block.size, block.offset, &block.completion);
+        //  batch.submit();
+        class IOScheduler::Batch
+        {
+        public:
+            explicit Batch(IOScheduler &scheduler) : scheduler_(scheduler) {}
+            ~Batch()
+            {
+                submit();
+            }
+            Batch(const Batch &) = delete;
+            Batch &operator=(const Batch &) = delete;
+
+        public:
+            void submitIO(int fd, iocb_cmd cmd, void *buffer, size_t length, off_t offset, AIOCallback cbfn)
+            {
+                requests_.push_back(new Request{fd, currentClass(), cmd, buffer, length, offset, std::move(cbfn)});
+            }
+
+            void submitIOV(int fd, iocb_cmd cmd, const iovec_t *iov, size_t count, off_t offset, AIOCallback cbfn)
+            {
+                requests_.push_back(new Request{fd, currentClass(), cmd, const_cast<iovec_t *>(iov), count, offset, std::move(cbfn)});
+            }
+
+            void submitIO(int fd, iocb_cmd cmd, void *buffer, size_t length, off_t offset, IOCompletion *completion)
+            {
+                requests_.push_back(new Request{fd, currentClass(), cmd, buffer, length, offset, nullptr, completion});
+            }
+
+            void submitIOV(int fd, iocb_cmd cmd, const iovec_t *iov, size_t count, off_t offset, IOCompletion *completion)
+            {
+                requests_.push_back(new Request{fd, currentClass(), cmd, const_cast<iovec_t *>(iov), count, offset, nullptr, completion});
+            }
+
+            // 把攒下的请求交给scheduler，之后batch可以继续使用
+            void submit()
+            {
+                if (requests_.empty())
+                    return;
+                scheduler_.enqueue(requests_.data(), requests_.size());
+                requests_.clear();
+            }
+
+            size_t size() const
+            {
+                return requests_.size();
+            }
+
+        private:
+            using Request = IOScheduler::Request;
+
+            IOScheduler &scheduler_;
+            std::vector<Request *> requests_;
+        };
+    } // namespace executors
+} // namespace async_framework
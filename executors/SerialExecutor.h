@@ -0,0 +1,254 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include "../Common.h"
+#include "../Executor.h"
+#include "../util/MpscQueue.h"
+#include "../util/ThreadPool.h"
+
+namespace async_framework
+{
+    namespace executors
+    {
+        // SerialExecutor (a strand) runs the tasks submitted to it one at a
+        // time and in submission order, on the threads of the Executor it
+        // wraps. Protecting an object with a strand instead of coro::Mutex or
+        // coro::SpinLock means contended callers never spin or retry a CAS.
+        // A submit is one exchange on an MPSC queue plus one fetch_add.
+        //
+        // The submit that finds the strand idle schedules a drain task on the
+        // underlying executor. The drain runs queued tasks until the strand
+        // is empty, and re-schedules itself after kBatchSize tasks so a busy
+        // strand does not hold a worker forever.
+        //
+        // Use `co_await dispatch(&strand)` or `lazy.via(&strand)` to run a
+        // Lazy on the strand. The strand must outlive all tasks submitted to
+        // it.
+        class SerialExecutor : public Executor
+        {
+        public:
+            using Func = Executor::Func;
+            using TaskFunc = Executor::TaskFunc;
+            using Context = Executor::Context;
+
+            // schedule_info用于在executor上调度drain任务
+            explicit SerialExecutor(Executor *executor, uint64_t schedule_info = static_cast<uint64_t>(Priority::DEFAULT))
+                : Executor(executor != nullptr ? executor->name() : "default"), executor_(executor), scheduleInfo_(schedule_info)
+            {
+                logicAssert(executor != nullptr, "SerialExecutor needs an executor");
+            }
+
+            ~SerialExecutor()
+            {
+                while (auto node = queue_.pop())
+                    delete node;
+            }
+
+            Executor *executor() const noexcept
+            {
+                return executor_;
+            }
+
+        public:
+            using Executor::checkin;
+            using Executor::schedule;
+            using Executor::scheduleByKey;
+            using Executor::scheduleHandle;
+            using Executor::scheduleTask;
+            using Executor::scheduleTimer;
+
+            // strand中的任务按提交顺序执行，忽略schedule_info
+            bool schedule(Func func) override
+            {
+                return submit(new Node(TaskFunc(std::move(func))));
+            }
+
+            bool scheduleTask(TaskFunc task, uint64_t) override
+            {
+                if (task == nullptr)
+                    return false;
+                return submit(new Node(std::move(task)));
+            }
+
+            bool scheduleHandle(std::coroutine_handle<> handle, uint64_t) override
+            {
+                if (!handle)
+                    return false;
+                return submit(new Node(handle));
+            }
+
+            // strand中所有任务本来就有序
+            bool scheduleByKey(uint64_t, TaskFunc task, uint64_t schedule_info) override
+            {
+                return scheduleTask(std::move(task), schedule_info);
+            }
+
+            // 只有在本strand的drain中执行时返回true
+            bool currentThreadInExecutor() const override
+            {
+                return *getCurrent() == this;
+            }
+
+            ExecutorStat stat() const override
+            {
+                ExecutorStat stat;
+                stat.pendingTaskCount = pending_.load(std::memory_order_relaxed);
+                stat.executedTaskCount = executed_.load(std::memory_order_relaxed);
+                return stat;
+            }
+
+            size_t currentContextId() const override
+            {
+                return executor_->currentContextId();
+            }
+
+            // strand不绑定线程，Context只标识这个strand
+            Context checkout() override
+            {
+                return this;
+            }
+
+            bool checkin(Func func, Context ctx, ScheduleOptions opts) override
+            {
+                if (ctx == this && opts.prompt && currentThreadInExecutor())
+                {
+                    func();
+                    return true;
+                }
+                return schedule(std::move(func));
+            }
+
+            IOExecutor *getIOExecutor() override
+            {
+                return executor_->getIOExecutor();
+            }
+
+            // 定时器由被包装的executor管理，到期后任务进入strand
+            TimerToken scheduleTimer(Func func, Duration dur, uint64_t) override
+            {
+                return executor_->scheduleTimer([this, func = std::move(func)]() mutable
+                                                { schedule(std::move(func)); },
+                                                dur, scheduleInfo_);
+            }
+
+            bool cancelTimer(TimerToken token) override
+            {
+                return executor_->cancelTimer(token);
+            }
+
+        protected:
+            void schedule(Func func, Duration dur) override
+            {
+                TimerAccess::scheduleAfter(executor_, [this, func = std::move(func)]() mutable
+                                           { schedule(std::move(func)); },
+                                           dur);
+            }
+
+            void schedule(Func func, Duration dur, uint64_t) override
+            {
+                schedule(std::move(func), dur);
+            }
+
+        private:
+            struct Node : util::MpscNode
+            {
+                explicit Node(TaskFunc task) : fn(std::move(task)) {}
+                explicit Node(std::coroutine_handle<> h) : handle(h) {}
+
+                TaskFunc fn = nullptr;
+                // 非空时直接resume，不经过fn
+                std::coroutine_handle<> handle = nullptr;
+            };
+
+            // 借用Executor的受保护接口，把定时任务交给被包装的executor
+            struct TimerAccess : Executor
+            {
+                static void scheduleAfter(Executor *executor, Func func, Duration dur)
+                {
+                    void (Executor::*timed)(Func, Duration) = &TimerAccess::schedule;
+                    (executor->*timed)(std::move(func), dur);
+                }
+            };
+
+            // drain每次最多执行的任务数，之后重新调度自己，让出worker
+            static constexpr size_t kBatchSize = 64;
+
+            static const SerialExecutor **getCurrent()
+            {
+                static thread_local const SerialExecutor *current = nullptr;
+                return &current;
+            }
+
+            bool submit(Node *node)
+            {
+                queue_.push(node);
+                if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0)
+                {
+                    // 任务已经入队，executor拒绝时由当前线程执行drain，
+                    // pending_没有归零之前不会有其它drain，顺序仍然保证
+                    if (!scheduleDrain())
+                        AS_UNLIKELY
+                        {
+                            drain();
+                        }
+                }
+                return true;
+            }
+
+            bool scheduleDrain()
+            {
+                return executor_->scheduleTask([this]
+                                               { drain(); },
+                                               scheduleInfo_);
+            }
+
+            void drain()
+            {
+                auto current = getCurrent();
+                auto prev = *current;
+                *current = this;
+                size_t ran = 0;
+                auto count = pending_.load(std::memory_order_acquire);
+                while (true)
+                {
+                    auto n = std::min(count, kBatchSize);
+                    for (size_t i = 0; i < n; i++)
+                    {
+                        Node *node;
+                        // pending_计数过的任务一定会链接上，只是生产者可能还没完成push
+                        while ((node = queue_.pop()) == nullptr)
+                            util::cpuRelax();
+                        if (node->handle)
+                            node->handle.resume();
+                        else
+                            node->fn();
+                        delete node;
+                    }
+                    executed_.fetch_add(n, std::memory_order_relaxed);
+                    count = pending_.fetch_sub(n, std::memory_order_acq_rel) - n;
+                    if (count == 0)
+                        break;
+                    ran += n;
+                    if (ran >= kBatchSize)
+                    {
+                        // 重新调度失败时继续在当前线程执行
+                        if (scheduleDrain())
+                            break;
+                        ran = 0;
+                    }
+                }
+                *current = prev;
+            }
+
+            Executor *executor_;
+            uint64_t scheduleInfo_;
+            util::MpscQueue<Node> queue_;
+            // 已提交但还没执行完的任务数，从0变为1的提交者负责调度drain
+            alignas(util::kCacheLineSize) std::atomic<size_t> pending_{0};
+            std::atomic<uint64_t> executed_{0};
+        };
+    } // namespace executors
+} // namespace async_framework
@@ -0,0 +1,610 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../Executor.h"
+#include "../coro/Dispatch.h"
+#include "../coro/Lazy.h"
+#include "../util/Queue.h"
+#include "../util/RingQueue.h"
+#include "../util/SpscRing.h"
+#include "../util/ThreadPool.h"
+#include "../util/TimerWheel.h"
+#include "../util/WorkerStat.h"
+
+namespace async_framework
+{
+    namespace executors
+    {
+        // ShardedExecutor runs one thread per shard, each pinned to its own core,
+        // in the shard-per-core style of Seastar. A shard owns its data and only
+        // runs the tasks submitted to it. Tasks are never stolen.
+        //
+        // Every ordered pair of shards is connected by an SpscRing, so a message
+        // from one shard to another is a slot write plus a release store, with
+        // no lock. Threads outside the executor submit through a per-shard
+        // mutex queue. When a ring is full the sender keeps the message in a
+        // local overflow queue and retries from its own loop, so two shards
+        // flooding each other cannot deadlock.
+        //
+        // shard(i) is an Executor bound to shard i, and a Lazy running on it
+        // stays on that shard. `co_await switchTo(i)` moves the current Lazy to
+        // shard i, and `co_await submitTo(i, lazy)` runs lazy on shard i and
+        // then returns to the caller's executor.
+        //
+        // schedule_info is ignored: a shard runs its tasks in FIFO order.
+        class ShardedExecutor : public Executor
+        {
+        public:
+            using Func = Executor::Func;
+            using TaskFunc = Executor::TaskFunc;
+            using Context = Executor::Context;
+
+            // ringCapacity是每对shard之间ring的容量，必须是2的幂
+            explicit ShardedExecutor(size_t shardNum = std::thread::hardware_concurrency(), bool enableCoreBindings = true,
+                                     size_t ringCapacity = 128);
+            ~ShardedExecutor();
+
+            size_t shardNum() const
+            {
+                return shards_.size();
+            }
+            // 当前线程所在的shard，不在本executor中时返回-1
+            int32_t currentShard() const;
+            // 绑定到shard id的Executor
+            Executor *shard(size_t id);
+
+            // 在shard上执行task，调用者是同一个shard时放入本地队列
+            bool submitTo(size_t shard, TaskFunc task);
+            // 在shard上执行lazy，完成后回到调用者原来的executor
+            template <typename T>
+            coro::Lazy<T> submitTo(size_t shard, coro::Lazy<T> lazy);
+            // co_await switchTo(shard)把当前Lazy调度到shard上继续执行
+            coro::detail::DispatchAwaitable switchTo(size_t shard);
+
+        public:
+            using Executor::checkin;
+            using Executor::schedule;
+            using Executor::scheduleByKey;
+            using Executor::scheduleHandle;
+            using Executor::scheduleTask;
+            using Executor::scheduleTimer;
+
+            // 在shard内调用时留在当前shard，否则轮流分给各个shard
+            bool schedule(Func func) override
+            {
+                return submit(pickShard(), Task{TaskFunc(std::move(func)), nullptr, util::steadyNowNs()});
+            }
+
+            bool scheduleTask(TaskFunc task, uint64_t) override
+            {
+                if (task == nullptr)
+                    return false;
+                return submit(pickShard(), Task{std::move(task), nullptr, util::steadyNowNs()});
+            }
+
+            bool scheduleHandle(std::coroutine_handle<> handle, uint64_t) override
+            {
+                if (!handle)
+                    return false;
+                return submit(pickShard(), Task{nullptr, handle, util::steadyNowNs()});
+            }
+
+            // key决定shard，同一个key的任务在同一个shard上按顺序执行
+            bool scheduleByKey(uint64_t key, TaskFunc task, uint64_t) override
+            {
+                if (task == nullptr)
+                    return false;
+                return submit(key % shards_.size(), Task{std::move(task), nullptr, util::steadyNowNs()});
+            }
+
+            bool currentThreadInExecutor() const override
+            {
+                return currentShard() != -1;
+            }
+
+            ExecutorStat stat() const override;
+
+            size_t currentContextId() const override
+            {
+                return currentShard();
+            }
+
+            // Context是shard id + 1，不在shard中时返回NULLCTX
+            Context checkout() override
+            {
+                auto current = currentShard();
+                return current == -1 ? NULLCTX : reinterpret_cast<Context>(static_cast<uintptr_t>(current) + 1);
+            }
+
+            bool checkin(Func func, Context ctx, ScheduleOptions opts) override;
+
+            TimerToken scheduleTimer(Func func, Duration dur, uint64_t) override
+            {
+                return toToken(scheduleAfter(pickShard(), std::move(func), dur));
+            }
+
+            bool cancelTimer(TimerToken token) override
+            {
+                using Node = decltype(util::TimerWheel::TimerHandle::node);
+                return timerWheel_.cancel(util::TimerWheel::TimerHandle{reinterpret_cast<Node>(token.id), token.seq});
+            }
+
+        protected:
+            void schedule(Func func, Duration dur) override
+            {
+                scheduleAfter(pickShard(), std::move(func), dur);
+            }
+
+            void schedule(Func func, Duration dur, uint64_t) override
+            {
+                scheduleAfter(pickShard(), std::move(func), dur);
+            }
+
+        private:
+            struct Task
+            {
+                TaskFunc fn = nullptr;
+                // 非空时直接resume，不经过fn
+                std::coroutine_handle<> handle = nullptr;
+                uint64_t enqueueNs = 0;
+            };
+
+            class ShardView;
+
+            struct alignas(util::kCacheLineSize) Shard
+            {
+                // 非0表示shard线程正在睡眠
+                std::atomic<uint32_t> sleeping{0};
+                // inbound[from]是shard from发往本shard的消息，from为自己时为空
+                std::vector<std::unique_ptr<util::SpscRing<Task>>> inbound;
+                // 外部线程提交的任务
+                util::Queue<Task> inject;
+                // 以下只有shard线程访问
+                util::RingQueue<Task> local;
+                // pending[to]暂存发往shard to但ring已满的消息
+                std::vector<std::unique_ptr<util::RingQueue<Task>>> pending;
+                size_t pendingNum = 0;
+                util::WorkerCounters counters;
+                std::unique_ptr<ShardView> view;
+                int32_t cpu = -1;
+                std::thread thread;
+            };
+
+            // 每轮最多执行的本地任务数，之后重新检查其它shard发来的消息
+            static constexpr size_t kBatchSize = 64;
+            static constexpr uint32_t kSpinCount = 64;
+
+            static std::pair<size_t, ShardedExecutor *> *getCurrent();
+            size_t pickShard();
+            bool submit(size_t id, Task &&task);
+            util::TimerWheel::TimerHandle scheduleAfter(size_t id, Func func, Duration dur);
+            static TimerToken toToken(util::TimerWheel::TimerHandle handle)
+            {
+                return TimerToken{reinterpret_cast<uintptr_t>(handle.node), handle.seq};
+            }
+            void run(size_t id);
+            bool poll(size_t id);
+            bool flushPending(size_t id);
+            bool hasWork(size_t id) const;
+            void idle(size_t id);
+            void wake(size_t id);
+
+            std::vector<std::unique_ptr<Shard>> shards_;
+            std::atomic<bool> stop_{false};
+            std::atomic<size_t> cursor_{0};
+            // 声明在shards_之后，保证先于shards_析构
+            util::TimerWheel timerWheel_;
+        };
+
+        // 绑定到一个shard的Executor，调度的任务都在该shard上执行
+        class ShardedExecutor::ShardView : public Executor
+        {
+        public:
+            ShardView(ShardedExecutor *parent, size_t id) : Executor(parent->name()), parent_(parent), id_(id) {}
+
+            using Executor::checkin;
+            using Executor::schedule;
+            using Executor::scheduleByKey;
+            using Executor::scheduleHandle;
+            using Executor::scheduleTask;
+            using Executor::scheduleTimer;
+
+            bool schedule(Func func) override
+            {
+                return parent_->submit(id_, Task{TaskFunc(std::move(func)), nullptr, util::steadyNowNs()});
+            }
+
+            bool scheduleTask(TaskFunc task, uint64_t) override
+            {
+                return parent_->submitTo(id_, std::move(task));
+            }
+
+            bool scheduleHandle(std::coroutine_handle<> handle, uint64_t) override
+            {
+                if (!handle)
+                    return false;
+                return parent_->submit(id_, Task{nullptr, handle, util::steadyNowNs()});
+            }
+
+            bool scheduleByKey(uint64_t, TaskFunc task, uint64_t schedule_info) override
+            {
+                return scheduleTask(std::move(task), schedule_info);
+            }
+
+            bool currentThreadInExecutor() const override
+            {
+                return parent_->currentShard() == static_cast<int32_t>(id_);
+            }
+
+            ExecutorStat stat() const override
+            {
+                return parent_->stat();
+            }
+
+            size_t currentContextId() const override
+            {
+                return parent_->currentContextId();
+            }
+
+            Context checkout() override
+            {
+                return parent_->checkout();
+            }
+
+            bool checkin(Func func, Context ctx, ScheduleOptions opts) override
+            {
+                return parent_->checkin(std::move(func), ctx, opts);
+            }
+
+            TimerToken scheduleTimer(Func func, Duration dur, uint64_t) override
+            {
+                return toToken(parent_->scheduleAfter(id_, std::move(func), dur));
+            }
+
+            bool cancelTimer(TimerToken token) override
+            {
+                return parent_->cancelTimer(token);
+            }
+
+        protected:
+            void schedule(Func func, Duration dur) override
+            {
+                parent_->scheduleAfter(id_, std::move(func), dur);
+            }
+
+            void schedule(Func func, Duration dur, uint64_t) override
+            {
+                parent_->scheduleAfter(id_, std::move(func), dur);
+            }
+
+        private:
+            ShardedExecutor *parent_;
+            size_t id_;
+        };
+
+        inline ShardedExecutor::ShardedExecutor(size_t shardNum, bool enableCoreBindings, size_t ringCapacity)
+        {
+            if (shardNum == 0)
+                shardNum = 1;
+            std::vector<uint32_t> cpus;
+#ifdef __linux__
+            if (enableCoreBindings)
+                util::getCurrentCpus(cpus);
+#else
+            (void)enableCoreBindings;
+#endif
+            shards_.reserve(shardNum);
+            for (size_t i = 0; i < shardNum; i++)
+            {
+                auto shard = std::make_unique<Shard>();
+                shard->inbound.resize(shardNum);
+                shard->pending.resize(shardNum);
+                for (size_t from = 0; from < shardNum; from++)
+                {
+                    if (from != i)
+                        shard->inbound[from] = std::make_unique<util::SpscRing<Task>>(ringCapacity);
+                }
+                shard->view = std::make_unique<ShardView>(this, i);
+                if (!cpus.empty())
+                    shard->cpu = cpus[i % cpus.size()];
+                shards_.emplace_back(std::move(shard));
+            }
+            for (size_t i = 0; i < shardNum; i++)
+                shards_[i]->thread = std::thread(&ShardedExecutor::run, this, i);
+        }
+
+        inline ShardedExecutor::~ShardedExecutor()
+        {
+            stop_ = true;
+            for (size_t i = 0; i < shards_.size(); i++)
+                wake(i);
+            for (auto &shard : shards_)
+                shard->thread.join();
+        }
+
+        inline Executor *ShardedExecutor::shard(size_t id)
+        {
+            return shards_[id]->view.get();
+        }
+
+        inline coro::detail::DispatchAwaitable ShardedExecutor::switchTo(size_t shard)
+        {
+            return coro::dispatch(shards_[shard]->view.get());
+        }
+
+        inline std::pair<size_t, ShardedExecutor *> *ShardedExecutor::getCurrent()
+        {
+            static thread_local std::pair<size_t, ShardedExecutor *> current(-1, nullptr);
+            return &current;
+        }
+
+        inline int32_t ShardedExecutor::currentShard() const
+        {
+            auto current = getCurrent();
+            return current->second == this ? static_cast<int32_t>(current->first) : -1;
+        }
+
+        inline size_t ShardedExecutor::pickShard()
+        {
+            auto current = currentShard();
+            if (current != -1)
+                return current;
+            return cursor_.fetch_add(1, std::memory_order_relaxed) % shards_.size();
+        }
+
+        inline bool ShardedExecutor::submitTo(size_t shard, TaskFunc task)
+        {
+            if (task == nullptr || shard >= shards_.size())
+                return false;
+            return submit(shard, Task{std::move(task), nullptr, util::steadyNowNs()});
+        }
+
+        template <typename T>
+        inline coro::Lazy<T> ShardedExecutor::submitTo(size_t shard, coro::Lazy<T> lazy)
+        {
+            auto origin = co_await CurrentExecutor{};
+            co_await switchTo(shard);
+            auto result = co_await std::move(lazy).coAwaitTry();
+            if (origin != nullptr)
+                co_await coro::dispatch(origin);
+            co_return std::move(result).value();
+        }
+
+        inline bool ShardedExecutor::submit(size_t id, Task &&task)
+        {
+            if (stop_)
+                return false;
+            auto current = getCurrent();
+            auto &target = *shards_[id];
+            if (current->second == this)
+            {
+                auto from = current->first;
+                if (from == id)
+                {
+                    // 自己的shard，不需要唤醒
+                    target.local.push(std::move(task));
+                    return true;
+                }
+                auto &self = *shards_[from];
+                auto &pending = self.pending[id];
+                // 已有暂存的消息时排在它们后面，保证发往同一个shard的消息有序
+                if ((pending && !pending->empty()) || !target.inbound[from]->try_push(std::move(task)))
+                {
+                    if (!pending)
+                        pending = std::make_unique<util::RingQueue<Task>>();
+                    pending->push(std::move(task));
+                    self.pendingNum++;
+                    // ring满说明目标shard还有消息没处理，不会睡眠
+                    return true;
+                }
+            }
+            else
+            {
+                target.inject.push(std::move(task));
+            }
+            wake(id);
+            return true;
+        }
+
+        inline util::TimerWheel::TimerHandle ShardedExecutor::scheduleAfter(size_t id, Func func, Duration dur)
+        {
+            return timerWheel_.add([this, id, func = std::move(func)]() mutable
+                            { submit(id, Task{TaskFunc(std::move(func)), nullptr, util::steadyNowNs()}); },
+                            dur);
+        }
+
+        inline bool ShardedExecutor::checkin(Func func, Context ctx, ScheduleOptions opts)
+        {
+            auto id = reinterpret_cast<uintptr_t>(ctx);
+            if (ctx == NULLCTX || id > shards_.size())
+                return schedule(std::move(func));
+            id -= 1;
+            if (currentShard() == static_cast<int32_t>(id) && opts.prompt)
+            {
+                func();
+                return true;
+            }
+            return submit(id, Task{TaskFunc(std::move(func)), nullptr, util::steadyNowNs()});
+        }
+
+        inline void ShardedExecutor::run(size_t id)
+        {
+            auto &shard = *shards_[id];
+#ifdef __linux__
+            if (shard.cpu >= 0)
+            {
+                cpu_set_t cpuset;
+                CPU_ZERO(&cpuset);
+                CPU_SET(shard.cpu, &cpuset);
+                int res = sched_setaffinity(0, sizeof(cpu_set_t), &cpuset);
+                if (res != 0)
+                    std::cerr << std::format("Error while calling sched_setaffinity: {}\n", res);
+            }
+#endif
+            auto current = getCurrent();
+            current->first = id;
+            current->second = this;
+            while (true)
+            {
+                auto busy = flushPending(id);
+                busy = poll(id) || busy;
+                if (!shard.local.empty())
+                {
+                    for (size_t i = 0; i < kBatchSize && !shard.local.empty(); i++)
+                    {
+                        auto task = std::move(shard.local.front());
+                        shard.local.pop();
+                        auto start = util::steadyNowNs();
+                        if (task.handle)
+                            task.handle.resume();
+                        else
+                            task.fn();
+                        shard.counters.onExecuted(task.enqueueNs, start, util::steadyNowNs());
+                    }
+                    continue;
+                }
+                if (busy)
+                    continue;
+                // 停止后不再重试发往其它shard的消息，它们可能已经退出
+                if (stop_ && !hasWork(id))
+                    break;
+                idle(id);
+            }
+        }
+
+        // 把其它shard和外部线程发来的任务移到本地队列
+        inline bool ShardedExecutor::poll(size_t id)
+        {
+            auto &shard = *shards_[id];
+            bool found = false;
+            Task task;
+            for (auto &ring : shard.inbound)
+            {
+                if (!ring)
+                    continue;
+                while (ring->try_pop(task))
+                {
+                    shard.local.push(std::move(task));
+                    found = true;
+                }
+            }
+            if (shard.inject.approx_size() != 0)
+            {
+                while (shard.inject.try_pop(task))
+                {
+                    shard.local.push(std::move(task));
+                    found = true;
+                }
+            }
+            return found;
+        }
+
+        inline bool ShardedExecutor::flushPending(size_t id)
+        {
+            auto &shard = *shards_[id];
+            if (shard.pendingNum == 0)
+                return false;
+            bool moved = false;
+            for (size_t to = 0; to < shard.pending.size(); to++)
+            {
+                auto &pending = shard.pending[to];
+                if (!pending || pending->empty())
+                    continue;
+                auto &ring = *shards_[to]->inbound[id];
+                size_t pushed = 0;
+                while (!pending->empty() && ring.try_push(std::move(pending->front())))
+                {
+                    pending->pop();
+                    pushed++;
+                }
+                if (pushed != 0)
+                {
+                    shard.pendingNum -= pushed;
+                    wake(to);
+                    moved = true;
+                }
+            }
+            return moved;
+        }
+
+        // 只由shard自己调用
+        inline bool ShardedExecutor::hasWork(size_t id) const
+        {
+            auto &shard = *shards_[id];
+            if (!shard.local.empty() || shard.inject.approx_size() != 0)
+                return true;
+            for (auto &ring : shard.inbound)
+            {
+                if (ring && !ring->empty())
+                    return true;
+            }
+            return false;
+        }
+
+        inline void ShardedExecutor::idle(size_t id)
+        {
+            auto &shard = *shards_[id];
+            // 还有消息等着发给其它shard，不能睡眠
+            if (shard.pendingNum != 0)
+            {
+                std::this_thread::yield();
+                return;
+            }
+            for (uint32_t i = 0; i < kSpinCount; i++)
+            {
+                util::cpuRelax();
+                if (hasWork(id))
+                    return;
+            }
+            shard.sleeping.store(1, std::memory_order_seq_cst);
+            // 与wake中的fence配对：要么这里看到新消息，要么发送方看到sleeping
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!stop_ && !hasWork(id))
+            {
+                while (shard.sleeping.load(std::memory_order_acquire) != 0)
+                    shard.sleeping.wait(1, std::memory_order_acquire);
+            }
+            shard.sleeping.store(0, std::memory_order_relaxed);
+        }
+
+        inline void ShardedExecutor::wake(size_t id)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto &sleeping = shards_[id]->sleeping;
+            if (sleeping.load(std::memory_order_relaxed) != 0 && sleeping.exchange(0, std::memory_order_acq_rel) != 0)
+                sleeping.notify_one();
+        }
+
+        inline ExecutorStat ShardedExecutor::stat() const
+        {
+            ExecutorStat stat;
+            stat.threadNum = shards_.size();
+            stat.peakThreadNum = shards_.size();
+            for (size_t i = 0; i < shards_.size(); i++)
+            {
+                auto &shard = *shards_[i];
+                auto &worker = stat.workers.emplace_back();
+                worker.id = i;
+                // 本地队列只有shard线程能访问，这里只统计还没有取走的消息
+                worker.pendingTaskCount = shard.inject.approx_size();
+                for (auto &ring : shard.inbound)
+                {
+                    if (ring)
+                        worker.pendingTaskCount += ring->approx_size();
+                }
+                worker.executedTaskCount = shard.counters.executed.load(std::memory_order_relaxed);
+                worker.queueLatency = shard.counters.queueLatency.snapshot();
+                worker.runTime = shard.counters.runTime.snapshot();
+                stat.pendingTaskCount += worker.pendingTaskCount;
+                stat.executedTaskCount += worker.executedTaskCount;
+            }
+            return stat;
+        }
+    } // namespace executors
+} // namespace async_framework
@@ -4,12 +4,15 @@
 #include "../Executor.h"
 #include "SimpleIOExecutor.h"
 #include "../util/ThreadPool.h"
+#include "../util/TimerWheel.h"
 
 namespace async_framework
 {
     namespace executors
     {
         inline constexpr int64_t kContextMask = 0x40000000;
+        // schedule_info的低4位是优先级
+        inline constexpr uint64_t kPriorityMask = 0xF;
 
         // This is a simple executor. The intention of SimpleExecutor is to make the
         // test available and show how user should implement their executors. People who
@@ -26,10 +29,16 @@ namespace async_framework
         {
         public:
             using Func = Executor::Func;
+            using TaskFunc = Executor::TaskFunc;
             using Context = Executor::Context;
 
         public:
-            explicit SimpleExecutor(size_t threadNum) : pool_(threadNum)
+            // 默认使用无锁的work-stealing队列，协程恢复这类短任务不会在队列锁上竞争
+            // enableCoreBindings为true时按NUMA拓扑绑核，schedule_info中的node hint才会生效
+            // elasticPolicy.maxCompensate不为0时，worker被阻塞后会启动临时线程补偿，见ThreadPool::ElasticPolicy
+            explicit SimpleExecutor(size_t threadNum, util::ThreadPool::QUEUE_TYPE queueType = util::ThreadPool::QUEUE_TYPE::WORK_STEALING_DEQUE,
+                                    bool enableCoreBindings = false, util::ThreadPool::ElasticPolicy elasticPolicy = util::ThreadPool::ElasticPolicy())
+                : pool_(threadNum, false, enableCoreBindings, queueType, util::ThreadPool::IdlePolicy(), elasticPolicy)
             {
                 ioExecutor_.init();
             }
@@ -40,42 +49,105 @@ namespace async_framework
             }
 
         public:
+            using Executor::schedule;
+            using Executor::scheduleBatch;
+            using Executor::scheduleByKey;
+            using Executor::scheduleHandleBatch;
+            using Executor::scheduleHandle;
+            using Executor::scheduleTimer;
+            using Executor::scheduleTask;
+
             bool schedule(Func func) override
             {
                 return pool_.scheduleById(std::move(func)) == util::ThreadPool::ERROR_TYPE::ERROR_NONE;
             }
 
+            bool schedule(Func func, uint64_t schedule_info) override
+            {
+                auto priority = static_cast<uint32_t>(schedule_info & kPriorityMask);
+                return pool_.scheduleById(std::move(func), -1, priority, nodeOfHint(schedule_info)) == util::ThreadPool::ERROR_TYPE::ERROR_NONE;
+            }
+
+            // TaskFunc直接放入线程池的WorkItem，不再包装成Func
+            bool scheduleTask(TaskFunc task, uint64_t schedule_info) override
+            {
+                auto priority = static_cast<uint32_t>(schedule_info & kPriorityMask);
+                return pool_.scheduleById(std::move(task), -1, priority, nodeOfHint(schedule_info)) == util::ThreadPool::ERROR_TYPE::ERROR_NONE;
+            }
+
+            bool scheduleHandle(std::coroutine_handle<> handle, uint64_t schedule_info) override
+            {
+                auto priority = static_cast<uint32_t>(schedule_info & kPriorityMask);
+                return pool_.scheduleHandleById(handle, -1, priority, nodeOfHint(schedule_info)) == util::ThreadPool::ERROR_TYPE::ERROR_NONE;
+            }
+
+            // key相同的任务总是由同一个worker按顺序执行，不会被偷取，
+            // 相当于把checkin按context id路由推广到任意key
+            bool scheduleByKey(uint64_t key, TaskFunc task, uint64_t schedule_info) override
+            {
+                auto priority = static_cast<uint32_t>(schedule_info & kPriorityMask);
+                return pool_.scheduleByKey(key, std::move(task), priority) == util::ThreadPool::ERROR_TYPE::ERROR_NONE;
+            }
+
+            // 线程池一次提交整批任务，要么全部提交成功，要么都没有提交
+            size_t scheduleBatch(std::span<Func> funcs, uint64_t schedule_info) override
+            {
+                auto priority = static_cast<uint32_t>(schedule_info & kPriorityMask);
+                return pool_.scheduleBatch(funcs, priority, nodeOfHint(schedule_info)) == util::ThreadPool::ERROR_TYPE::ERROR_NONE ? funcs.size() : 0;
+            }
+
+            size_t scheduleHandleBatch(std::span<const std::coroutine_handle<>> handles, uint64_t schedule_info) override
+            {
+                auto priority = static_cast<uint32_t>(schedule_info & kPriorityMask);
+                return pool_.scheduleHandleBatch(handles, priority, nodeOfHint(schedule_info)) == util::ThreadPool::ERROR_TYPE::ERROR_NONE ? handles.size() : 0;
+            }
+
+            // 弹性模式的临时worker也属于这个executor
             bool currentThreadInExecutor() const override
             {
-                return pool_.getCurrentId() != -1;
+                return pool_.getCurrentThreadId() != -1;
             }
 
             ExecutorStat stat() const override
             {
-                return ExecutorStat();
+                ExecutorStat stat;
+                stat.workers = pool_.getWorkerStats();
+                for (auto &worker : stat.workers)
+                {
+                    stat.executedTaskCount += worker.executedTaskCount;
+                    stat.stealCount += worker.stealCount;
+                }
+                stat.pendingTaskCount = pool_.getItemCount();
+                stat.threadNum = pool_.getActiveThreadNum();
+                stat.peakThreadNum = pool_.getPeakThreadNum();
+                stat.compensateCount = pool_.getCompensateCount();
+                return stat;
             }
 
             size_t currentContextId() const override
             {
-                return pool_.getCurrentId();
+                return pool_.getCurrentThreadId();
             }
 
             Context checkout() override
             {
                 // avoid CurrentId equal to NULLCTX
-                return reinterpret_cast<Context>(pool_.getCurrentId() | kContextMask);
+                return reinterpret_cast<Context>(pool_.getCurrentThreadId() | kContextMask);
             }
 
             bool checkin(Func func, Context ctx, ScheduleOptions opts) override
             {
-                int64_t id = reinterpret_cast<int64_t>(ctx);
-                auto prompt = pool_.getCurrentId() == (id & (~kContextMask)) && opts.prompt;
+                int64_t id = reinterpret_cast<int64_t>(ctx) & (~kContextMask);
+                auto prompt = pool_.getCurrentThreadId() == id && opts.prompt;
                 if (prompt)
                 {
                     func();
                     return true;
                 }
-                return pool_.scheduleById(std::move(func), id & (~kContextMask)) == util::ThreadPool::ERROR_TYPE::ERROR_NONE;
+                // 临时worker和外部线程没有自己的队列，交给任意worker
+                if (id < 0 || id >= pool_.getThreadNum())
+                    id = -1;
+                return pool_.scheduleById(std::move(func), static_cast<int32_t>(id)) == util::ThreadPool::ERROR_TYPE::ERROR_NONE;
             }
 
             IOExecutor *getIOExecutor() override
@@ -83,9 +155,38 @@ namespace async_framework
                 return &ioExecutor_;
             }
 
+            TimerToken scheduleTimer(Func func, Duration dur, uint64_t schedule_info) override
+            {
+                auto handle = timerWheel_.add([this, func = std::move(func), schedule_info]() mutable
+                                              { schedule(std::move(func), schedule_info); }, dur);
+                return TimerToken{reinterpret_cast<uintptr_t>(handle.node), handle.seq};
+            }
+
+            bool cancelTimer(TimerToken token) override
+            {
+                using Node = decltype(util::TimerWheel::TimerHandle::node);
+                return timerWheel_.cancel(util::TimerWheel::TimerHandle{reinterpret_cast<Node>(token.id), token.seq});
+            }
+
+        protected:
+            // 定时任务由时间轮统一管理，到期后再提交到线程池，不再为每次sleep创建线程
+            void schedule(Func func, Duration dur) override
+            {
+                timerWheel_.add([this, func = std::move(func)]() mutable
+                                { schedule(std::move(func)); }, dur);
+            }
+
+            void schedule(Func func, Duration dur, uint64_t schedule_info) override
+            {
+                timerWheel_.add([this, func = std::move(func), schedule_info]() mutable
+                                { schedule(std::move(func), schedule_info); }, dur);
+            }
+
         private:
             util::ThreadPool pool_;
             SimpleIOExecutor ioExecutor_;
+            // 声明在pool_之后，保证先于pool_析构，到期回调不会访问已析构的线程池
+            util::TimerWheel timerWheel_;
         };
     } // namespace executors
 } // namespace async_framework
\ No newline at end of file
@@ -1,8 +1,16 @@
 #pragma once
 
 #include "../IOExecutor.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <mutex>
 #include <thread>
+#include <vector>
 #include <libaio.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 namespace async_framework
 {
@@ -10,39 +18,105 @@ namespace async_framework
     {
         // This is a demo IOExecutor.
         // submitIO and submitIOV should be implemented
+        //
+        // Requests are queued and then submitted in batches: whichever thread
+        // gets the submit lock issues one io_submit for every request queued
+        // so far, including the ones from threads that could not get the
+        // lock. At most maxAio requests are in flight, one per iocb slot.
+        // Requests beyond that stay queued and are submitted by the loop
+        // thread as completions free their slots, so none fails with EAGAIN.
+        //
+        // In EVENTFD mode there is no loop thread. Every iocb is bound to an
+        // eventfd that becomes readable when requests complete. Whoever
+        // watches eventFd() (an epoll loop such as coro_epoll's IoContext, or
+        // an executor worker) calls reap(), which runs the callbacks on the
+        // calling thread. When that thread belongs to the coroutine's
+        // executor, the coroutine resumes without another hop, and an idle
+        // executor burns no cpu on polling.
         class SimpleIOExecutor : public IOExecutor
         {
         public:
-            static constexpr int KMaxAio = 8;
+            // 默认的ring深度
+            static constexpr int KMaxAio = 128;
+
+            // LOOP_THREAD: 专门的线程每300us调用一次io_getevents并执行回调。
+            // EVENTFD: 完成事件通过eventFd()通知，由调用reap()的线程执行回调。
+            enum class COMPLETION_MODE
+            {
+                LOOP_THREAD = 0,
+                EVENTFD,
+            };
 
         public:
-            SimpleIOExecutor() {}
+            explicit SimpleIOExecutor(size_t maxAio = KMaxAio, COMPLETION_MODE mode = COMPLETION_MODE::LOOP_THREAD)
+                : maxAio_(maxAio == 0 ? 1 : maxAio), mode_(mode) {}
             virtual ~SimpleIOExecutor() {}
             SimpleIOExecutor(const IOExecutor &) = delete;
             SimpleIOExecutor &operator=(const IOExecutor &) = delete;
 
         public:
-            class Task
+            // 请求完成时执行的回调，或者调用者自己的完成记录
+            struct Completion
             {
-            public:
-                Task(AIOCallback &func) : func_(func) {}
-                ~Task() {}
+                AIOCallback func;
+                IOCompletion *record = nullptr;
 
-            public:
-                void process(io_event_t &event) { func_(event); }
+                void operator()(io_event_t &event)
+                {
+                    if (record != nullptr)
+                        record->complete(record, event);
+                    else
+                        func(event);
+                }
+            };
 
-            private:
-                AIOCallback func_;
+            // 每个iocb槽位一个，回调保存在槽位中，不需要为每个请求分配Task。
+            // 带完成记录的请求把记录的地址作为iocb的data，完成时直接交给记录
+            struct Slot
+            {
+                iocb io;
+                Completion completion;
+            };
+
+            // 等待分配槽位的请求
+            struct Request
+            {
+                int fd;
+                iocb_cmd cmd;
+                void *buffer;
+                size_t length;
+                off_t offset;
+                Completion completion;
             };
 
         public:
             bool init()
             {
-                auto r = io_setup(KMaxAio, &ioContext_);
+                auto r = io_setup(static_cast<int>(maxAio_), &ioContext_);
                 if (r < 0)
                 {
                     return false;
                 }
+                slots_.resize(maxAio_);
+                freeSlots_.reserve(maxAio_);
+                iocbs_.reserve(maxAio_);
+                ready_.reserve(maxAio_);
+                events_.resize(maxAio_);
+                done_.reserve(maxAio_);
+                for (size_t i = maxAio_; i > 0; i--)
+                {
+                    freeSlots_.push_back(static_cast<uint32_t>(i - 1));
+                }
+                if (mode_ == COMPLETION_MODE::EVENTFD)
+                {
+                    eventFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+                    if (eventFd_ < 0)
+                    {
+                        io_destroy(ioContext_);
+                        return false;
+                    }
+                    return true;
+                }
                 loopThread_ = std::thread([this]() mutable
                                           { this->loop(); });
                 return true;
@@ -56,85 +130,282 @@ namespace async_framework
                     loopThread_.join();
                 }
                 io_destroy(ioContext_);
+                if (eventFd_ >= 0)
+                {
+                    close(eventFd_);
+                    eventFd_ = -1;
+                }
             }
 
             void loop()
             {
                 while (!shutdown_)
                 {
-                    io_event events[KMaxAio];
                     struct timespec timeout = {0, 1000 * 300};
-                    auto n = io_getevents(ioContext_, 1, KMaxAio, events, &timeout);
-                    if (n < 0)
+                    auto n = io_getevents(ioContext_, 1, static_cast<long>(maxAio_), events_.data(), &timeout);
+                    if (n <= 0)
                     {
+                        // 内核曾经拒绝过请求(EAGAIN)时，超时后重试
+                        if (n == 0 && hasSubmittable())
+                        {
+                            submitPending();
+                        }
                         continue;
                     }
-                    for (auto i = 0; i < n; i++)
+                    complete(n);
+                }
+            }
+
+            // EVENTFD模式下完成事件的通知fd，其它模式返回-1
+            int eventFd() const
+            {
+                return eventFd_;
+            }
+
+            // EVENTFD模式下，在eventFd()可读时调用。不阻塞地收割完成的请求并在当前线程执行回调，
+            // 返回处理的请求数。任意线程都可以调用，已有线程在收割时直接返回0
+            size_t reap()
+            {
+                if (reaping_.exchange(true, std::memory_order_acquire))
+                {
+                    return 0;
+                }
+                uint64_t count;
+                // 先清空计数，之后完成的请求会让eventfd重新可读
+                while (read(eventFd_, &count, sizeof(count)) < 0 && errno == EINTR)
+                {
+                }
+                size_t total = 0;
+                while (true)
+                {
+                    struct timespec timeout = {0, 0};
+                    auto n = io_getevents(ioContext_, 0, static_cast<long>(maxAio_), events_.data(), &timeout);
+                    if (n <= 0)
+                    {
+                        break;
+                    }
+                    total += n;
+                    complete(n);
+                    if (static_cast<size_t>(n) < maxAio_)
                     {
-                        auto task = reinterpret_cast<Task *>(events[i].data);
-                        io_event_t evt{events[i].data, events[i].obj, events[i].res, events[i].res2};
-                        task->process(evt);
-                        delete task;
+                        break;
                     }
                 }
+                reaping_.store(false, std::memory_order_release);
+                if (total == 0 && hasSubmittable())
+                {
+                    submitPending();
+                }
+                return total;
             }
 
         public:
-            void submitIO([[maybe_unused]] int fd, [[maybe_unused]] iocb_cmd cmd, [[maybe_unused]] void *buffer, [[maybe_unused]] size_t length,
-                          [[maybe_unused]] off_t offset, [[maybe_unused]] AIOCallback cbfn) override
+            void submitIO(int fd, iocb_cmd cmd, void *buffer, size_t length, off_t offset, AIOCallback cbfn) override
+            {
+                enqueue(Request{fd, cmd, buffer, length, offset, Completion{std::move(cbfn)}});
+            }
+
+            void submitIO(int fd, iocb_cmd cmd, void *buffer, size_t length, off_t offset, IOCompletion *completion) override
+            {
+                enqueue(Request{fd, cmd, buffer, length, offset, Completion{nullptr, completion}});
+            }
+
+            // iov和count放在iocb的buf和nbytes中，与io_prep_preadv的布局一致
+            void submitIOV(int fd, iocb_cmd cmd, const iovec_t *iov, size_t count, off_t offset, AIOCallback cbfn) override
+            {
+                enqueue(Request{fd, cmd, const_cast<iovec_t *>(iov), count, offset, Completion{std::move(cbfn)}});
+            }
+
+            void submitIOV(int fd, iocb_cmd cmd, const iovec_t *iov, size_t count, off_t offset, IOCompletion *completion) override
+            {
+                enqueue(Request{fd, cmd, const_cast<iovec_t *>(iov), count, offset, Completion{nullptr, completion}});
+            }
+
+            // 还没有提交给内核的请求数，不包括已经提交的请求
+            size_t pendingCount()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return pending_.size() + ready_.size();
+            }
+
+        private:
+            // 执行events_中前n个完成事件的回调，只有loop线程或者持有reaping_的线程调用
+            void complete(int n)
             {
-                iocb io;
-                memset(&io, 0, sizeof(iocb));
-                io.aio_fildes = fd;
-                io.aio_lio_opcode = cmd;
-                io.u.c.buf = buffer;
-                io.u.c.offset = offset;
-                io.u.c.nbytes = length;
-                io.data = new Task(cbfn);
-
-                struct iocb *iocbs[] = {&io};
-                auto r = io_submit(ioContext_, 1, iocbs);
-                if (r < 0)
                 {
-                    auto task = reinterpret_cast<Task *>(iocbs[0]->data);
-                    io_event_t event;
-                    event.res = r;
-                    task->process(event);
-                    delete task;
-                    return;
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    for (auto i = 0; i < n; i++)
+                    {
+                        auto slot = slotOf(events_[i].obj);
+                        done_.emplace_back(std::move(slot->completion),
+                                           io_event_t{events_[i].data, events_[i].obj, events_[i].res, events_[i].res2});
+                        freeSlots_.push_back(static_cast<uint32_t>(slot - slots_.data()));
+                    }
+                }
+                for (auto &[completion, event] : done_)
+                {
+                    completion(event);
                 }
+                done_.clear();
+                // 槽位空出来了，提交排队的请求
+                submitPending();
             }
 
-            void submitIOV([[maybe_unused]] int fd, [[maybe_unused]] iocb_cmd cmd, [[maybe_unused]] const iovec_t *iov,
-                           [[maybe_unused]] size_t count, [[maybe_unused]] off_t offset, [[maybe_unused]] AIOCallback cbfn) override
+            void enqueue(Request &&request)
             {
-                iocb io;
-                memset(&io, 0, sizeof(iocb));
-                io.aio_fildes = fd;
-                io.aio_lio_opcode = cmd;
-                io.u.c.buf = (void *)iov;
-                io.u.c.offset = offset;
-                io.u.c.nbytes = count;
-                io.data = new Task(cbfn);
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    // 有空闲槽位时直接填好iocb，不经过pending_
+                    if (pending_.empty() && !freeSlots_.empty())
+                    {
+                        ready_.push_back(&prepare(request));
+                    }
+                    else
+                    {
+                        pending_.push_back(std::move(request));
+                    }
+                }
+                submitPending();
+            }
 
-                struct iocb *iocbs[] = {&io};
+            // 取一个空闲槽位并填好iocb，需要持有mutex_
+            iocb &prepare(Request &request)
+            {
+                auto &slot = slots_[freeSlots_.back()];
+                freeSlots_.pop_back();
+                memset(&slot.io, 0, sizeof(iocb));
+                slot.io.aio_fildes = request.fd;
+                slot.io.aio_lio_opcode = request.cmd;
+                slot.io.u.c.buf = request.buffer;
+                slot.io.u.c.offset = request.offset;
+                slot.io.u.c.nbytes = request.length;
+                slot.io.data = request.completion.record != nullptr ? static_cast<void *>(request.completion.record) : &slot;
+                if (eventFd_ >= 0)
+                {
+                    io_set_eventfd(&slot.io, eventFd_);
+                }
+                slot.completion = std::move(request.completion);
+                return slot.io;
+            }
 
-                auto r = io_submit(ioContext_, 1, iocbs);
-                if (r < 0)
+            // 把排队的请求放入空闲槽位，一次io_submit提交。其它线程正在提交时直接返回，
+            // 它解锁后会重新检查队列，因此不会有请求被遗漏
+            void submitPending()
+            {
+                std::vector<std::pair<Completion, int>> failed;
+                bool refused = false;
+                do
                 {
-                    auto task = reinterpret_cast<Task *>(iocbs[0]->data);
-                    io_event_t event;
-                    event.res = r;
-                    task->process(event);
-                    delete task;
-                    return;
+                    if (!submitMutex_.try_lock())
+                    {
+                        return;
+                    }
+                    auto &iocbs = iocbs_;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        iocbs.swap(ready_);
+                        while (!pending_.empty() && !freeSlots_.empty())
+                        {
+                            iocbs.push_back(&prepare(pending_.front()));
+                            pending_.pop_front();
+                        }
+                    }
+                    size_t submitted = 0;
+                    while (submitted < iocbs.size())
+                    {
+                        auto r = io_submit(ioContext_, static_cast<long>(iocbs.size() - submitted), iocbs.data() + submitted);
+                        if (r > 0)
+                        {
+                            submitted += r;
+                            continue;
+                        }
+                        if (r == -EAGAIN || r == 0)
+                        {
+                            refused = true;
+                            break;
+                        }
+                        // io_submit在第一个非法的iocb处停止，这个请求直接以错误结束
+                        auto slot = slotOf(iocbs[submitted]);
+                        failed.emplace_back(std::move(slot->completion), r);
+                        releaseSlot(slot);
+                        submitted++;
+                    }
+                    if (submitted < iocbs.size())
+                    {
+                        // 内核暂时不接收，保留槽位放回ready_队首等待下一次提交
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        ready_.insert(ready_.begin(), iocbs.begin() + submitted, iocbs.end());
+                    }
+                    iocbs.clear();
+                    submitMutex_.unlock();
+                    for (auto &[completion, r] : failed)
+                    {
+                        io_event_t event{completion.record, nullptr, static_cast<uint64_t>(static_cast<int64_t>(r)), 0};
+                        completion(event);
+                    }
+                    failed.clear();
+                } while (!refused && hasSubmittable());
+                if (refused && mode_ == COMPLETION_MODE::EVENTFD && inFlight() == 0)
+                {
+                    // 没有在途的请求，不会再有完成事件触发reap()，主动让eventfd可读，
+                    // 由监听它的线程调用reap()重新提交。在submitMutex_解锁后检查，
+                    // 之后完成的请求会自己调用submitPending()
+                    uint64_t one = 1;
+                    while (write(eventFd_, &one, sizeof(one)) < 0 && errno == EINTR)
+                    {
+                    }
                 }
             }
 
+            // 由iocb的地址找到所在的槽位，iocb的data可能是调用者的完成记录
+            Slot *slotOf(void *io)
+            {
+                auto offset = static_cast<char *>(io) - reinterpret_cast<char *>(&slots_[0].io);
+                return &slots_[offset / sizeof(Slot)];
+            }
+
+            bool hasSubmittable()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return !ready_.empty() || (!pending_.empty() && !freeSlots_.empty());
+            }
+
+            // 已经提交给内核或者正在由持有submitMutex_的线程提交的请求数
+            size_t inFlight()
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return maxAio_ - freeSlots_.size() - ready_.size();
+            }
+
+            void releaseSlot(Slot *slot)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                freeSlots_.push_back(static_cast<uint32_t>(slot - slots_.data()));
+            }
+
         private:
-            volatile bool shutdown_ = false;
+            std::atomic<bool> shutdown_{false};
             io_context_t ioContext_ = 0;
             std::thread loopThread_;
+            size_t maxAio_;
+            COMPLETION_MODE mode_;
+            int eventFd_ = -1;
+            std::atomic<bool> reaping_{false};
+            // 由loop线程或者持有reaping_的线程使用
+            std::vector<io_event> events_;
+            std::vector<std::pair<Completion, io_event_t>> done_;
+            // 大小固定为maxAio_，init之后不再改变
+            std::vector<Slot> slots_;
+            // 保护pending_、freeSlots_和ready_
+            std::mutex mutex_;
+            // 等待空闲槽位的请求
+            std::deque<Request> pending_;
+            std::vector<uint32_t> freeSlots_;
+            // 已经占用槽位、填好iocb但还没有提交的请求，容量固定为maxAio_
+            std::vector<iocb *> ready_;
+            // 同一时间只有一个线程调用io_submit，iocbs_由持有submitMutex_的线程使用
+            std::mutex submitMutex_;
+            std::vector<iocb *> iocbs_;
         };
     } // namespace executors
-} // namespace async_framework
\ No newline at end of file
+} // namespace async_framework
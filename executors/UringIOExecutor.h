@@ -0,0 +1,562 @@
+#pragma once
+
+#include "../IOExecutor.h"
+#include "../util/BufferPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace async_framework
+{
+    namespace executors
+    {
+        // UringIOExecutor is an IOExecutor built on io_uring, talking to the
+        // kernel through the raw syscalls so no liburing is needed. Unlike the
+        // libaio based SimpleIOExecutor, the queue depth is the ring size and a
+        // request costs no syscall of its own:
+        //
+        // - submitIO/submitIOV fill an SQE under a short lock. Requests issued
+        //   while another thread is entering the kernel are submitted by the
+        //   same io_uring_enter, and a BatchScope defers the enter until the
+        //   scope ends, so a burst of requests is one syscall.
+        // - At most cq_entries requests are in the ring at once, so the CQ
+        //   never overflows. Requests beyond that, or beyond a full SQ, are
+        //   queued and moved into the SQ as completions are reaped; a submit
+        //   never waits for the ring.
+        // - With sqpoll the kernel polls the SQ and a submit only wakes the
+        //   poller when it went idle.
+        // - Completions are reaped by the loop thread, which blocks in
+        //   io_uring_enter instead of polling with a timeout. init(false)
+        //   skips the loop thread; the caller then has to call poll() from a
+        //   loop of its own. None of the executors in this tree does that.
+        //
+        // - With a BufferPool attached (setBufferPool), the pool's slabs are
+        //   registered with the ring. Reads and writes whose buffer lies in
+        //   one slab use READ_FIXED/WRITE_FIXED, so the kernel does not pin
+        //   and map the pages of every request.
+        //
+        // The ring needs Linux 5.6 (IORING_OP_READ/WRITE). Completed requests
+        // report the result in io_event_t::res the same way as libaio: the
+        // byte count, or a negative errno.
+        class UringIOExecutor : public IOExecutor
+        {
+        public:
+            // entries是SQ的大小，CQ的大小是它的两倍，也是ring中在途请求数的上限，
+            // 超出的请求排队。sqpoll时内核线程空闲sqIdleMs毫秒后睡眠
+            explicit UringIOExecutor(uint32_t entries = 256, bool sqpoll = false, uint32_t sqIdleMs = 1000)
+                : entries_(entries), sqpoll_(sqpoll), sqIdleMs_(sqIdleMs) {}
+            virtual ~UringIOExecutor() {}
+            UringIOExecutor(const IOExecutor &) = delete;
+            UringIOExecutor &operator=(const IOExecutor &) = delete;
+
+        public:
+            class Task
+            {
+            public:
+                Task(AIOCallback &func) : func_(func) {}
+                ~Task() {}
+
+            public:
+                void process(io_event_t &event) { func_(event); }
+
+            private:
+                AIOCallback func_;
+            };
+
+            // 作用域内当前线程的提交只写入SQ，析构时一次io_uring_enter提交
+            class BatchScope
+            {
+            public:
+                explicit BatchScope(UringIOExecutor &executor) : executor_(executor), prev_(batching())
+                {
+                    batching() = &executor;
+                }
+                ~BatchScope()
+                {
+                    batching() = prev_;
+                    // 嵌套在同一个executor的BatchScope中时由外层提交
+                    if (prev_ != &executor_)
+                        executor_.flush();
+                }
+                BatchScope(const BatchScope &) = delete;
+                BatchScope &operator=(const BatchScope &) = delete;
+
+            private:
+                UringIOExecutor &executor_;
+                UringIOExecutor *prev_;
+            };
+
+        public:
+            // withLoop为false时不启动完成线程，由调用者在自己的循环中调用poll()
+            bool init(bool withLoop = true)
+            {
+                io_uring_params params;
+                memset(&params, 0, sizeof(params));
+                if (sqpoll_)
+                {
+                    params.flags |= IORING_SETUP_SQPOLL;
+                    params.sq_thread_idle = sqIdleMs_;
+                }
+                ringFd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries_, &params));
+                if (ringFd_ < 0)
+                {
+                    return false;
+                }
+                if (!mapRings(params))
+                {
+                    unmapRings();
+                    close(ringFd_);
+                    ringFd_ = -1;
+                    return false;
+                }
+                if (bufferPool_ != nullptr)
+                {
+                    registerBuffers();
+                }
+                if (withLoop)
+                {
+                    loopThread_ = std::thread([this]() mutable
+                                              { this->loop(); });
+                }
+                return true;
+            }
+
+            void destroy()
+            {
+                if (ringFd_ < 0)
+                {
+                    return;
+                }
+                shutdown_ = true;
+                if (loopThread_.joinable())
+                {
+                    // 用一个NOP把阻塞在io_uring_enter中的loop唤醒
+                    io_uring_sqe sqe;
+                    memset(&sqe, 0, sizeof(sqe));
+                    sqe.opcode = IORING_OP_NOP;
+                    enqueue(sqe);
+                    flush();
+                    loopThread_.join();
+                }
+                unmapRings();
+                close(ringFd_);
+                ringFd_ = -1;
+                fixedBuffers_ = false;
+            }
+
+            void loop()
+            {
+                while (!shutdown_ || inflight_.load(std::memory_order_acquire) > 0)
+                {
+                    auto toSubmit = sqpoll_ ? 0 : unsubmitted_.exchange(0, std::memory_order_acq_rel);
+                    auto r = enter(toSubmit, 1, IORING_ENTER_GETEVENTS);
+                    if (r < 0 && toSubmit > 0)
+                    {
+                        // EAGAIN(内核暂时分配不到内存): 先收割完成事件，下一轮重新提交
+                        unsubmitted_.fetch_add(toSubmit, std::memory_order_relaxed);
+                    }
+                    reap();
+                }
+            }
+
+            // 不阻塞地处理已经完成的请求，返回处理的个数。只在init(false)时使用，
+            // 同一时间只能有一个线程调用
+            size_t poll()
+            {
+                flush();
+                return reap();
+            }
+
+            // 提交SQ中还没有提交给内核的请求
+            void flush()
+            {
+                if (sqpoll_)
+                {
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    if (std::atomic_ref<uint32_t>(*sqFlags_).load(std::memory_order_relaxed) & IORING_SQ_NEED_WAKEUP)
+                    {
+                        enter(0, 0, IORING_ENTER_SQ_WAKEUP);
+                    }
+                    return;
+                }
+                while (true)
+                {
+                    // SQ满时排队的请求在SQ被内核取走后才能移入
+                    if (pendingCount_.load(std::memory_order_relaxed) > 0)
+                    {
+                        std::lock_guard<std::mutex> lock(sqMutex_);
+                        fillSq();
+                    }
+                    auto toSubmit = unsubmitted_.exchange(0, std::memory_order_acq_rel);
+                    if (toSubmit == 0)
+                    {
+                        return;
+                    }
+                    auto r = enter(toSubmit, 0, 0);
+                    if (r < static_cast<int>(toSubmit))
+                    {
+                        // 内核暂时不接收，剩下的由loop或者下一次flush提交
+                        unsubmitted_.fetch_add(toSubmit - (r < 0 ? 0 : r), std::memory_order_relaxed);
+                        return;
+                    }
+                }
+            }
+
+        public:
+            void submitIO(int fd, iocb_cmd cmd, void *buffer, size_t length, off_t offset, AIOCallback cbfn) override
+            {
+                submit(fd, cmd, reinterpret_cast<uint64_t>(buffer), static_cast<uint32_t>(length), offset, cbfn);
+            }
+
+            void submitIOV(int fd, iocb_cmd cmd, const iovec_t *iov, size_t count, off_t offset, AIOCallback cbfn) override
+            {
+                static_assert(sizeof(iovec_t) == sizeof(struct iovec), "iovec_t should be compatible with struct iovec");
+                submit(fd, cmd, reinterpret_cast<uint64_t>(iov), static_cast<uint32_t>(count), offset, cbfn);
+            }
+
+            void submitIO(int fd, iocb_cmd cmd, void *buffer, size_t length, off_t offset, IOCompletion *completion) override
+            {
+                AIOCallback none;
+                submit(fd, cmd, reinterpret_cast<uint64_t>(buffer), static_cast<uint32_t>(length), offset, none, completion);
+            }
+
+            void submitIOV(int fd, iocb_cmd cmd, const iovec_t *iov, size_t count, off_t offset, IOCompletion *completion) override
+            {
+                AIOCallback none;
+                submit(fd, cmd, reinterpret_cast<uint64_t>(iov), static_cast<uint32_t>(count), offset, none, completion);
+            }
+
+            // 在提交请求之前调用。注册失败(例如超过RLIMIT_MEMLOCK)时返回false，
+            // 池中的buffer仍然可以按普通内存提交
+            bool setBufferPool(util::BufferPool *pool) override
+            {
+                bufferPool_ = pool;
+                if (ringFd_ < 0)
+                {
+                    return true;
+                }
+                return registerBuffers();
+            }
+
+        private:
+            // 当前线程正处于哪个executor的BatchScope中
+            static UringIOExecutor *&batching()
+            {
+                static thread_local UringIOExecutor *executor = nullptr;
+                return executor;
+            }
+
+            // 完成记录至少按指针对齐，user_data的最低位标记它不是Task
+            static constexpr uint64_t kCompletionTag = 1;
+
+            // completion非空时不分配Task，完成后直接调用completion
+            void submit(int fd, iocb_cmd cmd, uint64_t addr, uint32_t len, off_t offset, AIOCallback &cbfn,
+                        IOCompletion *completion = nullptr)
+            {
+                uint8_t opcode;
+                uint32_t fsyncFlags = 0;
+                switch (cmd)
+                {
+                case IOCB_CMD_PREAD:
+                    opcode = IORING_OP_READ;
+                    break;
+                case IOCB_CMD_PWRITE:
+                    opcode = IORING_OP_WRITE;
+                    break;
+                case IOCB_CMD_PREADV:
+                    opcode = IORING_OP_READV;
+                    break;
+                case IOCB_CMD_PWRITEV:
+                    opcode = IORING_OP_WRITEV;
+                    break;
+                case IOCB_CMD_FDSYNC:
+                    fsyncFlags = IORING_FSYNC_DATASYNC;
+                    [[fallthrough]];
+                case IOCB_CMD_FSYNC:
+                    opcode = IORING_OP_FSYNC;
+                    break;
+                case IOCB_CMD_NOOP:
+                    opcode = IORING_OP_NOP;
+                    break;
+                default:
+                {
+                    io_event_t event{completion, nullptr, static_cast<uint64_t>(-EINVAL), 0};
+                    if (completion != nullptr)
+                        completion->complete(completion, event);
+                    else
+                        cbfn(event);
+                    return;
+                }
+                }
+                // buffer在已注册的slab中时使用固定buffer
+                long bufIndex = -1;
+                if (fixedBuffers_ && (opcode == IORING_OP_READ || opcode == IORING_OP_WRITE))
+                {
+                    bufIndex = bufferPool_->slabIndex(reinterpret_cast<void *>(addr), len);
+                    if (bufIndex >= 0)
+                    {
+                        opcode = opcode == IORING_OP_READ ? IORING_OP_READ_FIXED : IORING_OP_WRITE_FIXED;
+                    }
+                }
+                io_uring_sqe sqe;
+                memset(&sqe, 0, sizeof(sqe));
+                sqe.opcode = opcode;
+                sqe.fd = fd;
+                sqe.off = static_cast<uint64_t>(offset);
+                sqe.addr = addr;
+                sqe.len = len;
+                sqe.fsync_flags = fsyncFlags;
+                if (bufIndex >= 0)
+                    sqe.buf_index = static_cast<uint16_t>(bufIndex);
+                sqe.user_data = completion != nullptr ? reinterpret_cast<uint64_t>(completion) | kCompletionTag
+                                                      : reinterpret_cast<uint64_t>(new Task(cbfn));
+                inflight_.fetch_add(1, std::memory_order_relaxed);
+                enqueue(sqe);
+                if (batching() != this)
+                {
+                    flush();
+                }
+            }
+
+            // 请求先排队再移入SQ，ring满时留在队列中由收割完成事件的线程移入，提交方从不等待
+            void enqueue(const io_uring_sqe &sqe)
+            {
+                std::lock_guard<std::mutex> lock(sqMutex_);
+                pending_.push_back(sqe);
+                // 与reap()配对：要么fillSq看到reap让出的位置，要么reap看到排队的请求
+                pendingCount_.store(pending_.size(), std::memory_order_seq_cst);
+                fillSq();
+            }
+
+            // 把排队的请求移入SQ，需要持有sqMutex_。ring中的请求不超过CQ的大小，
+            // CQ就不会溢出，io_uring_enter也不会因为溢出返回EBUSY
+            void fillSq()
+            {
+                auto tail = *sqTail_;
+                auto head = std::atomic_ref<uint32_t>(*sqHead_).load(std::memory_order_acquire);
+                uint32_t filled = 0;
+                while (!pending_.empty() && tail - head < sqEntries_ && ringInflight_.load(std::memory_order_seq_cst) < cqEntries_)
+                {
+                    sqes_[tail & sqMask_] = pending_.front();
+                    pending_.pop_front();
+                    ringInflight_.fetch_add(1, std::memory_order_relaxed);
+                    tail++;
+                    filled++;
+                }
+                pendingCount_.store(pending_.size(), std::memory_order_relaxed);
+                if (filled == 0)
+                {
+                    return;
+                }
+                std::atomic_ref<uint32_t>(*sqTail_).store(tail, std::memory_order_release);
+                if (!sqpoll_)
+                {
+                    unsubmitted_.fetch_add(filled, std::memory_order_relaxed);
+                }
+            }
+
+            size_t reap()
+            {
+                auto head = *cqHead_;
+                auto tail = std::atomic_ref<uint32_t>(*cqTail_).load(std::memory_order_acquire);
+                size_t n = 0;
+                for (; head != tail; head++)
+                {
+                    auto &cqe = cqes_[head & cqMask_];
+                    auto userData = cqe.user_data;
+                    auto res = static_cast<uint64_t>(static_cast<int64_t>(cqe.res));
+                    // 先让出CQ槽位再执行回调，回调中可以继续提交请求
+                    std::atomic_ref<uint32_t>(*cqHead_).store(head + 1, std::memory_order_release);
+                    ringInflight_.fetch_sub(1, std::memory_order_seq_cst);
+                    if (userData == 0)
+                    {
+                        continue;
+                    }
+                    if (userData & kCompletionTag)
+                    {
+                        auto completion = reinterpret_cast<IOCompletion *>(userData & ~kCompletionTag);
+                        io_event_t event{completion, nullptr, res, 0};
+                        completion->complete(completion, event);
+                    }
+                    else
+                    {
+                        auto task = reinterpret_cast<Task *>(userData);
+                        io_event_t event{task, nullptr, res, 0};
+                        task->process(event);
+                        delete task;
+                    }
+                    inflight_.fetch_sub(1, std::memory_order_release);
+                    n++;
+                }
+                // ring中有了空位，把排队的请求移入SQ并提交
+                if (pendingCount_.load(std::memory_order_seq_cst) > 0)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(sqMutex_);
+                        fillSq();
+                    }
+                    flush();
+                }
+                return n;
+            }
+
+            // 每个slab注册为一个固定buffer，序号即slab序号
+            bool registerBuffers()
+            {
+                if (fixedBuffers_)
+                {
+                    syscall(__NR_io_uring_register, ringFd_, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+                    fixedBuffers_ = false;
+                }
+                if (bufferPool_ == nullptr || bufferPool_->slabCount() == 0)
+                {
+                    return bufferPool_ != nullptr;
+                }
+                std::vector<struct iovec> iovs(bufferPool_->slabCount());
+                for (size_t i = 0; i < iovs.size(); i++)
+                {
+                    iovs[i].iov_base = bufferPool_->base() + i * util::BufferPool::kSlabSize;
+                    iovs[i].iov_len = util::BufferPool::kSlabSize;
+                }
+                auto r = syscall(__NR_io_uring_register, ringFd_, IORING_REGISTER_BUFFERS, iovs.data(), static_cast<unsigned>(iovs.size()));
+                fixedBuffers_ = r == 0;
+                return fixedBuffers_;
+            }
+
+            int enter(uint32_t toSubmit, uint32_t minComplete, uint32_t flags)
+            {
+                int r;
+                do
+                {
+                    r = static_cast<int>(syscall(__NR_io_uring_enter, ringFd_, toSubmit, minComplete, flags, nullptr, 0));
+                } while (r < 0 && errno == EINTR);
+                return r;
+            }
+
+            bool mapRings(const io_uring_params &params)
+            {
+                sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+                cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                auto single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+                if (single)
+                {
+                    sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+                }
+                sqRing_ = mmap(nullptr, sqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQ_RING);
+                if (sqRing_ == MAP_FAILED)
+                {
+                    sqRing_ = nullptr;
+                    return false;
+                }
+                if (single)
+                {
+                    cqRing_ = sqRing_;
+                }
+                else
+                {
+                    cqRing_ = mmap(nullptr, cqRingSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_CQ_RING);
+                    if (cqRing_ == MAP_FAILED)
+                    {
+                        cqRing_ = nullptr;
+                        return false;
+                    }
+                }
+                sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+                auto sqes = mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd_, IORING_OFF_SQES);
+                if (sqes == MAP_FAILED)
+                {
+                    return false;
+                }
+                sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+                auto sq = static_cast<char *>(sqRing_);
+                sqHead_ = reinterpret_cast<uint32_t *>(sq + params.sq_off.head);
+                sqTail_ = reinterpret_cast<uint32_t *>(sq + params.sq_off.tail);
+                sqFlags_ = reinterpret_cast<uint32_t *>(sq + params.sq_off.flags);
+                sqMask_ = *reinterpret_cast<uint32_t *>(sq + params.sq_off.ring_mask);
+                sqEntries_ = params.sq_entries;
+                cqEntries_ = params.cq_entries;
+                // SQ的索引数组固定为恒等映射，第i个位置总是使用第i个SQE
+                auto array = reinterpret_cast<uint32_t *>(sq + params.sq_off.array);
+                for (uint32_t i = 0; i < sqEntries_; i++)
+                {
+                    array[i] = i;
+                }
+                auto cq = static_cast<char *>(cqRing_);
+                cqHead_ = reinterpret_cast<uint32_t *>(cq + params.cq_off.head);
+                cqTail_ = reinterpret_cast<uint32_t *>(cq + params.cq_off.tail);
+                cqMask_ = *reinterpret_cast<uint32_t *>(cq + params.cq_off.ring_mask);
+                cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+                return true;
+            }
+
+            void unmapRings()
+            {
+                if (sqes_ != nullptr)
+                {
+                    munmap(sqes_, sqesSize_);
+                    sqes_ = nullptr;
+                }
+                if (cqRing_ != nullptr && cqRing_ != sqRing_)
+                {
+                    munmap(cqRing_, cqRingSize_);
+                }
+                cqRing_ = nullptr;
+                if (sqRing_ != nullptr)
+                {
+                    munmap(sqRing_, sqRingSize_);
+                    sqRing_ = nullptr;
+                }
+            }
+
+        private:
+            uint32_t entries_;
+            bool sqpoll_;
+            uint32_t sqIdleMs_;
+            int ringFd_ = -1;
+            // bufferPool_的slab已经注册为固定buffer
+            bool fixedBuffers_ = false;
+            std::atomic<bool> shutdown_{false};
+            std::thread loopThread_;
+            // 已经写入SQ但还没有通过io_uring_enter提交的请求数
+            std::atomic<uint32_t> unsubmitted_{0};
+            // 已提交但还没有执行回调的请求数，destroy时等待它们完成
+            std::atomic<uint32_t> inflight_{0};
+            // 已经写入SQ但还没有收割完成事件的请求数(包括NOP)，不超过cqEntries_
+            std::atomic<uint32_t> ringInflight_{0};
+            // 保护SQ的tail和pending_，多个线程可以同时提交
+            std::mutex sqMutex_;
+            // SQ没有空位或者ring中的请求达到cqEntries_时排队的请求
+            std::deque<io_uring_sqe> pending_;
+            // pending_.size()，reap时不加锁检查是否有排队的请求
+            std::atomic<size_t> pendingCount_{0};
+
+            void *sqRing_ = nullptr;
+            void *cqRing_ = nullptr;
+            size_t sqRingSize_ = 0;
+            size_t cqRingSize_ = 0;
+            size_t sqesSize_ = 0;
+            io_uring_sqe *sqes_ = nullptr;
+            uint32_t *sqHead_ = nullptr;
+            uint32_t *sqTail_ = nullptr;
+            uint32_t *sqFlags_ = nullptr;
+            uint32_t sqMask_ = 0;
+            uint32_t sqEntries_ = 0;
+            uint32_t cqEntries_ = 0;
+            uint32_t *cqHead_ = nullptr;
+            uint32_t *cqTail_ = nullptr;
+            uint32_t cqMask_ = 0;
+            io_uring_cqe *cqes_ = nullptr;
+        };
+    } // namespace executors
+} // namespace async_framework
@@ -1,6 +1,7 @@
 #pragma once
 #include <type_traits>
 #include "../Future.h"
+#include "../SharedFuture.h"
 #include "../coro/Lazy.h"
 #include "../uthread/internal/thread_impl.h"
 
@@ -41,6 +42,55 @@ namespace async_framework
             return f.value();
         }
 
+        // Wait for a SharedFuture in uthread context without blocking the
+        // current thread. The waiter lives on the uthread's stack. The uthread
+        // is resumed in the executor of the SharedFuture, see
+        // SharedFuture::via(). The reference is into the shared state.
+        template <typename T>
+        decltype(auto) await(const SharedFuture<T> &fut)
+        {
+            logicAssert(fut.valid(), "SharedFuture is broken");
+            if (!fut.hasResult())
+            {
+                auto executor = fut.getExecutor();
+                logicAssert(executor, "SharedFuture has not a Executor");
+                logicAssert(executor->currentThreadInExecutor(), "await invoked not in Executor");
+
+                struct Waiter : async_framework::detail::SharedWaiter
+                {
+                    Executor *ex;
+                    Executor::Context ctx;
+                    uthread::internal::thread_context *uctx;
+                } waiter;
+                waiter.ex = executor;
+                waiter.ctx = executor->checkout();
+                waiter.uctx = uthread::internal::thread_impl::get();
+                waiter.notify = [](async_framework::detail::SharedWaiter *w)
+                {
+                    // checkin之后uthread可能已经返回，waiter随之失效
+                    auto self = static_cast<Waiter *>(w);
+                    auto uctx = self->uctx;
+                    ScheduleOptions opts;
+                    opts.prompt = false;
+                    if (!self->ex->checkin([uctx]()
+                                           { uthread::internal::thread_impl::switch_in(uctx); },
+                                           self->ctx, opts))
+                    {
+                        uthread::internal::thread_impl::switch_in(uctx);
+                    }
+                };
+                if (fut.addWaiter(&waiter))
+                {
+                    do
+                    {
+                        uthread::internal::thread_impl::switch_out(waiter.uctx);
+                        assert(fut.hasResult());
+                    } while (!fut.hasResult());
+                }
+            }
+            return fut.value();
+        }
+
         // This await interface focus on await function of an object.
         // Here is an example:
         // ```C++
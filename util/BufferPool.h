@@ -0,0 +1,412 @@
+/* A slab based pool of aligned IO buffers
+*/
+
+#ifndef ASYNC_FRAMEWORK_BUFFER_POOL_H
+#define ASYNC_FRAMEWORK_BUFFER_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <sys/mman.h>
+#include "../util/CacheLine.h"
+
+namespace async_framework::util
+{
+    // BufferPool hands out buffers aligned to kAlignment for O_DIRECT IO.
+    // The pool maps one arena of `capacity` bytes up front, backed by 2MB
+    // huge pages when the system has them reserved (MAP_HUGETLB), otherwise
+    // by normal pages with a transparent hugepage hint. The arena is faulted
+    // in at construction, so buffers never page fault afterwards.
+    //
+    // The arena is cut into kSlabSize slabs. A size class (powers of two
+    // from 4K to 2M) takes a whole slab when it runs dry and splits it into
+    // buffers. Slabs stay with their class for the pool's lifetime. Each
+    // thread keeps a small cache per class, so an allocate/release pair on
+    // the same thread takes no lock. Caches move buffers to and from the
+    // shared lists in batches.
+    //
+    // Requests larger than kMaxBufferSize, or arriving once the arena is used
+    // up, fall back to aligned_alloc. They are counted in Stat::fallbacks.
+    //
+    // All buffers must be released before the pool is destroyed. IO
+    // executors can register the arena with the kernel, see
+    // IOExecutor::setBufferPool.
+    class BufferPool
+    {
+    public:
+        static constexpr size_t kAlignment = 4096;
+        static constexpr size_t kSlabSize = 2 << 20;
+        static constexpr size_t kMinBufferSize = kAlignment;
+        static constexpr size_t kMaxBufferSize = kSlabSize;
+        static constexpr size_t kClassCount = 10;
+
+        struct Stat
+        {
+            size_t capacity = 0;
+            size_t slabsUsed = 0;
+            // 没有从arena中分配的次数
+            uint64_t fallbacks = 0;
+            bool hugePages = false;
+        };
+
+        // Buffer owns one pooled buffer and gives it back when destroyed.
+        // size() is the size of the class, which may be larger than asked.
+        class Buffer
+        {
+        public:
+            Buffer() = default;
+            Buffer(const Buffer &) = delete;
+            Buffer &operator=(const Buffer &) = delete;
+            Buffer(Buffer &&other) noexcept
+                : pool_(std::exchange(other.pool_, nullptr)), data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) {}
+            Buffer &operator=(Buffer &&other) noexcept
+            {
+                if (this != &other)
+                {
+                    reset();
+                    pool_ = std::exchange(other.pool_, nullptr);
+                    data_ = std::exchange(other.data_, nullptr);
+                    size_ = std::exchange(other.size_, 0);
+                }
+                return *this;
+            }
+            ~Buffer()
+            {
+                reset();
+            }
+
+            char *data() const noexcept
+            {
+                return data_;
+            }
+
+            size_t size() const noexcept
+            {
+                return size_;
+            }
+
+            explicit operator bool() const noexcept
+            {
+                return data_ != nullptr;
+            }
+
+            void reset()
+            {
+                if (data_ != nullptr)
+                {
+                    pool_->release(data_, size_);
+                    data_ = nullptr;
+                    size_ = 0;
+                }
+            }
+
+        private:
+            friend class BufferPool;
+            Buffer(BufferPool *pool, char *data, size_t size) : pool_(pool), data_(data), size_(size) {}
+
+            BufferPool *pool_ = nullptr;
+            char *data_ = nullptr;
+            size_t size_ = 0;
+        };
+
+        // capacity向上取整到kSlabSize。hugePages为false时不使用大页
+        explicit BufferPool(size_t capacity = 64 << 20, bool hugePages = true)
+            : id_(nextId()), capacity_((capacity + kSlabSize - 1) / kSlabSize * kSlabSize)
+        {
+            mapArena(hugePages);
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            registry().pools[id_] = this;
+        }
+
+        ~BufferPool()
+        {
+            {
+                // 之后其它线程的缓存不会再归还到这个pool
+                std::lock_guard<std::mutex> lock(registry().mutex);
+                registry().pools.erase(id_);
+            }
+            if (base_ != nullptr)
+                munmap(base_, capacity_);
+        }
+
+        BufferPool(const BufferPool &) = delete;
+        BufferPool &operator=(const BufferPool &) = delete;
+
+        Buffer allocate(size_t size)
+        {
+            if (size > kMaxBufferSize)
+            {
+                auto length = (size + kAlignment - 1) / kAlignment * kAlignment;
+                return Buffer(this, fallback(length), length);
+            }
+            auto index = classOf(size);
+            auto &cache = threadCache(index);
+            if (cache.count == 0)
+                refill(index, cache);
+            auto length = kMinBufferSize << index;
+            if (cache.count == 0)
+                return Buffer(this, fallback(length), length);
+            return Buffer(this, cache.items[--cache.count], length);
+        }
+
+        char *base() const noexcept
+        {
+            return base_;
+        }
+
+        size_t capacity() const noexcept
+        {
+            return base_ != nullptr ? capacity_ : 0;
+        }
+
+        size_t slabCount() const noexcept
+        {
+            return capacity() / kSlabSize;
+        }
+
+        bool hugePages() const noexcept
+        {
+            return hugePages_;
+        }
+
+        // [data, data + length)在arena的同一个slab中时返回slab序号，否则返回-1
+        long slabIndex(const void *data, size_t length) const noexcept
+        {
+            auto p = static_cast<const char *>(data);
+            if (base_ == nullptr || p < base_ || p >= base_ + capacity_)
+                return -1;
+            auto offset = static_cast<size_t>(p - base_);
+            auto index = offset / kSlabSize;
+            if (offset + length > (index + 1) * kSlabSize)
+                return -1;
+            return static_cast<long>(index);
+        }
+
+        Stat stat() const
+        {
+            Stat stat;
+            stat.capacity = capacity();
+            stat.slabsUsed = std::min(nextSlab_.load(std::memory_order_relaxed), slabCount());
+            stat.fallbacks = fallbacks_.load(std::memory_order_relaxed);
+            stat.hugePages = hugePages_;
+            return stat;
+        }
+
+    private:
+        // 每个线程每个类最多缓存kMaxCached个buffer，同时不超过kCacheBytes
+        static constexpr size_t kMaxCached = 64;
+        static constexpr size_t kCacheBytes = 1 << 20;
+        // 每个线程同时缓存的pool数，按id直接映射
+        static constexpr size_t kCachedPools = 2;
+
+        static constexpr size_t cacheLimit(size_t index)
+        {
+            return std::clamp<size_t>(kCacheBytes / (kMinBufferSize << index), 1, kMaxCached);
+        }
+
+        // 空闲buffer的前8个字节用作链表指针
+        struct FreeBuffer
+        {
+            FreeBuffer *next;
+        };
+
+        struct alignas(kCacheLineSize) SizeClass
+        {
+            std::mutex mutex;
+            FreeBuffer *head = nullptr;
+        };
+
+        struct ClassCache
+        {
+            size_t count = 0;
+            char *items[kMaxCached];
+        };
+
+        struct ThreadCache
+        {
+            struct Entry
+            {
+                uint64_t poolId = 0;
+                ClassCache classes[kClassCount];
+            };
+
+            ~ThreadCache()
+            {
+                for (auto &entry : entries)
+                    flush(entry);
+            }
+
+            Entry entries[kCachedPools];
+        };
+
+        struct Registry
+        {
+            std::mutex mutex;
+            std::unordered_map<uint64_t, BufferPool *> pools;
+        };
+
+        static Registry &registry()
+        {
+            static Registry registry;
+            return registry;
+        }
+
+        static uint64_t nextId()
+        {
+            static std::atomic<uint64_t> id{1};
+            return id.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        static size_t classOf(size_t size)
+        {
+            if (size <= kMinBufferSize)
+                return 0;
+            return std::bit_width(size - 1) - std::bit_width(kMinBufferSize - 1);
+        }
+
+        // 把缓存中的buffer还给所属的pool，pool已经销毁时直接丢弃
+        static void flush(ThreadCache::Entry &entry)
+        {
+            if (entry.poolId == 0)
+                return;
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            auto it = registry().pools.find(entry.poolId);
+            for (size_t i = 0; i < kClassCount; i++)
+            {
+                auto &cache = entry.classes[i];
+                if (it != registry().pools.end() && cache.count > 0)
+                    it->second->give(i, cache.items, cache.count);
+                cache.count = 0;
+            }
+            entry.poolId = 0;
+        }
+
+        ClassCache &threadCache(size_t index)
+        {
+            static thread_local ThreadCache cache;
+            auto &entry = cache.entries[id_ % kCachedPools];
+            if (entry.poolId != id_)
+            {
+                flush(entry);
+                entry.poolId = id_;
+            }
+            return entry.classes[index];
+        }
+
+        void release(char *data, size_t size)
+        {
+            if (slabIndex(data, size) < 0)
+            {
+                free(data);
+                return;
+            }
+            auto index = classOf(size);
+            auto &cache = threadCache(index);
+            auto limit = cacheLimit(index);
+            if (cache.count >= limit)
+            {
+                // 归还一半，留下一半给之后的allocate
+                auto half = (limit + 1) / 2;
+                cache.count -= half;
+                give(index, cache.items + cache.count, half);
+            }
+            cache.items[cache.count++] = data;
+        }
+
+        void give(size_t index, char **items, size_t count)
+        {
+            auto &sizeClass = classes_[index];
+            std::lock_guard<std::mutex> lock(sizeClass.mutex);
+            for (size_t i = 0; i < count; i++)
+            {
+                auto buffer = reinterpret_cast<FreeBuffer *>(items[i]);
+                buffer->next = sizeClass.head;
+                sizeClass.head = buffer;
+            }
+        }
+
+        // 从共享链表取一批，链表为空时切分一个新的slab
+        void refill(size_t index, ClassCache &cache)
+        {
+            auto want = (cacheLimit(index) + 1) / 2;
+            auto &sizeClass = classes_[index];
+            std::lock_guard<std::mutex> lock(sizeClass.mutex);
+            if (sizeClass.head == nullptr)
+            {
+                auto slab = nextSlab_.fetch_add(1, std::memory_order_relaxed);
+                if (slab >= slabCount())
+                    return;
+                auto length = kMinBufferSize << index;
+                auto begin = base_ + slab * kSlabSize;
+                for (auto p = begin + kSlabSize; p != begin;)
+                {
+                    p -= length;
+                    auto buffer = reinterpret_cast<FreeBuffer *>(p);
+                    buffer->next = sizeClass.head;
+                    sizeClass.head = buffer;
+                }
+            }
+            while (cache.count < want && sizeClass.head != nullptr)
+            {
+                auto buffer = sizeClass.head;
+                sizeClass.head = buffer->next;
+                cache.items[cache.count++] = reinterpret_cast<char *>(buffer);
+            }
+        }
+
+        char *fallback(size_t length)
+        {
+            fallbacks_.fetch_add(1, std::memory_order_relaxed);
+            return static_cast<char *>(aligned_alloc(kAlignment, length));
+        }
+
+        void mapArena(bool hugePages)
+        {
+            if (capacity_ == 0)
+                return;
+            if (hugePages)
+            {
+                auto p = mmap(nullptr, capacity_, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+                if (p != MAP_FAILED)
+                {
+                    base_ = static_cast<char *>(p);
+                    hugePages_ = true;
+                    return;
+                }
+            }
+            // 没有预留大页，多映射一个slab以便按2M对齐，透明大页才能生效
+            auto length = capacity_ + kSlabSize;
+            auto p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+                return;
+            auto raw = static_cast<char *>(p);
+            auto aligned = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(raw) + kSlabSize - 1) & ~(kSlabSize - 1));
+            if (aligned != raw)
+                munmap(raw, aligned - raw);
+            if (aligned + capacity_ != raw + length)
+                munmap(aligned + capacity_, raw + length - (aligned + capacity_));
+            base_ = aligned;
+            if (hugePages)
+                madvise(base_, capacity_, MADV_HUGEPAGE);
+            // 预先触发缺页，之后使用buffer不会再缺页
+            for (size_t offset = 0; offset < capacity_; offset += kAlignment)
+                base_[offset] = 0;
+        }
+
+        const uint64_t id_;
+        const size_t capacity_;
+        char *base_ = nullptr;
+        bool hugePages_ = false;
+        std::atomic<size_t> nextSlab_{0};
+        std::atomic<uint64_t> fallbacks_{0};
+        SizeClass classes_[kClassCount];
+    };
+}
+
+#endif
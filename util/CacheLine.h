@@ -0,0 +1,15 @@
+/* Cache line helpers
+*/
+
+#ifndef ASYNC_FRAMEWORK_CACHE_LINE_H
+#define ASYNC_FRAMEWORK_CACHE_LINE_H
+
+#include <cstddef>
+
+namespace async_framework::util
+{
+    // 缓存行大小，用于按缓存行对齐以避免伪共享
+    inline constexpr size_t kCacheLineSize = 64;
+}
+
+#endif
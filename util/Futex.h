@@ -0,0 +1,98 @@
+/* Wait and wake on a 32-bit atomic word, with an optional deadline
+*/
+
+#ifndef ASYNC_FRAMEWORK_FUTEX_H
+#define ASYNC_FRAMEWORK_FUTEX_H
+
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <thread>
+#if defined(__linux__)
+#include <cerrno>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace async_framework::util
+{
+    // futexWait blocks while word == expected, until futexWakeOne or
+    // futexWakeAll is called on the word or the deadline passes. It may
+    // return spuriously, so the caller has to check the word again. It
+    // returns false only on timeout.
+    //
+    // std::atomic::wait has no deadline, so on Linux both sides call futex
+    // directly. Other platforms use std::atomic::wait/notify, and poll with
+    // backoff when there is a deadline.
+    template <typename T>
+    inline bool futexWait(std::atomic<T> &word, T expected, const std::chrono::steady_clock::time_point *deadline = nullptr)
+    {
+        static_assert(sizeof(std::atomic<T>) == sizeof(uint32_t), "futex needs a 32-bit word");
+#if defined(__linux__)
+        struct timespec timeout;
+        struct timespec *ptimeout = nullptr;
+        if (deadline != nullptr)
+        {
+            auto left = *deadline - std::chrono::steady_clock::now();
+            if (left <= std::chrono::steady_clock::duration::zero())
+            {
+                return false;
+            }
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+            timeout.tv_sec = ns / 1000000000;
+            timeout.tv_nsec = ns % 1000000000;
+            ptimeout = &timeout;
+        }
+        // FUTEX_WAIT的超时是CLOCK_MONOTONIC上的相对时间，与steady_clock一致
+        auto ret = ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT_PRIVATE,
+                             static_cast<uint32_t>(expected), ptimeout, nullptr, 0);
+        return !(ret == -1 && errno == ETIMEDOUT);
+#else
+        if (deadline == nullptr)
+        {
+            word.wait(expected, std::memory_order_acquire);
+            return true;
+        }
+        // 没有futex时退化为带退避的轮询
+        std::chrono::microseconds sleep(1);
+        while (word.load(std::memory_order_acquire) == expected)
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= *deadline)
+            {
+                return false;
+            }
+            std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(sleep, *deadline - now));
+            sleep = std::min(sleep * 2, std::chrono::microseconds(1000));
+        }
+        return true;
+#endif
+    }
+
+    template <typename T>
+    inline void futexWakeOne(std::atomic<T> &word)
+    {
+        static_assert(sizeof(std::atomic<T>) == sizeof(uint32_t), "futex needs a 32-bit word");
+#if defined(__linux__)
+        ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+        word.notify_one();
+#endif
+    }
+
+    template <typename T>
+    inline void futexWakeAll(std::atomic<T> &word)
+    {
+        static_assert(sizeof(std::atomic<T>) == sizeof(uint32_t), "futex needs a 32-bit word");
+#if defined(__linux__)
+        ::syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#else
+        word.notify_all();
+#endif
+    }
+}
+
+#endif
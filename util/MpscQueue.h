@@ -0,0 +1,89 @@
+/* An intrusive lock-free multi-producer single-consumer queue
+*/
+
+#ifndef ASYNC_FRAMEWORK_MPSC_QUEUE_H
+#define ASYNC_FRAMEWORK_MPSC_QUEUE_H
+
+#include <atomic>
+#include "../util/CacheLine.h"
+
+namespace async_framework::util
+{
+    // 放入MpscQueue的元素需要继承MpscNode
+    struct MpscNode
+    {
+        std::atomic<MpscNode *> next{nullptr};
+    };
+
+    // MpscQueue is Dmitry Vyukov's intrusive MPSC queue. A push is one
+    // exchange on the head plus one store and never waits for other
+    // producers. pop may be called by one consumer thread only. It can
+    // return nullptr while a producer is between its two steps, even though
+    // the queue is not empty. Callers that know an element is coming (for
+    // example from a separate counter) just retry.
+    //
+    // The queue does not own its nodes. Nodes still queued when the queue
+    // is destroyed must be popped and released by the owner first.
+    template <typename T>
+    class MpscQueue
+    {
+    public:
+        MpscQueue() : head_(&stub_), tail_(&stub_) {}
+
+        MpscQueue(const MpscQueue &) = delete;
+        MpscQueue &operator=(const MpscQueue &) = delete;
+
+        // 任意线程都可以调用
+        void push(T *node) noexcept
+        {
+            push(static_cast<MpscNode *>(node));
+        }
+
+        // 只能由消费者调用
+        T *pop() noexcept
+        {
+            auto tail = tail_;
+            auto next = tail->next.load(std::memory_order_acquire);
+            if (tail == &stub_)
+            {
+                if (next == nullptr)
+                    return nullptr;
+                tail_ = next;
+                tail = next;
+                next = next->next.load(std::memory_order_acquire);
+            }
+            if (next != nullptr)
+            {
+                tail_ = next;
+                return static_cast<T *>(tail);
+            }
+            // tail是最后一个节点，或者有生产者还没有链接上
+            if (tail != head_.load(std::memory_order_acquire))
+                return nullptr;
+            push(&stub_);
+            next = tail->next.load(std::memory_order_acquire);
+            if (next != nullptr)
+            {
+                tail_ = next;
+                return static_cast<T *>(tail);
+            }
+            return nullptr;
+        }
+
+    private:
+        void push(MpscNode *node) noexcept
+        {
+            node->next.store(nullptr, std::memory_order_relaxed);
+            auto prev = head_.exchange(node, std::memory_order_acq_rel);
+            prev->next.store(node, std::memory_order_release);
+        }
+
+        // 生产者
+        alignas(kCacheLineSize) std::atomic<MpscNode *> head_;
+        // 消费者
+        alignas(kCacheLineSize) MpscNode *tail_;
+        MpscNode stub_;
+    };
+}
+
+#endif
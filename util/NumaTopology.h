@@ -0,0 +1,97 @@
+/* NUMA topology discovery from sysfs
+*/
+
+#ifndef ASYNC_FRAMEWORK_NUMA_TOPOLOGY_H
+#define ASYNC_FRAMEWORK_NUMA_TOPOLOGY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace async_framework::util
+{
+    struct NumaNode
+    {
+        // 操作系统中的node编号
+        uint32_t id = 0;
+        std::vector<uint32_t> cpus;
+    };
+
+    // NumaTopology lists the NUMA nodes and their cpus by reading
+    // /sys/devices/system/node/node*/cpulist. Only cpus in `allowed` are kept
+    // and nodes left without a cpu are dropped. When sysfs is unavailable
+    // (non-Linux, containers without /sys) the result is one node holding
+    // all allowed cpus.
+    class NumaTopology
+    {
+    public:
+        static NumaTopology detect(const std::vector<uint32_t> &allowed, const std::string &root = "/sys/devices/system/node")
+        {
+            NumaTopology topology;
+            std::error_code ec;
+            for (auto &entry : std::filesystem::directory_iterator(root, ec))
+            {
+                auto name = entry.path().filename().string();
+                if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+                    !std::all_of(name.begin() + 4, name.end(), [](char c)
+                                 { return c >= '0' && c <= '9'; }))
+                    continue;
+                std::ifstream in(entry.path() / "cpulist");
+                std::string cpulist;
+                if (!std::getline(in, cpulist))
+                    continue;
+                NumaNode node;
+                node.id = static_cast<uint32_t>(std::stoul(name.substr(4)));
+                for (auto cpu : parseCpuList(cpulist))
+                {
+                    if (std::find(allowed.begin(), allowed.end(), cpu) != allowed.end())
+                        node.cpus.push_back(cpu);
+                }
+                if (!node.cpus.empty())
+                    topology.nodes_.push_back(std::move(node));
+            }
+            std::sort(topology.nodes_.begin(), topology.nodes_.end(), [](auto &a, auto &b)
+                      { return a.id < b.id; });
+            if (topology.nodes_.empty() && !allowed.empty())
+                topology.nodes_.push_back(NumaNode{0, allowed});
+            return topology;
+        }
+
+        // 解析"0-3,8-11"格式的cpu列表
+        static std::vector<uint32_t> parseCpuList(const std::string &list)
+        {
+            std::vector<uint32_t> cpus;
+            size_t pos = 0;
+            while (pos < list.size())
+            {
+                auto end = list.find(',', pos);
+                if (end == std::string::npos)
+                    end = list.size();
+                auto range = list.substr(pos, end - pos);
+                pos = end + 1;
+                if (range.empty() || range[0] < '0' || range[0] > '9')
+                    continue;
+                auto dash = range.find('-');
+                auto first = std::strtoul(range.c_str(), nullptr, 10);
+                auto last = dash == std::string::npos ? first : std::strtoul(range.c_str() + dash + 1, nullptr, 10);
+                for (auto cpu = first; cpu <= last; cpu++)
+                    cpus.push_back(static_cast<uint32_t>(cpu));
+            }
+            return cpus;
+        }
+
+        const std::vector<NumaNode> &nodes() const noexcept
+        {
+            return nodes_;
+        }
+
+    private:
+        std::vector<NumaNode> nodes_;
+    };
+}
+
+#endif
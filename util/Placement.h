@@ -0,0 +1,92 @@
+/* Queue placement strategies for ThreadPool
+*/
+
+#ifndef ASYNC_FRAMEWORK_PLACEMENT_H
+#define ASYNC_FRAMEWORK_PLACEMENT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace async_framework::util
+{
+    // 线程局部的xorshift32，不像std::rand那样在glibc中需要全局锁
+    inline uint32_t fastRand() noexcept
+    {
+        static thread_local uint32_t state = []
+        {
+            auto seed = static_cast<uint32_t>(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+            return seed != 0 ? seed : 0x9E3779B9u;
+        }();
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    // RANDOM: 均匀随机选择。
+    // TWO_CHOICES: 随机选两个worker，取近似队列长度较短的一个。
+    // ROUND_ROBIN: 所有提交线程共享一个游标，依次轮转。
+    // CALLER_LOCAL: 调用者是候选worker之一时放入调用者自己的队列，否则同TWO_CHOICES。
+    enum class PLACEMENT_TYPE
+    {
+        RANDOM = 0,
+        TWO_CHOICES,
+        ROUND_ROBIN,
+        CALLER_LOCAL,
+    };
+
+    // Placement picks the worker queue for a task that was not submitted to
+    // a specific worker. Queue depths are read without locks, so
+    // TWO_CHOICES balances on a slightly stale view, which is enough to
+    // avoid the long tails of pure random placement.
+    class Placement
+    {
+    public:
+        explicit Placement(PLACEMENT_TYPE type = PLACEMENT_TYPE::TWO_CHOICES) : type_(type) {}
+
+        PLACEMENT_TYPE type() const noexcept
+        {
+            return type_;
+        }
+
+        // 返回选中的worker在workers中的下标。workers不能为空，depth(id)返回worker id的
+        // 近似队列长度；local是调用者在workers中的下标，调用者不在workers中时为-1
+        template <typename Depth>
+        size_t pick(const std::vector<size_t> &workers, Depth &&depth, int32_t local = -1) const
+        {
+            auto n = workers.size();
+            if (n == 1)
+                return 0;
+            switch (type_)
+            {
+            case PLACEMENT_TYPE::RANDOM:
+                return fastRand() % n;
+            case PLACEMENT_TYPE::ROUND_ROBIN:
+                return cursor_.fetch_add(1, std::memory_order_relaxed) % n;
+            case PLACEMENT_TYPE::CALLER_LOCAL:
+                if (local != -1)
+                    return local;
+                [[fallthrough]];
+            case PLACEMENT_TYPE::TWO_CHOICES:
+            default:
+            {
+                auto r = fastRand();
+                size_t first = r % n;
+                // 第二个与第一个不同
+                size_t second = (first + 1 + (r >> 16) % (n - 1)) % n;
+                return depth(workers[first]) <= depth(workers[second]) ? first : second;
+            }
+            }
+        }
+
+    private:
+        PLACEMENT_TYPE type_;
+        mutable std::atomic<size_t> cursor_{0};
+    };
+}
+
+#endif
@@ -0,0 +1,221 @@
+/* A multi-level queue with starvation protection
+*/
+
+#ifndef ASYNC_FRAMEWORK_PRIORITY_QUEUE_H
+#define ASYNC_FRAMEWORK_PRIORITY_QUEUE_H
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include "../util/RingQueue.h"
+
+namespace async_framework::util
+{
+    // PriorityQueue has the same interface as Queue, but every element is
+    // pushed with a level in [0, Levels). Less level is more important and
+    // elements in the same level are FIFO.
+    //
+    // To keep the less important levels from starving, after StarvationLimit
+    // consecutive pops that bypassed a non-empty less important level, the
+    // next pop takes from the least important non-empty level instead.
+    template <typename T, uint32_t Levels = 16, uint32_t StarvationLimit = 32>
+        requires std::is_move_assignable_v<T> && (Levels > 0 && Levels <= 32)
+    class PriorityQueue
+    {
+    public:
+        static constexpr uint32_t kLevels = Levels;
+
+        void push(T &&elem, uint32_t level)
+        {
+            {
+                std::scoped_lock guard(mutex_);
+                pushLocked(std::move(elem), level);
+            }
+            cond_.notify_one();
+        }
+        // 在一次加锁中把make(0) ... make(n - 1)压入同一个level
+        template <typename Make>
+        void push_batch(size_t n, Make &&make, uint32_t level)
+        {
+            {
+                std::scoped_lock guard(mutex_);
+                for (size_t i = 0; i < n; i++)
+                    pushLocked(make(i), level);
+            }
+            if (n > 1)
+                cond_.notify_all();
+            else
+                cond_.notify_one();
+        }
+        bool try_push(const T &elem, uint32_t level)
+        {
+            {
+                std::unique_lock lock(mutex_, std::try_to_lock);
+                if (!lock)
+                    return false;
+                pushLocked(T(elem), level);
+            }
+            cond_.notify_one();
+            return true;
+        }
+        // 只有成功时才会移动elem
+        bool try_push(T &&elem, uint32_t level)
+        {
+            {
+                std::unique_lock lock(mutex_, std::try_to_lock);
+                if (!lock)
+                    return false;
+                pushLocked(std::move(elem), level);
+            }
+            cond_.notify_one();
+            return true;
+        }
+        bool pop(T &elem)
+        {
+            std::unique_lock lock(mutex_);
+            cond_.wait(lock, [&]()
+                       { return count_ != 0 || stop_; });
+            return popLocked(elem, Levels - 1);
+        }
+        // 只取level <= maxLevel的元素
+        bool try_pop(T &elem, uint32_t maxLevel = Levels - 1)
+        {
+            if (!hasLevelAtMost(maxLevel))
+                return false;
+            std::unique_lock lock(mutex_, std::try_to_lock);
+            if (!lock)
+                return false;
+            return popLocked(elem, maxLevel);
+        }
+        // 取最不重要的非空level中的元素
+        bool try_pop_lowest(T &elem)
+        {
+            if (levelMask() == 0)
+                return false;
+            std::unique_lock lock(mutex_, std::try_to_lock);
+            if (!lock || count_ == 0)
+                return false;
+            popLevel(elem, lowestLevel(mask_.load(std::memory_order_relaxed)));
+            return true;
+        }
+        bool try_pop_if(T &elem, std::function<bool(T &)> predict = nullptr)
+        {
+            std::unique_lock lock(mutex_, std::try_to_lock);
+            if (!lock || count_ == 0)
+                return false;
+            auto level = highestLevel(mask_.load(std::memory_order_relaxed));
+            if (predict && !predict(queues_[level].front()))
+                return false;
+            popLevel(elem, level);
+            return true;
+        }
+        std::size_t size() const
+        {
+            std::scoped_lock lock(mutex_);
+            return count_;
+        }
+        bool empty()
+        {
+            std::scoped_lock lock(mutex_);
+            return count_ == 0;
+        }
+        // 不加锁的近似大小
+        std::size_t approx_size() const noexcept
+        {
+            return size_.load(std::memory_order_relaxed);
+        }
+        // 不加锁，返回非空level的位图，bit i表示level i非空
+        uint32_t levelMask() const noexcept
+        {
+            return mask_.load(std::memory_order_relaxed);
+        }
+        bool hasLevelAtMost(uint32_t maxLevel) const noexcept
+        {
+            return (levelMask() & maskAtMost(maxLevel)) != 0;
+        }
+        void stop()
+        {
+            {
+                std::scoped_lock lock(mutex_);
+                stop_ = true;
+            }
+            cond_.notify_all();
+        }
+
+    private:
+        static constexpr uint32_t maskAtMost(uint32_t level)
+        {
+            return level >= 31 ? ~uint32_t(0) : (uint32_t(1) << (level + 1)) - 1;
+        }
+        static uint32_t highestLevel(uint32_t mask)
+        {
+            return std::countr_zero(mask);
+        }
+        static uint32_t lowestLevel(uint32_t mask)
+        {
+            return 31 - std::countl_zero(mask);
+        }
+
+        void pushLocked(T &&elem, uint32_t level)
+        {
+            if (level >= Levels)
+                level = Levels - 1;
+            queues_[level].push(std::move(elem));
+            ++count_;
+            size_.store(count_, std::memory_order_relaxed);
+            mask_.store(mask_.load(std::memory_order_relaxed) | (uint32_t(1) << level), std::memory_order_relaxed);
+        }
+
+        bool popLocked(T &elem, uint32_t maxLevel)
+        {
+            auto mask = mask_.load(std::memory_order_relaxed) & maskAtMost(maxLevel);
+            if (mask == 0)
+                return false;
+            auto level = highestLevel(mask);
+            if (level != lowestLevel(mask))
+            {
+                // 有更不重要的level被跳过
+                if (++bypassed_ >= StarvationLimit)
+                {
+                    level = lowestLevel(mask);
+                    bypassed_ = 0;
+                }
+            }
+            else
+            {
+                bypassed_ = 0;
+            }
+            popLevel(elem, level);
+            return true;
+        }
+
+        void popLevel(T &elem, uint32_t level)
+        {
+            auto &queue = queues_[level];
+            elem = std::move(queue.front());
+            queue.pop();
+            --count_;
+            size_.store(count_, std::memory_order_relaxed);
+            if (queue.empty())
+                mask_.store(mask_.load(std::memory_order_relaxed) & ~(uint32_t(1) << level), std::memory_order_relaxed);
+        }
+
+    private:
+        std::array<RingQueue<T>, Levels> queues_;
+        std::size_t count_ = 0;
+        // 只在持有mutex_时修改，读可以不加锁
+        std::atomic<std::size_t> size_{0};
+        std::atomic<uint32_t> mask_{0};
+        uint32_t bypassed_ = 0;
+        bool stop_ = false;
+        mutable std::mutex mutex_;
+        std::condition_variable cond_;
+    };
+}
+
+#endif
@@ -4,11 +4,12 @@
 #ifndef ASYNC_FRAMEWORK_QUEUE_H
 #define ASYNC_FRAMEWORK_QUEUE_H
 
+#include <atomic>
 #include <condition_variable>
 #include <mutex>
-#include <queue>
 #include <utility>
 #include <functional>
+#include "../util/RingQueue.h"
 
 namespace async_framework::util
 {
@@ -21,10 +22,26 @@ namespace async_framework::util
         {
             {
                 std::scoped_lock guard(mutex_);
-                queue_.push(std::move(T));
+                queue_.push(std::move(elem));
+                size_.store(queue_.size(), std::memory_order_relaxed);
             }
             cond_.notify_one();
         }
+        // 在一次加锁中压入make(0) ... make(n - 1)
+        template <typename Make>
+        void push_batch(size_t n, Make &&make)
+        {
+            {
+                std::scoped_lock guard(mutex_);
+                for (size_t i = 0; i < n; i++)
+                    queue_.push(make(i));
+                size_.store(queue_.size(), std::memory_order_relaxed);
+            }
+            if (n > 1)
+                cond_.notify_all();
+            else
+                cond_.notify_one();
+        }
         bool try_push(const T &elem)
         {
             {
@@ -32,6 +49,7 @@ namespace async_framework::util
                 if (!lock)
                     return false;
                 queue_.push(elem);
+                size_.store(queue_.size(), std::memory_order_relaxed);
             }
             cond_.notify_one();
             return true;
@@ -40,11 +58,12 @@ namespace async_framework::util
         {
             std::unique_lock lock(mutex_);
             cond_.wait(lock, [&]()
-                       { return !queue_.empty() || stop_ });
+                       { return !queue_.empty() || stop_; });
             if (queue_.empty())
                 return false;
-            item = std::move(queue_.front());
+            elem = std::move(queue_.front());
             queue_.pop();
+            size_.store(queue_.size(), std::memory_order_relaxed);
             return true;
         }
         bool try_pop(T &elem)
@@ -52,11 +71,12 @@ namespace async_framework::util
             std::unique_lock lock(mutex_, std::try_to_lock);
             if (!lock || queue_.empty())
                 return false;
-            elem = move(queue_.front());
+            elem = std::move(queue_.front());
             queue_.pop();
+            size_.store(queue_.size(), std::memory_order_relaxed);
             return true;
         }
-        bool try_pop_if(T &elem, function<bool(T &)> predict = nullptr)
+        bool try_pop_if(T &elem, std::function<bool(T &)> predict = nullptr)
         {
             std::unique_lock lock(mutex_, std::try_to_lock);
             if (!lock || queue_.empty())
@@ -65,6 +85,7 @@ namespace async_framework::util
                 return false;
             elem = std::move(queue_.front());
             queue_.pop();
+            size_.store(queue_.size(), std::memory_order_relaxed);
             return true;
         }
         std::size_t size() const
@@ -72,12 +93,17 @@ namespace async_framework::util
             std::scoped_lock lock(mutex_);
             return queue_.size();
         }
+        // 不加锁的近似大小
+        std::size_t approx_size() const noexcept
+        {
+            return size_.load(std::memory_order_relaxed);
+        }
         bool empty()
         {
             std::scoped_lock lock(mutex_);
             return queue_.empty();
         }
-        bool stop()
+        void stop()
         {
             {
                 std::scoped_lock lock(mutex_);
@@ -87,7 +113,9 @@ namespace async_framework::util
         }
 
     private:
-        std::queue<T> queue_;
+        RingQueue<T> queue_;
+        // 只在持有mutex_时修改
+        std::atomic<std::size_t> size_{0};
         bool stop_ = false;
         mutable std::mutex mutex_;
         std::condition_variable cond_;
@@ -0,0 +1,103 @@
+/* A growable ring buffer FIFO
+*/
+
+#ifndef ASYNC_FRAMEWORK_RING_QUEUE_H
+#define ASYNC_FRAMEWORK_RING_QUEUE_H
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace async_framework::util
+{
+    // RingQueue is a drop-in replacement for std::queue used by the task
+    // queues. std::deque allocates and frees a node every few hundred bytes
+    // of elements, RingQueue keeps one power-of-two buffer that only grows,
+    // so a queue in steady state never touches the allocator.
+    //
+    // Not thread safe.
+    template <typename T>
+    class RingQueue
+    {
+    public:
+        explicit RingQueue(size_t capacity = 16)
+        {
+            assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+            buffer_ = alloc_.allocate(capacity);
+            capacity_ = capacity;
+        }
+
+        ~RingQueue()
+        {
+            while (!empty())
+                pop();
+            alloc_.deallocate(buffer_, capacity_);
+        }
+
+        RingQueue(const RingQueue &) = delete;
+        RingQueue &operator=(const RingQueue &) = delete;
+
+        void push(T &&elem)
+        {
+            if (size_ == capacity_)
+                grow();
+            std::construct_at(buffer_ + ((head_ + size_) & (capacity_ - 1)), std::move(elem));
+            ++size_;
+        }
+
+        void push(const T &elem)
+        {
+            push(T(elem));
+        }
+
+        T &front()
+        {
+            assert(size_ > 0);
+            return buffer_[head_];
+        }
+
+        void pop()
+        {
+            assert(size_ > 0);
+            std::destroy_at(buffer_ + head_);
+            head_ = (head_ + 1) & (capacity_ - 1);
+            --size_;
+        }
+
+        bool empty() const noexcept
+        {
+            return size_ == 0;
+        }
+
+        size_t size() const noexcept
+        {
+            return size_;
+        }
+
+    private:
+        void grow()
+        {
+            auto capacity = capacity_ * 2;
+            auto buffer = alloc_.allocate(capacity);
+            for (size_t i = 0; i < size_; i++)
+            {
+                auto elem = buffer_ + ((head_ + i) & (capacity_ - 1));
+                std::construct_at(buffer + i, std::move(*elem));
+                std::destroy_at(elem);
+            }
+            alloc_.deallocate(buffer_, capacity_);
+            buffer_ = buffer;
+            capacity_ = capacity;
+            head_ = 0;
+        }
+
+        std::allocator<T> alloc_;
+        T *buffer_ = nullptr;
+        size_t capacity_ = 0;
+        size_t head_ = 0;
+        size_t size_ = 0;
+    };
+}
+
+#endif
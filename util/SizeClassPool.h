@@ -0,0 +1,207 @@
+/* A size-class pool for small, short lived objects
+*/
+
+#ifndef ASYNC_FRAMEWORK_SIZE_CLASS_POOL_H
+#define ASYNC_FRAMEWORK_SIZE_CLASS_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include "../util/CacheLine.h"
+
+namespace async_framework::util
+{
+    // SizeClassPool serves allocations of up to kMaxSize bytes from per-thread
+    // heaps, in size classes 16 bytes apart. It is meant for objects that are
+    // created and destroyed at a high rate, such as FutureState.
+    //
+    // Every block belongs to the heap that carved it. A block freed on its
+    // owner thread goes back onto the heap's local free list, which takes no
+    // atomic operation. A block freed on another thread is pushed onto the
+    // owner's remote list, a lock-free stack. The owner takes the whole stack
+    // in one exchange when its local list runs dry.
+    //
+    // Heaps are never released. When a thread exits, its heap is parked and
+    // handed to the next new thread, together with any blocks still freed
+    // into it remotely. Memory is taken from malloc in kChunkSize chunks and
+    // kept for reuse. Larger requests, and requests from a thread that is
+    // shutting down, go straight to malloc.
+    class SizeClassPool
+    {
+    public:
+        static constexpr size_t kMaxSize = 512;
+        static constexpr size_t kGranularity = 16;
+        static constexpr size_t kClassCount = kMaxSize / kGranularity;
+        static constexpr size_t kChunkSize = 64 << 10;
+
+        static void *allocate(size_t size)
+        {
+            if (size > kMaxSize)
+                return ::operator new(size);
+            auto heap = currentHeap();
+            if (heap == nullptr)
+            {
+                auto header = static_cast<Header *>(std::malloc(sizeof(Header) + size));
+                if (header == nullptr)
+                    throw std::bad_alloc();
+                header->owner = nullptr;
+                return header + 1;
+            }
+            auto index = classOf(size);
+            auto block = heap->local[index];
+            if (block == nullptr)
+            {
+                // 先收回其它线程释放的block，没有时再切分新的chunk
+                block = heap->remote[index].exchange(nullptr, std::memory_order_acquire);
+                if (block == nullptr)
+                    block = carve(heap, index);
+            }
+            heap->local[index] = block->next;
+            return block;
+        }
+
+        // size必须与allocate时相同
+        static void deallocate(void *p, size_t size) noexcept
+        {
+            if (p == nullptr)
+                return;
+            if (size > kMaxSize)
+            {
+                ::operator delete(p);
+                return;
+            }
+            auto header = static_cast<Header *>(p) - 1;
+            auto owner = header->owner;
+            if (owner == nullptr)
+            {
+                std::free(header);
+                return;
+            }
+            auto index = classOf(size);
+            auto block = static_cast<FreeBlock *>(p);
+            if (owner == currentHeap())
+            {
+                block->next = owner->local[index];
+                owner->local[index] = block;
+                return;
+            }
+            auto &remote = owner->remote[index];
+            auto head = remote.load(std::memory_order_relaxed);
+            do
+            {
+                block->next = head;
+            } while (!remote.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+        }
+
+    private:
+        struct FreeBlock
+        {
+            FreeBlock *next;
+        };
+
+        struct Heap
+        {
+            FreeBlock *local[kClassCount] = {};
+            alignas(kCacheLineSize) std::atomic<FreeBlock *> remote[kClassCount] = {};
+            // 线程退出后挂在parked链表上
+            Heap *nextParked = nullptr;
+        };
+
+        // 每个block前面保存所属的heap，保持16字节对齐
+        struct alignas(16) Header
+        {
+            Heap *owner;
+        };
+
+        struct Parked
+        {
+            std::mutex mutex;
+            Heap *head = nullptr;
+        };
+
+        // 线程退出时把heap放回parked链表
+        struct HeapHolder
+        {
+            ~HeapHolder()
+            {
+                auto &heap = threadHeap();
+                if (heap != nullptr)
+                {
+                    auto &parked = parkedHeaps();
+                    std::lock_guard<std::mutex> lock(parked.mutex);
+                    heap->nextParked = parked.head;
+                    parked.head = heap;
+                }
+                heap = nullptr;
+                threadExited() = true;
+            }
+        };
+
+        static size_t classOf(size_t size)
+        {
+            return size == 0 ? 0 : (size - 1) / kGranularity;
+        }
+
+        static Parked &parkedHeaps()
+        {
+            static Parked parked;
+            return parked;
+        }
+
+        // 平凡析构的thread_local在HeapHolder析构之后仍然可以访问
+        static Heap *&threadHeap()
+        {
+            static thread_local Heap *heap = nullptr;
+            return heap;
+        }
+
+        static bool &threadExited()
+        {
+            static thread_local bool exited = false;
+            return exited;
+        }
+
+        static Heap *currentHeap()
+        {
+            auto &heap = threadHeap();
+            if (heap != nullptr || threadExited())
+                return heap;
+            {
+                auto &parked = parkedHeaps();
+                std::lock_guard<std::mutex> lock(parked.mutex);
+                if (parked.head != nullptr)
+                {
+                    heap = parked.head;
+                    parked.head = heap->nextParked;
+                }
+            }
+            if (heap == nullptr)
+                heap = new Heap;
+            static thread_local HeapHolder holder;
+            return heap;
+        }
+
+        static FreeBlock *carve(Heap *heap, size_t index)
+        {
+            auto stride = sizeof(Header) + (index + 1) * kGranularity;
+            auto count = kChunkSize / stride;
+            auto chunk = static_cast<char *>(std::malloc(count * stride));
+            if (chunk == nullptr)
+                throw std::bad_alloc();
+            FreeBlock *head = nullptr;
+            for (auto i = count; i > 0; i--)
+            {
+                auto header = reinterpret_cast<Header *>(chunk + (i - 1) * stride);
+                header->owner = heap;
+                auto block = reinterpret_cast<FreeBlock *>(header + 1);
+                block->next = head;
+                head = block;
+            }
+            return head;
+        }
+    };
+}
+
+#endif
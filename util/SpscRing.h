@@ -0,0 +1,106 @@
+/* A bounded lock-free single-producer single-consumer ring
+*/
+
+#ifndef ASYNC_FRAMEWORK_SPSC_RING_H
+#define ASYNC_FRAMEWORK_SPSC_RING_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include "../util/CacheLine.h"
+
+namespace async_framework::util
+{
+    // SpscRing connects exactly one producer thread to one consumer thread.
+    // The producer and the consumer index live on separate cache lines and
+    // each side caches the other side's index, so in steady state a push
+    // or pop touches only the slot and its own line. Handing an element to
+    // another core costs the slot write plus one release store.
+    template <typename T>
+    class SpscRing
+    {
+    public:
+        explicit SpscRing(size_t capacity = 128)
+        {
+            assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+            buffer_ = alloc_.allocate(capacity);
+            mask_ = capacity - 1;
+        }
+
+        ~SpscRing()
+        {
+            auto tail = tail_.load(std::memory_order_acquire);
+            for (auto head = head_.load(std::memory_order_relaxed); head != tail; head++)
+                std::destroy_at(buffer_ + (head & mask_));
+            alloc_.deallocate(buffer_, mask_ + 1);
+        }
+
+        SpscRing(const SpscRing &) = delete;
+        SpscRing &operator=(const SpscRing &) = delete;
+
+        // 只能由生产者调用。满时返回false，elem不会被移动
+        bool try_push(T &&elem)
+        {
+            auto tail = tail_.load(std::memory_order_relaxed);
+            if (tail - headCache_ > mask_)
+            {
+                headCache_ = head_.load(std::memory_order_acquire);
+                if (tail - headCache_ > mask_)
+                    return false;
+            }
+            std::construct_at(buffer_ + (tail & mask_), std::move(elem));
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
+        }
+
+        // 只能由消费者调用
+        bool try_pop(T &elem)
+        {
+            auto head = head_.load(std::memory_order_relaxed);
+            if (head == tailCache_)
+            {
+                tailCache_ = tail_.load(std::memory_order_acquire);
+                if (head == tailCache_)
+                    return false;
+            }
+            auto slot = buffer_ + (head & mask_);
+            elem = std::move(*slot);
+            std::destroy_at(slot);
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // 任意线程都可以调用，返回的是近似值
+        size_t approx_size() const noexcept
+        {
+            auto tail = tail_.load(std::memory_order_acquire);
+            auto head = head_.load(std::memory_order_acquire);
+            return tail > head ? tail - head : 0;
+        }
+
+        bool empty() const noexcept
+        {
+            return approx_size() == 0;
+        }
+
+        size_t capacity() const noexcept
+        {
+            return mask_ + 1;
+        }
+
+    private:
+        std::allocator<T> alloc_;
+        T *buffer_ = nullptr;
+        size_t mask_ = 0;
+        // 生产者
+        alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+        size_t headCache_ = 0;
+        // 消费者
+        alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+        size_t tailCache_ = 0;
+    };
+}
+
+#endif
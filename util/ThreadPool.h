@@ -2,15 +2,29 @@
 */
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
 #include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <span>
 #include <thread>
 #include <vector>
 #include <cstdlib>
 #include <format>
+#include "../util/NumaTopology.h"
+#include "../util/Placement.h"
+#include "../util/PriorityQueue.h"
 #include "../util/Queue.h"
+#include "../util/Futex.h"
+#include "../util/WorkStealingDeque.h"
+#include "../util/WorkerStat.h"
+#include "../util/move_only_function.h"
 
 namespace async_framework::util
 {
@@ -21,7 +35,12 @@ namespace async_framework::util
         {
             // 是否允许偷取策略
             bool canSteal = false;
-            std::function<void()> fn = nullptr;
+            // 小闭包存放在TaskFunc的内联缓冲中，不需要分配内存
+            TaskFunc fn = nullptr;
+            // 提交时间，用于统计排队延迟
+            uint64_t enqueueNs = 0;
+            // 非空时直接resume，不经过fn
+            std::coroutine_handle<> handle = nullptr;
         };
 
         enum class ERROR_TYPE
@@ -30,25 +49,289 @@ namespace async_framework::util
             ERROR_POOL_HAS_STOP,
             ERROR_POOL_ITEM_IS_NULL,
         };
-        explicit ThreadPool(size_t threadNum = std::thread::hardware_concurrency(), bool enableWorkSteal = false, bool enableCoreBindings = false);
+
+        // MUTEX_QUEUE: 每个worker一个带锁的Queue，enableWorkSteal时通过try_pop_if偷取。
+        // WORK_STEALING_DEQUE: 每个worker一个无锁的Chase-Lev deque，worker内部提交的任务
+        // 压入自己deque的bottom端，空闲worker从其它deque的top端偷取；外部线程提交的任务
+        // 进入全局的注入队列。指定id的任务仍进入对应worker的Queue，不会被偷取。
+        // 其它worker能偷取任务时(WORK_STEALING_DEQUE或者enableWorkSteal)，worker内部提交的
+        // 默认优先级任务先放入该worker的LIFO槽，见NextSlot。
+        enum class QUEUE_TYPE
+        {
+            MUTEX_QUEUE = 0,
+            WORK_STEALING_DEQUE,
+        };
+
+        // 优先级与Executor::Priority一致，共16级，数值越小越重要。
+        // >= kYieldPriority的任务在有其它任务等待时不会被优先执行。
+        static constexpr uint32_t kPriorityLevels = 16;
+        static constexpr uint32_t kDefaultPriority = 0x7;
+        static constexpr uint32_t kYieldPriority = 0x8;
+        // 每取kStarvationLimit个任务，至少给低优先级的任务一次机会
+        static constexpr uint32_t kStarvationLimit = 32;
+
+        // worker没有任务时先自旋spinCount次，再让出cpu yieldCount次，仍然没有任务才park。
+        // 两者都为0时立即park。同时自旋的worker不超过线程数的一半。
+        struct IdlePolicy
+        {
+            IdlePolicy(uint32_t spin = 64, uint32_t yield = 8) : spinCount(spin), yieldCount(yield) {}
+
+            uint32_t spinCount;
+            uint32_t yieldCount;
+        };
+
+        // 弹性模式: worker执行一个任务超过blockedThreshold，或者处于BlockingScope中时视为被阻塞，
+        // 此时有任务在排队就启动临时worker补偿，最多maxCompensate个。临时worker只处理可以偷取的任务，
+        // 空闲keepAlive后退出。maxCompensate为0时关闭弹性模式。
+        struct ElasticPolicy
+        {
+            ElasticPolicy(uint32_t maxCompensate = 0, std::chrono::microseconds blockedThreshold = std::chrono::milliseconds(10),
+                          std::chrono::microseconds keepAlive = std::chrono::milliseconds(100))
+                : maxCompensate(maxCompensate), blockedThreshold(blockedThreshold), keepAlive(keepAlive) {}
+
+            uint32_t maxCompensate;
+            std::chrono::microseconds blockedThreshold;
+            std::chrono::microseconds keepAlive;
+        };
+
+        // 在worker中执行阻塞调用(文件IO、DNS等)前声明一个BlockingScope。LIFO槽中的任务会马上交给
+        // 其它worker，弹性模式的线程池还会立即补偿，不需要等到超过blockedThreshold。
+        // 不在worker线程中时什么也不做。
+        class BlockingScope
+        {
+        public:
+            BlockingScope();
+            ~BlockingScope();
+            BlockingScope(const BlockingScope &) = delete;
+            BlockingScope &operator=(const BlockingScope &) = delete;
+
+        private:
+            ThreadPool *pool_ = nullptr;
+            size_t id_ = 0;
+        };
+
+        // enableCoreBindings时按/sys/devices/system/node中的NUMA拓扑把worker划分到各个node，
+        // 并绑定到node内的cpu。每个node有自己的注入队列，空闲worker优先从同一个node偷取。
+        // 不绑核时所有worker属于同一个node。
+        explicit ThreadPool(size_t threadNum = std::thread::hardware_concurrency(), bool enableWorkSteal = false, bool enableCoreBindings = false,
+                            QUEUE_TYPE queueType = QUEUE_TYPE::MUTEX_QUEUE, IdlePolicy idlePolicy = IdlePolicy(),
+                            ElasticPolicy elasticPolicy = ElasticPolicy(), PLACEMENT_TYPE placement = PLACEMENT_TYPE::TWO_CHOICES);
         ~ThreadPool();
-        ThreadPool::ERROR_TYPE scheduleById(std::function<void()> fn, int32_t id = -1);
+        // node是操作系统中的NUMA node编号，-1表示不指定。未指定id时任务留在该node的worker上；
+        // 都不指定时留在提交线程所在的node
+        ThreadPool::ERROR_TYPE scheduleById(TaskFunc fn, int32_t id = -1, uint32_t priority = kDefaultPriority, int32_t node = -1);
+        // 恢复协程的快速路径，handle直接存放在WorkItem中
+        ThreadPool::ERROR_TYPE scheduleHandleById(std::coroutine_handle<> handle, int32_t id = -1, uint32_t priority = kDefaultPriority, int32_t node = -1);
+        // key相同的任务总是进入同一个worker的队列且不会被偷取，优先级相同时按提交顺序执行，
+        // 不需要为每个key加锁。没有key的任务仍然可以被偷取
+        ThreadPool::ERROR_TYPE scheduleByKey(uint64_t key, TaskFunc fn, uint32_t priority = kDefaultPriority);
+        ThreadPool::ERROR_TYPE scheduleHandleByKey(uint64_t key, std::coroutine_handle<> handle, uint32_t priority = kDefaultPriority);
+        // key对应的worker id，只由key和线程数决定
+        size_t getKeyWorker(uint64_t key) const;
+        // 批量提交，整批只加一次锁并统一唤醒worker。fns中有空任务时不提交任何任务。
+        // F可以是TaskFunc或者能转换为TaskFunc的类型，例如std::function<void()>
+        template <typename F>
+        ThreadPool::ERROR_TYPE scheduleBatch(std::span<F> fns, uint32_t priority = kDefaultPriority, int32_t node = -1);
+        ThreadPool::ERROR_TYPE scheduleHandleBatch(std::span<const std::coroutine_handle<>> handles, uint32_t priority = kDefaultPriority, int32_t node = -1);
+        // 当前worker的编号，临时worker和外部线程返回-1
         int32_t getCurrentId() const;
+        // 当前线程在线程池中的编号，包括临时worker，它们的编号从threadNum_开始；外部线程返回-1
+        int32_t getCurrentThreadId() const;
+        // 不加锁，返回的是近似值
         size_t getItemCount() const;
+        // 每个worker统计信息的快照，不加锁，可以在任意线程调用
+        std::vector<WorkerStat> getWorkerStats() const;
         int32_t getThreadNum() const
         {
             return threadNum_;
         }
+        // 包括正在运行的临时worker
+        size_t getActiveThreadNum() const
+        {
+            return threadNum_ + compensateNum_.load(std::memory_order_relaxed);
+        }
+        size_t getPeakThreadNum() const
+        {
+            return peakThreadNum_.load(std::memory_order_relaxed);
+        }
+        // 启动临时worker的次数
+        uint64_t getCompensateCount() const
+        {
+            return compensateCount_.load(std::memory_order_relaxed);
+        }
+        QUEUE_TYPE getQueueType() const
+        {
+            return queueType_;
+        }
+        PLACEMENT_TYPE getPlacementType() const
+        {
+            return placement_.type();
+        }
+        size_t getNodeNum() const
+        {
+            return nodeIds_.size();
+        }
+        // 返回worker所在的NUMA node编号
+        uint32_t getWorkerNode(size_t id) const
+        {
+            return nodeIds_[workerNode_[id]];
+        }
 
     private:
-        std::pair<size_t, ThreadPool *> *getCurrent() const;
+        // worker的空闲状态: RUNNING -> SPINNING -> PARKED -> NOTIFIED -> RUNNING
+        enum IDLE_STATE : uint32_t
+        {
+            RUNNING = 0,
+            SPINNING,
+            PARKED,
+            NOTIFIED,
+        };
+
+        struct alignas(kCacheLineSize) IdleState
+        {
+            std::atomic<uint32_t> state{RUNNING};
+            // 弹性模式下记录当前任务的开始时间，0表示没有在执行任务
+            std::atomic<uint64_t> busySince{0};
+            // BlockingScope的嵌套层数，只有worker自己修改
+            std::atomic<uint32_t> blocking{0};
+        };
+
+        // deque中存放的节点，执行完后回收到分配它的worker
+        struct ItemNode
+        {
+            WorkItem item;
+            ItemNode *next = nullptr;
+            size_t owner = 0;
+        };
+
+        // 每个worker缓存的空闲节点。local只有worker自己访问，超过kItemCacheSize时释放；
+        // 其它worker偷取后把节点压入remote栈，owner在local为空时一次取走全部
+        static constexpr size_t kItemCacheSize = 256;
+        struct alignas(kCacheLineSize) ItemCache
+        {
+            ItemNode *local = nullptr;
+            size_t localCount = 0;
+            alignas(kCacheLineSize) std::atomic<ItemNode *> remote{nullptr};
+        };
+
+        // 每个worker一个LIFO槽。worker内部提交的默认优先级任务先放入槽中，当前任务结束后
+        // 由同一个worker马上执行，数据还在cache中；槽中原有的任务被挤入队列。
+        // owner连续从槽中取kNextSlotLimit次后先检查一次队列，避免互相唤醒的任务饿死队列。
+        // 醒着的worker只偷取在槽中放了超过kNextSlotStealDelayNs的任务。放入槽中不会唤醒其它worker，
+        // owner要阻塞时由BlockingScope把槽中的任务移到可以偷取的队列并唤醒一个worker；弹性模式下
+        // monitor发现owner执行当前任务超过kNextSlotStealDelayNs时也会唤醒一个worker来偷取
+        static constexpr uint32_t kNextSlotLimit = 3;
+        static constexpr uint64_t kNextSlotStealDelayNs = 20000;
+        struct alignas(kCacheLineSize) NextSlot
+        {
+            std::atomic<ItemNode *> node{nullptr};
+            // 放入槽中的时间
+            std::atomic<uint64_t> since{0};
+            // 连续从槽中取任务的次数，只有owner访问
+            uint32_t runs = 0;
+        };
+
+        static std::pair<size_t, ThreadPool *> *getCurrent();
+        ThreadPool::ERROR_TYPE submit(WorkItem &&item, int32_t id, uint32_t priority, int32_t node);
+        template <typename Make>
+        ThreadPool::ERROR_TYPE submitBatch(size_t n, Make &&make, uint32_t priority, int32_t node);
+        void initTopology();
+        // 把操作系统的node编号转换为下标，node为-1或者未知时返回提交线程所在node的下标
+        uint32_t resolveNode(int32_t node) const;
+        // 按placement_在node的worker中选择一个，返回在nodeWorkers_[node]中的下标
+        size_t pickWorker(uint32_t node, int32_t current) const;
+        ItemNode *allocItem(size_t id, WorkItem &&item);
+        void freeItem(size_t id, ItemNode *node);
+        void pushNext(size_t id, WorkItem &&item, uint32_t node);
+        bool tryPopNext(size_t id, WorkItem &item, bool force);
+        bool tryStealNext(size_t id, WorkItem &item);
+        // owner把槽中的任务移到可以偷取的队列中并唤醒一个worker
+        void releaseNext(size_t id);
+        void run(size_t id);
+        bool tryGetWork(size_t id, WorkItem &item, uint32_t &tick);
+        bool tryGetMutexQueue(size_t id, WorkItem &item);
+        bool tryGetWorkStealing(size_t id, WorkItem &item, uint32_t &tick);
+        bool tryPopNormal(size_t id, WorkItem &item);
+        bool tryPopQueue(size_t id, WorkItem &item, uint32_t maxLevel = kPriorityLevels - 1);
+        void runItem(size_t id, WorkItem &item);
+        bool hasWork(size_t id);
+        bool idle(size_t id, WorkItem &item, uint32_t &tick);
+        void park(size_t id);
+        bool wakeWorker(size_t id);
+        void wakeOne();
+        void wakeMany(size_t n, int32_t node = -1);
+        void wakeAll();
+        bool elastic() const
+        {
+            return elasticPolicy_.maxCompensate != 0;
+        }
+        void notifyCompensator();
+        void monitor();
+        void compensate();
+        void runCompensator(size_t id);
+        bool tryGetShared(size_t id, WorkItem &item);
+
         int32_t threadNum_;
-        std::vector<Queue<WorkItem>> queues_;
+        // 按优先级分级的任务队列。
+        // WORK_STEALING_DEQUE模式下只存放指定了id的任务和非默认优先级的任务
+        std::vector<PriorityQueue<WorkItem, kPriorityLevels, kStarvationLimit>> queues_;
+        std::vector<std::unique_ptr<WorkStealingDeque<ItemNode *>>> deques_;
+        std::vector<std::unique_ptr<WorkerCounters>> counters_;
+        std::vector<std::unique_ptr<ItemCache>> itemCaches_;
+        std::vector<std::unique_ptr<NextSlot>> nextSlots_;
+        // 外部线程提交的任务，每个node一个
+        std::vector<std::unique_ptr<Queue<WorkItem>>> injectQueues_;
+        // NUMA拓扑，下面的node均指nodeIds_的下标
+        std::vector<uint32_t> nodeIds_;
+        std::vector<std::vector<size_t>> nodeWorkers_;
+        std::vector<uint32_t> workerNode_;
+        // 绑核时每个worker绑定的cpu
+        std::vector<int32_t> workerCpu_;
+        // cpu id -> node，-1表示不属于任何node
+        std::vector<int32_t> cpuNode_;
+        // 每个worker偷取的顺序，同一个node的worker在前
+        std::vector<std::vector<size_t>> stealOrder_;
         std::vector<std::thread> threads_;
         std::atomic<bool> stop_;
         bool enableWorkSteal_;
         bool enableCoreBindings_;
+        QUEUE_TYPE queueType_;
+        IdlePolicy idlePolicy_;
+        Placement placement_;
+
+        std::vector<std::unique_ptr<IdleState>> idleStates_;
+        std::atomic<int32_t> spinningNum_;
+        std::atomic<int32_t> parkedNum_;
+        // wakeOne从这里开始查找PARKED的worker，避免总是唤醒同一个
+        std::atomic<uint32_t> wakeCursor_;
+        // queues_中可以被偷取的任务数
+        std::atomic<int64_t> stealableNum_;
+
+        // 弹性模式。临时worker的id从threadNum_开始，counters_和stealOrder_中有它们的位置
+        ElasticPolicy elasticPolicy_;
+        std::thread monitor_;
+        std::mutex elasticMutex_;
+        std::condition_variable monitorCond_;
+        // 空闲的临时worker在这个字上等待，有新任务时加一并唤醒一个
+        std::atomic<uint32_t> compensateSeq_;
+        // 只有monitor_线程启动和回收临时worker
+        std::vector<std::thread> compensators_;
+        std::unique_ptr<std::atomic<bool>[]> compensateActive_;
+        std::atomic<int32_t> compensateNum_;
+        std::atomic<int32_t> idleCompensateNum_;
+        std::atomic<size_t> peakThreadNum_;
+        std::atomic<uint64_t> compensateCount_;
     };
+    // 自旋等待时降低功耗，并让出流水线给同核的超线程
+    inline void cpuRelax() noexcept
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield" ::: "memory");
+#endif
+    }
+
 #ifdef __linux__
     // 获取当前进程允许使用的cpu id
     inline void getCurrentCpus(std::vector<uint32_t> &ids)
@@ -65,113 +348,1016 @@ namespace async_framework::util
         }
     }
 #endif
-    inline ThreadPool::ThreadPool(size_t threadNum, bool enableWorkSteal, bool enableCoreBindings)
-        : threadNum_(threadNum), enableWorkSteal_(enableWorkSteal), enableCoreBindings_(enableCoreBindings),
-          queues_(threadNum_), stop_(false)
+    inline ThreadPool::ThreadPool(size_t threadNum, bool enableWorkSteal, bool enableCoreBindings, QUEUE_TYPE queueType, IdlePolicy idlePolicy,
+                                  ElasticPolicy elasticPolicy, PLACEMENT_TYPE placement)
+        : threadNum_(threadNum), queues_(threadNum_), stop_(false), enableWorkSteal_(enableWorkSteal),
+          enableCoreBindings_(enableCoreBindings), queueType_(queueType), idlePolicy_(idlePolicy), placement_(placement), spinningNum_(0), parkedNum_(0),
+          wakeCursor_(0), stealableNum_(0), elasticPolicy_(elasticPolicy), compensateSeq_(0), compensateNum_(0), idleCompensateNum_(0),
+          peakThreadNum_(threadNum_), compensateCount_(0)
     {
+        counters_.reserve(threadNum_ + elasticPolicy_.maxCompensate);
+        idleStates_.reserve(threadNum_);
+        itemCaches_.reserve(threadNum_);
+        nextSlots_.reserve(threadNum_);
+        for (auto i = 0; i < threadNum_; i++)
+        {
+            counters_.emplace_back(std::make_unique<WorkerCounters>());
+            idleStates_.emplace_back(std::make_unique<IdleState>());
+            itemCaches_.emplace_back(std::make_unique<ItemCache>());
+            nextSlots_.emplace_back(std::make_unique<NextSlot>());
+        }
+        for (uint32_t i = 0; i < elasticPolicy_.maxCompensate; i++)
+            counters_.emplace_back(std::make_unique<WorkerCounters>());
+        if (queueType_ == QUEUE_TYPE::WORK_STEALING_DEQUE)
+        {
+            deques_.reserve(threadNum_);
+            for (auto i = 0; i < threadNum_; i++)
+                deques_.emplace_back(std::make_unique<WorkStealingDeque<ItemNode *>>());
+        }
+
+        initTopology();
+
         auto worker = [this](size_t id)
         {
+#ifdef __linux__
+            // 在worker线程内绑核，之后worker分配的内存都在本node上
+            if (workerCpu_[id] >= 0)
+            {
+                cpu_set_t cpuset;
+                CPU_ZERO(&cpuset);
+                CPU_SET(workerCpu_[id], &cpuset);
+                int res = sched_setaffinity(0, sizeof(cpu_set_t), &cpuset);
+                if (res != 0)
+                    std::cerr << std::format("Error while calling sched_setaffinity: {}\n", res);
+            }
+#endif
             auto current = getCurrent();
             current->first = id;
             current->second = this;
-            while (true)
-            {
-                WorkItem workerItem{};
-                if (enableWorkSteal_)
-                {
-                    // 当前线程从其它任务队列偷取任务
-                    for (int i = 0; i < threadNum_ * 2; i++)
-                    {
-                        if (queues_[(i + id) % threadNum_].try_pop_if(workerItem, [](auto &&elem)
-                                                                      { return elem.canSteal }))
-                            break;
-                    }
-                }
-                if (!workerItem.fn && !queues_[id].pop(workerItem))
-                {
-                    if (stop_)
-                    {
-                        break;
-                    }
-                    else
-                    {
-                        continue;
-                    }
-                }
-                if (workerItem.fn)
-                    workerItem.fn();
-            }
+            run(id);
         };
         threads_.reserve(threadNum_);
-#ifdef __linux__
-        std::vector<uint32_t> cpu_ids;
-        // 获取当前进程可用的cpuids
-        if (enableCoreBindings_)
-            getCurrentCpus(cpu_ids);
-#else
-        (void)enableCoreBindings_;
-#endif
 
         // 启动threadNum_个线程
         for (auto i = 0; i < threadNum_; i++)
-        {
             threads_.emplace_back(worker, i);
+
+        if (elastic())
+        {
+            compensators_.resize(elasticPolicy_.maxCompensate);
+            compensateActive_ = std::make_unique<std::atomic<bool>[]>(elasticPolicy_.maxCompensate);
+            monitor_ = std::thread(&ThreadPool::monitor, this);
+        }
+    }
+
+    inline void ThreadPool::initTopology()
+    {
+        std::vector<NumaNode> nodes;
 #ifdef __linux__
-            if (!enableCoreBindings_)
-                continue;
-            cpu_set_t cpuset;
-            CPU_ZERO(&cpuset);
-            CPU_SET(cpu_ids[i % cpu_ids.size()], &cpuset);
-            int res = sched_setaffinity(threads_[i].native_handle(), sizeof(cpu_set_t), &cpuset);
-            if (res != 0)
-                std::cerr << std::format("Error while calling sched_setaffinity: {}\n", res);
+        if (enableCoreBindings_)
+        {
+            // 获取当前进程可用的cpuids
+            std::vector<uint32_t> cpuIds;
+            getCurrentCpus(cpuIds);
+            nodes = NumaTopology::detect(cpuIds).nodes();
+        }
 #endif
+        if (nodes.empty())
+            nodes.push_back(NumaNode{});
+        // 按node顺序把连续的worker分给各个node，node比worker多时丢弃多余的node
+        auto nodeNum = (std::min)(nodes.size(), static_cast<size_t>(threadNum_));
+        nodeIds_.resize(nodeNum);
+        nodeWorkers_.resize(nodeNum);
+        workerNode_.resize(threadNum_);
+        workerCpu_.assign(threadNum_, -1);
+        for (auto i = 0; i < threadNum_; i++)
+        {
+            auto node = i * nodeNum / threadNum_;
+            auto &cpus = nodes[node].cpus;
+            workerNode_[i] = node;
+            if (!cpus.empty())
+                workerCpu_[i] = cpus[nodeWorkers_[node].size() % cpus.size()];
+            nodeWorkers_[node].push_back(i);
+        }
+        for (size_t node = 0; node < nodeNum; node++)
+        {
+            nodeIds_[node] = nodes[node].id;
+            for (auto cpu : nodes[node].cpus)
+            {
+                if (cpu >= cpuNode_.size())
+                    cpuNode_.resize(cpu + 1, -1);
+                cpuNode_[cpu] = node;
+            }
+            injectQueues_.emplace_back(std::make_unique<Queue<WorkItem>>());
+        }
+        // 先偷同一个node的worker，再按node顺序偷其它node。临时worker依次偷所有worker
+        stealOrder_.resize(threadNum_ + elasticPolicy_.maxCompensate);
+        for (size_t i = threadNum_; i < stealOrder_.size(); i++)
+        {
+            for (auto victim = 0; victim < threadNum_; victim++)
+                stealOrder_[i].push_back(victim);
+        }
+        for (auto i = 0; i < threadNum_; i++)
+        {
+            for (size_t n = 0; n < nodeNum; n++)
+            {
+                auto &workers = nodeWorkers_[(workerNode_[i] + n) % nodeNum];
+                for (size_t k = 0; k < workers.size(); k++)
+                {
+                    auto victim = workers[(i + k) % workers.size()];
+                    if (victim != static_cast<size_t>(i))
+                        stealOrder_[i].push_back(victim);
+                }
+            }
+        }
+    }
+
+    inline uint32_t ThreadPool::resolveNode(int32_t node) const
+    {
+        if (nodeIds_.size() == 1)
+            return 0;
+        if (node >= 0)
+        {
+            for (size_t i = 0; i < nodeIds_.size(); i++)
+            {
+                if (nodeIds_[i] == static_cast<uint32_t>(node))
+                    return i;
+            }
+        }
+        auto current = getCurrentId();
+        if (current != -1)
+            return workerNode_[current];
+#ifdef __linux__
+        if (nodeIds_.size() > 1)
+        {
+            auto cpu = sched_getcpu();
+            if (cpu >= 0 && static_cast<size_t>(cpu) < cpuNode_.size() && cpuNode_[cpu] >= 0)
+                return cpuNode_[cpu];
         }
+#endif
+        return 0;
     }
 
-    ThreadPool::~ThreadPool()
+    inline size_t ThreadPool::pickWorker(uint32_t node, int32_t current) const
+    {
+        auto &workers = nodeWorkers_[node];
+        // 同一个node的worker编号是连续的
+        int32_t local = current != -1 && workerNode_[current] == node ? current - static_cast<int32_t>(workers.front()) : -1;
+        return placement_.pick(
+            workers, [this](size_t id)
+            { return queues_[id].approx_size() + (deques_.empty() ? 0 : deques_[id]->size()); },
+            local);
+    }
+
+    inline ThreadPool::~ThreadPool()
     {
         stop_ = true;
         for (auto &queue : queues_)
             queue.stop();
+        for (auto &queue : injectQueues_)
+            queue->stop();
+        wakeAll();
         for (auto &thread : threads_)
             thread.join();
+        if (monitor_.joinable())
+        {
+            {
+                std::scoped_lock lock(elasticMutex_);
+                monitorCond_.notify_all();
+            }
+            compensateSeq_.fetch_add(1, std::memory_order_release);
+            futexWakeAll(compensateSeq_);
+            monitor_.join();
+            for (auto &thread : compensators_)
+            {
+                if (thread.joinable())
+                    thread.join();
+            }
+        }
+        // 所有worker都已退出，此时可以安全地以owner身份清理deque
+        for (auto &deque : deques_)
+        {
+            ItemNode *node = nullptr;
+            while (deque->pop(node))
+                delete node;
+        }
+        for (auto &slot : nextSlots_)
+            delete slot->node.load(std::memory_order_acquire);
+        auto release = [](ItemNode *node)
+        {
+            while (node)
+                delete std::exchange(node, node->next);
+        };
+        for (auto &cache : itemCaches_)
+        {
+            release(cache->local);
+            release(cache->remote.load(std::memory_order_acquire));
+        }
     }
 
-    inline ThreadPool::ERROR_TYPE ThreadPool::scheduleById(std::function<void()> fn, int32_t id)
+    inline void ThreadPool::run(size_t id)
+    {
+        uint32_t tick = 0;
+        while (true)
+        {
+            WorkItem workerItem{};
+            if (tryGetWork(id, workerItem, tick) || idle(id, workerItem, tick))
+            {
+                runItem(id, workerItem);
+                continue;
+            }
+            // 先把能拿到的任务执行完再退出
+            if (stop_)
+                break;
+        }
+    }
+
+    inline bool ThreadPool::tryGetWork(size_t id, WorkItem &item, uint32_t &tick)
+    {
+        if (tryPopNext(id, item, false))
+            return true;
+        // 槽为空或者已经连续取了kNextSlotLimit次，先看队列，队列中没有任务时再取槽
+        nextSlots_[id]->runs = 0;
+        if (queueType_ == QUEUE_TYPE::WORK_STEALING_DEQUE ? tryGetWorkStealing(id, item, tick) : tryGetMutexQueue(id, item))
+            return true;
+        return tryPopNext(id, item, true);
+    }
+
+    inline bool ThreadPool::tryGetMutexQueue(size_t id, WorkItem &item)
+    {
+        if (!enableWorkSteal_)
+            return queues_[id].try_pop(item);
+        // 从自己的队列开始，按stealOrder_依次尝试从其它任务队列偷取任务
+        auto canSteal = [](auto &&elem)
+        {
+            return elem.canSteal;
+        };
+        for (int round = 0; round < 2; round++)
+        {
+            // 自己队列中不可偷取的任务(例如按key提交的任务)也由自己执行
+            if (queues_[id].try_pop(item))
+                return true;
+            for (auto victim : stealOrder_[id])
+            {
+                if (queues_[victim].try_pop_if(item, canSteal))
+                {
+                    counters_[id]->onSteal();
+                    return true;
+                }
+            }
+        }
+        return tryStealNext(id, item);
+    }
+
+    // 任务分为三类:
+    // HIGH: 本worker队列中优先级 <= kDefaultPriority的任务，包括指定到本worker的任务
+    // NORMAL: 本地deque(LIFO)和注入队列中的默认优先级任务
+    // LOW: 本worker队列中优先级 >= kYieldPriority的任务，例如Yield
+    // 正常按HIGH -> NORMAL -> LOW -> 偷取其它worker的顺序取任务，每kStarvationLimit次
+    // 先尝试一次LOW和NORMAL，避免它们被源源不断的高优先级任务饿死。
+    inline bool ThreadPool::tryGetWorkStealing(size_t id, WorkItem &item, uint32_t &tick)
+    {
+        if (++tick >= kStarvationLimit)
+        {
+            tick = 0;
+            if (queues_[id].try_pop_lowest(item))
+            {
+                if (item.canSteal)
+                    stealableNum_.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+            if (tryPopNormal(id, item))
+                return true;
+        }
+        if (tryPopQueue(id, item, kDefaultPriority) || tryPopNormal(id, item) || tryPopQueue(id, item))
+            return true;
+        ItemNode *stolen = nullptr;
+        for (auto victim : stealOrder_[id])
+        {
+            if (deques_[victim]->steal(stolen))
+            {
+                item = std::move(stolen->item);
+                freeItem(id, stolen);
+                counters_[id]->onSteal();
+                return true;
+            }
+        }
+        // 其它node的注入队列
+        for (size_t i = 1; i < injectQueues_.size(); i++)
+        {
+            if (injectQueues_[(workerNode_[id] + i) % injectQueues_.size()]->try_pop(item))
+            {
+                counters_[id]->onSteal();
+                return true;
+            }
+        }
+        if (stealableNum_.load(std::memory_order_relaxed) > 0)
+        {
+            for (auto victim : stealOrder_[id])
+            {
+                if (queues_[victim].try_pop_if(item, [](auto &&elem)
+                                               { return elem.canSteal; }))
+                {
+                    stealableNum_.fetch_sub(1, std::memory_order_relaxed);
+                    counters_[id]->onSteal();
+                    return true;
+                }
+            }
+        }
+        return tryStealNext(id, item);
+    }
+
+    inline bool ThreadPool::tryPopNormal(size_t id, WorkItem &item)
+    {
+        ItemNode *local = nullptr;
+        if (deques_[id]->pop(local))
+        {
+            item = std::move(local->item);
+            freeItem(id, local);
+            return true;
+        }
+        return injectQueues_[workerNode_[id]]->try_pop(item);
+    }
+
+    inline bool ThreadPool::tryPopQueue(size_t id, WorkItem &item, uint32_t maxLevel)
+    {
+        if (!queues_[id].try_pop(item, maxLevel))
+            return false;
+        if (item.canSteal)
+            stealableNum_.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    inline void ThreadPool::runItem(size_t id, WorkItem &item)
+    {
+        auto start = steadyNowNs();
+        auto track = elastic() && id < static_cast<size_t>(threadNum_);
+        if (track)
+            idleStates_[id]->busySince.store(start, std::memory_order_relaxed);
+        if (item.handle)
+            item.handle.resume();
+        else
+            item.fn();
+        if (track)
+            idleStates_[id]->busySince.store(0, std::memory_order_relaxed);
+        counters_[id]->onExecuted(item.enqueueNs, start, steadyNowNs());
+    }
+
+    // 不加锁，只读取近似大小，调用前需要有seq_cst fence与提交方配对
+    inline bool ThreadPool::hasWork(size_t id)
+    {
+        if (queues_[id].approx_size() != 0 || nextSlots_[id]->node.load(std::memory_order_relaxed))
+            return true;
+        if (queueType_ == QUEUE_TYPE::WORK_STEALING_DEQUE || enableWorkSteal_)
+        {
+            // 其它worker槽中放入不到kNextSlotStealDelayNs的任务还偷不到，不算作可做的工作，
+            // 否则只要有槽被占用，空闲的worker就一直无法park
+            uint64_t now = 0;
+            for (auto &slot : nextSlots_)
+            {
+                if (!slot->node.load(std::memory_order_relaxed))
+                    continue;
+                if (now == 0)
+                    now = steadyNowNs();
+                if (now >= slot->since.load(std::memory_order_relaxed) + kNextSlotStealDelayNs)
+                    return true;
+            }
+        }
+        if (queueType_ == QUEUE_TYPE::MUTEX_QUEUE)
+        {
+            if (!enableWorkSteal_)
+                return false;
+            for (auto &queue : queues_)
+            {
+                if (queue.approx_size() != 0)
+                    return true;
+            }
+            return false;
+        }
+        if (stealableNum_.load(std::memory_order_relaxed) > 0)
+            return true;
+        for (auto &queue : injectQueues_)
+        {
+            if (queue->approx_size() != 0)
+                return true;
+        }
+        for (auto &deque : deques_)
+        {
+            if (!deque->empty())
+                return true;
+        }
+        return false;
+    }
+
+    // 先自旋再yield，期间拿到任务返回true；否则park，被唤醒或需要重新检查时返回false
+    inline bool ThreadPool::idle(size_t id, WorkItem &item, uint32_t &tick)
+    {
+        auto &state = idleStates_[id]->state;
+        auto rounds = idlePolicy_.spinCount + idlePolicy_.yieldCount;
+        if (rounds != 0 && !stop_ && spinningNum_.load(std::memory_order_relaxed) * 2 < threadNum_)
+        {
+            state.store(SPINNING, std::memory_order_seq_cst);
+            spinningNum_.fetch_add(1, std::memory_order_seq_cst);
+            bool found = false;
+            for (uint32_t i = 0; i < rounds && !stop_; i++)
+            {
+                if (i < idlePolicy_.spinCount)
+                    cpuRelax();
+                else
+                    std::this_thread::yield();
+                if (tryGetWork(id, item, tick))
+                {
+                    found = true;
+                    break;
+                }
+            }
+            state.store(RUNNING, std::memory_order_seq_cst);
+            // 提交方看到有worker在自旋时不会唤醒其它worker。最后一个自旋的worker拿到任务后
+            // 如果还有剩余任务，需要代替提交方唤醒一个worker
+            if (spinningNum_.fetch_sub(1, std::memory_order_seq_cst) == 1 && found)
+            {
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (hasWork(id))
+                    wakeOne();
+            }
+            if (found)
+                return true;
+        }
+        park(id);
+        return false;
+    }
+
+    inline void ThreadPool::park(size_t id)
+    {
+        auto &state = idleStates_[id]->state;
+        state.store(PARKED, std::memory_order_seq_cst);
+        parkedNum_.fetch_add(1, std::memory_order_seq_cst);
+        // 与wakeWorker/wakeOne中的fence配对：要么这里看到新任务，要么提交方看到PARKED
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!stop_ && !hasWork(id))
+        {
+            while (state.load(std::memory_order_acquire) == PARKED)
+                futexWait(state, uint32_t(PARKED));
+        }
+        state.store(RUNNING, std::memory_order_relaxed);
+        parkedNum_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // 唤醒指定的worker。返回false表示该worker正在执行任务，不会马上处理新任务
+    inline bool ThreadPool::wakeWorker(size_t id)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto &state = idleStates_[id]->state;
+        uint32_t expected = state.load(std::memory_order_relaxed);
+        if (expected == PARKED && state.compare_exchange_strong(expected, NOTIFIED))
+        {
+            futexWakeAll(state);
+            return true;
+        }
+        if (expected == RUNNING)
+        {
+            // 该worker可能被阻塞
+            notifyCompensator();
+            return false;
+        }
+        return true;
+    }
+
+    inline void ThreadPool::wakeOne()
+    {
+        wakeMany(1);
+    }
+
+    // 唤醒n个PARKED的worker，正在自旋的worker可以直接处理新任务，不需要唤醒。
+    // node不为-1时先唤醒该node(下标)的worker
+    inline void ThreadPool::wakeMany(size_t n, int32_t node)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        notifyCompensator();
+        auto spinning = static_cast<size_t>(spinningNum_.load(std::memory_order_relaxed));
+        if (n <= spinning || parkedNum_.load(std::memory_order_relaxed) == 0)
+            return;
+        n -= spinning;
+        auto start = wakeCursor_.fetch_add(1, std::memory_order_relaxed);
+        auto tryWake = [&](size_t id)
+        {
+            auto &state = idleStates_[id]->state;
+            uint32_t expected = PARKED;
+            if (state.load(std::memory_order_relaxed) == PARKED && state.compare_exchange_strong(expected, NOTIFIED))
+            {
+                futexWakeAll(state);
+                n--;
+            }
+        };
+        if (node != -1 && nodeWorkers_.size() > 1)
+        {
+            auto &workers = nodeWorkers_[node];
+            for (size_t i = 0; i < workers.size() && n > 0; i++)
+                tryWake(workers[(start + i) % workers.size()]);
+        }
+        for (auto i = 0; i < threadNum_ && n > 0; i++)
+            tryWake((start + i) % threadNum_);
+    }
+
+    inline void ThreadPool::wakeAll()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for (auto &idleState : idleStates_)
+        {
+            uint32_t expected = PARKED;
+            if (idleState->state.compare_exchange_strong(expected, NOTIFIED))
+                futexWakeAll(idleState->state);
+        }
+    }
+
+    // 调用前需要有seq_cst fence，与runCompensator中的fence配对
+    inline void ThreadPool::notifyCompensator()
+    {
+        if (idleCompensateNum_.load(std::memory_order_relaxed) > 0)
+        {
+            compensateSeq_.fetch_add(1, std::memory_order_release);
+            futexWakeOne(compensateSeq_);
+        }
+    }
+
+    inline void ThreadPool::monitor()
+    {
+        auto interval = (std::max)(std::chrono::duration_cast<std::chrono::microseconds>(elasticPolicy_.blockedThreshold / 4),
+                                   std::chrono::microseconds(1000));
+        std::unique_lock lock(elasticMutex_);
+        while (!stop_)
+        {
+            monitorCond_.wait_for(lock, interval);
+            if (stop_)
+                break;
+            lock.unlock();
+            compensate();
+            lock.lock();
+        }
+    }
+
+    // 统计被阻塞的worker，有任务在排队时补足同样数量的临时worker
+    inline void ThreadPool::compensate()
+    {
+        auto now = steadyNowNs();
+        auto threshold = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elasticPolicy_.blockedThreshold).count());
+        int32_t blocked = 0;
+        size_t stalledNext = 0;
+        for (auto i = 0; i < threadNum_; i++)
+        {
+            auto &idleState = *idleStates_[i];
+            auto since = idleState.busySince.load(std::memory_order_relaxed);
+            if (idleState.blocking.load(std::memory_order_relaxed) != 0 || (since != 0 && now > since + threshold))
+                blocked++;
+            // owner还在执行放入槽之前开始的任务，槽中的任务已经可以偷取，但空闲的worker不会自己醒来
+            auto &slot = *nextSlots_[i];
+            if (since != 0 && slot.node.load(std::memory_order_relaxed) && now >= slot.since.load(std::memory_order_relaxed) + kNextSlotStealDelayNs)
+                stalledNext++;
+        }
+        if (stalledNext > 0)
+            wakeMany(stalledNext);
+        auto target = (std::min)(blocked, static_cast<int32_t>(elasticPolicy_.maxCompensate));
+        if (compensateNum_.load(std::memory_order_relaxed) >= target || getItemCount() == 0)
+            return;
+        for (uint32_t i = 0; i < elasticPolicy_.maxCompensate && compensateNum_.load(std::memory_order_relaxed) < target && !stop_; i++)
+        {
+            if (compensateActive_[i].load(std::memory_order_acquire))
+                continue;
+            // 该位置上一个临时worker已经退出
+            if (compensators_[i].joinable())
+                compensators_[i].join();
+            compensateActive_[i].store(true, std::memory_order_relaxed);
+            auto num = compensateNum_.fetch_add(1, std::memory_order_relaxed) + 1;
+            compensateCount_.fetch_add(1, std::memory_order_relaxed);
+            auto total = static_cast<size_t>(threadNum_ + num);
+            if (total > peakThreadNum_.load(std::memory_order_relaxed))
+                peakThreadNum_.store(total, std::memory_order_relaxed);
+            compensators_[i] = std::thread(&ThreadPool::runCompensator, this, threadNum_ + i);
+        }
+    }
+
+    inline void ThreadPool::runCompensator(size_t id)
+    {
+        auto current = getCurrent();
+        current->first = id;
+        current->second = this;
+        auto keepAlive = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elasticPolicy_.keepAlive).count());
+        auto lastWork = steadyNowNs();
+        while (true)
+        {
+            WorkItem item{};
+            if (tryGetShared(id, item))
+            {
+                runItem(id, item);
+                lastWork = steadyNowNs();
+                continue;
+            }
+            if (stop_ || steadyNowNs() - lastWork >= keepAlive)
+                break;
+            auto seq = compensateSeq_.load(std::memory_order_acquire);
+            idleCompensateNum_.fetch_add(1, std::memory_order_seq_cst);
+            // 与提交方的fence配对：要么这里看到新任务，要么提交方看到空闲的临时worker并修改compensateSeq_
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto found = tryGetShared(id, item);
+            if (!found && !stop_)
+            {
+                auto deadline = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(lastWork + keepAlive));
+                futexWait(compensateSeq_, seq, &deadline);
+            }
+            idleCompensateNum_.fetch_sub(1, std::memory_order_relaxed);
+            if (found)
+            {
+                runItem(id, item);
+                lastWork = steadyNowNs();
+            }
+        }
+        compensateNum_.fetch_sub(1, std::memory_order_relaxed);
+        compensateActive_[id - threadNum_].store(false, std::memory_order_release);
+    }
+
+    // 临时worker没有自己的队列，只从注入队列、各worker的deque、LIFO槽和队列中取可以偷取的任务
+    inline bool ThreadPool::tryGetShared(size_t id, WorkItem &item)
+    {
+        for (auto &queue : injectQueues_)
+        {
+            if (queue->try_pop(item))
+                return true;
+        }
+        for (auto victim : stealOrder_[id])
+        {
+            ItemNode *stolen = nullptr;
+            if (!deques_.empty() && deques_[victim]->steal(stolen))
+            {
+                item = std::move(stolen->item);
+                freeItem(id, stolen);
+                counters_[id]->onSteal();
+                return true;
+            }
+            if (queues_[victim].try_pop_if(item, [](auto &&elem)
+                                           { return elem.canSteal; }))
+            {
+                if (queueType_ == QUEUE_TYPE::WORK_STEALING_DEQUE)
+                    stealableNum_.fetch_sub(1, std::memory_order_relaxed);
+                counters_[id]->onSteal();
+                return true;
+            }
+        }
+        return tryStealNext(id, item);
+    }
+
+    inline ThreadPool::BlockingScope::BlockingScope()
+    {
+        auto current = getCurrent();
+        auto pool = current->second;
+        if (!pool || current->first >= static_cast<size_t>(pool->threadNum_))
+            return;
+        // 阻塞期间槽中的任务交给其它worker执行
+        pool->releaseNext(current->first);
+        if (!pool->elastic())
+            return;
+        pool_ = pool;
+        id_ = current->first;
+        auto &blocking = pool_->idleStates_[id_]->blocking;
+        if (blocking.fetch_add(1, std::memory_order_relaxed) == 0)
+            pool_->monitorCond_.notify_one();
+    }
+
+    inline ThreadPool::BlockingScope::~BlockingScope()
+    {
+        if (pool_)
+            pool_->idleStates_[id_]->blocking.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    inline ThreadPool::ERROR_TYPE ThreadPool::scheduleById(TaskFunc fn, int32_t id, uint32_t priority, int32_t node)
     {
-        using ERROR_TYPE = ThreadPool::ERROR_TYPE;
         if (fn == nullptr)
         {
             return ERROR_TYPE::ERROR_POOL_ITEM_IS_NULL;
         }
+        return submit(WorkItem{true, std::move(fn), steadyNowNs()}, id, priority, node);
+    }
+
+    inline ThreadPool::ERROR_TYPE ThreadPool::scheduleHandleById(std::coroutine_handle<> handle, int32_t id, uint32_t priority, int32_t node)
+    {
+        if (!handle)
+        {
+            return ERROR_TYPE::ERROR_POOL_ITEM_IS_NULL;
+        }
+        return submit(WorkItem{true, nullptr, steadyNowNs(), handle}, id, priority, node);
+    }
+
+    inline ThreadPool::ERROR_TYPE ThreadPool::scheduleByKey(uint64_t key, TaskFunc fn, uint32_t priority)
+    {
+        if (fn == nullptr)
+        {
+            return ERROR_TYPE::ERROR_POOL_ITEM_IS_NULL;
+        }
+        return submit(WorkItem{false, std::move(fn), steadyNowNs()}, static_cast<int32_t>(getKeyWorker(key)), priority, -1);
+    }
+
+    inline ThreadPool::ERROR_TYPE ThreadPool::scheduleHandleByKey(uint64_t key, std::coroutine_handle<> handle, uint32_t priority)
+    {
+        if (!handle)
+        {
+            return ERROR_TYPE::ERROR_POOL_ITEM_IS_NULL;
+        }
+        return submit(WorkItem{false, nullptr, steadyNowNs(), handle}, static_cast<int32_t>(getKeyWorker(key)), priority, -1);
+    }
+
+    inline size_t ThreadPool::getKeyWorker(uint64_t key) const
+    {
+        // splitmix64的混合函数，连续的key(例如自增的session id)也能均匀分布
+        key ^= key >> 30;
+        key *= 0xBF58476D1CE4E5B9ull;
+        key ^= key >> 27;
+        key *= 0x94D049BB133111EBull;
+        key ^= key >> 31;
+        return key % threadNum_;
+    }
+
+    inline ThreadPool::ERROR_TYPE ThreadPool::submit(WorkItem &&item, int32_t id, uint32_t priority, int32_t node)
+    {
+        using ERROR_TYPE = ThreadPool::ERROR_TYPE;
         if (stop_)
         {
             return ERROR_TYPE::ERROR_POOL_HAS_STOP;
         }
-        WorkItem workerItem{true, fn};
+        if (queueType_ == QUEUE_TYPE::WORK_STEALING_DEQUE)
+        {
+            if (id != -1)
+            {
+                assert(id < threadNum_);
+                item.canSteal = false;
+                queues_[id].push(std::move(item), priority);
+                // 只有编号为id的worker能处理该任务
+                wakeWorker(id);
+                return ERROR_TYPE::ERROR_NONE;
+            }
+            auto target = resolveNode(node);
+            auto current = getCurrentId();
+            // 当前worker属于目标node时任务留在本地
+            auto local = current != -1 && workerNode_[current] == target;
+            if (priority != kDefaultPriority)
+            {
+                // 非默认优先级的任务放入分级队列，其它worker空闲时可以偷取
+                stealableNum_.fetch_add(1, std::memory_order_relaxed);
+                queues_[local ? current : nodeWorkers_[target][pickWorker(target, -1)]].push(std::move(item), priority);
+            }
+            else if (local)
+            {
+                pushNext(current, std::move(item), target);
+                return ERROR_TYPE::ERROR_NONE;
+            }
+            else
+                injectQueues_[target]->push(std::move(item));
+            wakeMany(1, target);
+            return ERROR_TYPE::ERROR_NONE;
+        }
         if (id == -1)
         {
+            auto target = resolveNode(node);
+            auto current = getCurrentId();
+            // 不能偷取时槽中的任务只有owner能执行，owner阻塞等待这个任务就会死锁，因此不使用槽
+            if (enableWorkSteal_ && priority == kDefaultPriority && current != -1 && workerNode_[current] == target)
+            {
+                pushNext(current, std::move(item), target);
+                return ERROR_TYPE::ERROR_NONE;
+            }
+            auto &workers = nodeWorkers_[target];
+            auto start = pickWorker(target, current);
             if (enableWorkSteal_)
             {
-                for (int i = 0; i < threadNum_ * 2; i++)
+                // 从选中的队列开始，跳过被其它线程锁住的队列
+                for (size_t i = 0; i < workers.size() * 2; i++)
                 {
-                    if (queues_[i % threadNum_].try_push(workerItem))
+                    auto target = workers[(start + i) % workers.size()];
+                    if (queues_[target].try_push(std::move(item), priority))
+                    {
+                        // 任务可以被任意worker偷取
+                        if (!wakeWorker(target))
+                            wakeOne();
                         return ERROR_TYPE::ERROR_NONE;
+                    }
                 }
             }
-            id = std::rand() % threadNum_;
-            queues_[id].push(std::move(workerItem));
+            id = workers[start];
+            queues_[id].push(std::move(item), priority);
+            if (!wakeWorker(id) && enableWorkSteal_)
+                wakeOne();
         }
         else
         {
             assert(id < threadNum_);
-            queues_[id].push(std::move(workerItem));
+            queues_[id].push(std::move(item), priority);
+            if (!wakeWorker(id) && enableWorkSteal_)
+                wakeOne();
+        }
+        return ERROR_TYPE::ERROR_NONE;
+    }
+
+    template <typename F>
+    inline ThreadPool::ERROR_TYPE ThreadPool::scheduleBatch(std::span<F> fns, uint32_t priority, int32_t node)
+    {
+        for (auto &fn : fns)
+        {
+            if (fn == nullptr)
+                return ERROR_TYPE::ERROR_POOL_ITEM_IS_NULL;
+        }
+        auto now = steadyNowNs();
+        return submitBatch(
+            fns.size(), [&](size_t i)
+            { return WorkItem{true, TaskFunc(std::move(fns[i])), now}; },
+            priority, node);
+    }
+
+    inline ThreadPool::ERROR_TYPE ThreadPool::scheduleHandleBatch(std::span<const std::coroutine_handle<>> handles, uint32_t priority, int32_t node)
+    {
+        for (auto handle : handles)
+        {
+            if (!handle)
+                return ERROR_TYPE::ERROR_POOL_ITEM_IS_NULL;
+        }
+        auto now = steadyNowNs();
+        return submitBatch(
+            handles.size(), [&](size_t i)
+            { return WorkItem{true, nullptr, now, handles[i]}; },
+            priority, node);
+    }
+
+    // WORK_STEALING_DEQUE模式下整批放入一个队列，由空闲worker偷取；
+    // MUTEX_QUEUE模式下分成连续的若干段分给目标node的worker，每段加一次锁
+    template <typename Make>
+    inline ThreadPool::ERROR_TYPE ThreadPool::submitBatch(size_t n, Make &&make, uint32_t priority, int32_t node)
+    {
+        if (stop_)
+        {
+            return ERROR_TYPE::ERROR_POOL_HAS_STOP;
+        }
+        if (n == 0)
+        {
+            return ERROR_TYPE::ERROR_NONE;
+        }
+        auto target = resolveNode(node);
+        if (queueType_ == QUEUE_TYPE::WORK_STEALING_DEQUE)
+        {
+            auto current = getCurrentId();
+            auto local = current != -1 && workerNode_[current] == target;
+            if (priority != kDefaultPriority)
+            {
+                stealableNum_.fetch_add(n, std::memory_order_relaxed);
+                queues_[local ? current : nodeWorkers_[target][pickWorker(target, -1)]].push_batch(n, make, priority);
+            }
+            else if (local)
+            {
+                for (size_t i = 0; i < n; i++)
+                    deques_[current]->push(allocItem(current, make(i)));
+            }
+            else
+                injectQueues_[target]->push_batch(n, make);
+            wakeMany(n, target);
+            return ERROR_TYPE::ERROR_NONE;
+        }
+        auto &workers = nodeWorkers_[target];
+        auto parts = (std::min)(n, workers.size());
+        auto start = pickWorker(target, getCurrentId());
+        for (size_t part = 0; part < parts; part++)
+        {
+            auto begin = n * part / parts;
+            auto end = n * (part + 1) / parts;
+            queues_[workers[(start + part) % workers.size()]].push_batch(
+                end - begin, [&](size_t i)
+                { return make(begin + i); },
+                priority);
         }
+        size_t busy = 0;
+        for (size_t part = 0; part < parts; part++)
+        {
+            if (!wakeWorker(workers[(start + part) % workers.size()]))
+                busy++;
+        }
+        if (busy > 0 && enableWorkSteal_)
+            wakeMany(busy);
         return ERROR_TYPE::ERROR_NONE;
     }
 
-    std::pair<size_t, ThreadPool *> *ThreadPool::getCurrent() const
+    inline void ThreadPool::pushNext(size_t id, WorkItem &&item, uint32_t node)
+    {
+        auto &slot = *nextSlots_[id];
+        slot.since.store(item.enqueueNs, std::memory_order_relaxed);
+        auto old = slot.node.exchange(allocItem(id, std::move(item)), std::memory_order_acq_rel);
+        // 槽中的任务由owner在当前任务结束后执行，其它worker在kNextSlotStealDelayNs内也偷不到，
+        // 唤醒它们只是白白多一次系统调用。只有原来的任务被挤入可偷取的队列时才唤醒
+        if (!old)
+            return;
+        if (queueType_ == QUEUE_TYPE::WORK_STEALING_DEQUE)
+            deques_[id]->push(old);
+        else
+        {
+            queues_[id].push(std::move(old->item), kDefaultPriority);
+            freeItem(id, old);
+        }
+        wakeMany(1, node);
+    }
+
+    inline bool ThreadPool::tryPopNext(size_t id, WorkItem &item, bool force)
+    {
+        auto &slot = *nextSlots_[id];
+        if ((!force && slot.runs >= kNextSlotLimit) || !slot.node.load(std::memory_order_relaxed))
+            return false;
+        auto node = slot.node.exchange(nullptr, std::memory_order_acquire);
+        if (!node)
+            return false;
+        item = std::move(node->item);
+        freeItem(id, node);
+        slot.runs++;
+        return true;
+    }
+
+    inline bool ThreadPool::tryStealNext(size_t id, WorkItem &item)
+    {
+        uint64_t now = 0;
+        for (auto victim : stealOrder_[id])
+        {
+            auto &slot = *nextSlots_[victim];
+            if (!slot.node.load(std::memory_order_relaxed))
+                continue;
+            if (now == 0)
+                now = steadyNowNs();
+            if (now < slot.since.load(std::memory_order_relaxed) + kNextSlotStealDelayNs)
+                continue;
+            auto node = slot.node.exchange(nullptr, std::memory_order_acquire);
+            if (!node)
+                continue;
+            item = std::move(node->item);
+            freeItem(id, node);
+            counters_[id]->onSteal();
+            return true;
+        }
+        return false;
+    }
+
+    inline void ThreadPool::releaseNext(size_t id)
+    {
+        auto &slot = *nextSlots_[id];
+        if (!slot.node.load(std::memory_order_relaxed))
+            return;
+        auto node = slot.node.exchange(nullptr, std::memory_order_acquire);
+        if (!node)
+            return;
+        if (queueType_ == QUEUE_TYPE::WORK_STEALING_DEQUE)
+            deques_[id]->push(node);
+        else
+        {
+            queues_[id].push(std::move(node->item), kDefaultPriority);
+            freeItem(id, node);
+        }
+        wakeMany(1, workerNode_[id]);
+    }
+
+    inline ThreadPool::ItemNode *ThreadPool::allocItem(size_t id, WorkItem &&item)
+    {
+        auto &cache = *itemCaches_[id];
+        if (!cache.local)
+        {
+            cache.local = cache.remote.exchange(nullptr, std::memory_order_acquire);
+            cache.localCount = 0;
+            for (auto node = cache.local; node; node = node->next)
+                cache.localCount++;
+        }
+        if (!cache.local)
+            return new ItemNode{std::move(item), nullptr, id};
+        auto node = cache.local;
+        cache.local = node->next;
+        cache.localCount--;
+        node->item = std::move(item);
+        node->next = nullptr;
+        return node;
+    }
+
+    // 由执行该节点的worker调用，移出后item.fn已经为空
+    inline void ThreadPool::freeItem(size_t id, ItemNode *node)
+    {
+        node->item.handle = nullptr;
+        if (node->owner != id)
+        {
+            auto &remote = itemCaches_[node->owner]->remote;
+            node->next = remote.load(std::memory_order_relaxed);
+            while (!remote.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed))
+                ;
+            return;
+        }
+        auto &cache = *itemCaches_[id];
+        if (cache.localCount >= kItemCacheSize)
+        {
+            delete node;
+            return;
+        }
+        node->next = cache.local;
+        cache.local = node;
+        cache.localCount++;
+    }
+
+    inline std::pair<size_t, ThreadPool *> *ThreadPool::getCurrent()
     {
         static thread_local std::pair<size_t, ThreadPool *> current(-1, nullptr);
         return &current;
@@ -179,17 +1365,65 @@ namespace async_framework::util
 
     inline int32_t ThreadPool::getCurrentId() const {
         auto current = getCurrent();
-        if(this==current->second){
+        // 临时worker按外部线程处理，它提交的任务不会留在本地
+        if(this==current->second && current->first < static_cast<size_t>(threadNum_)){
             return current->first;
         }
         return -1;
     }
 
+    inline int32_t ThreadPool::getCurrentThreadId() const
+    {
+        auto current = getCurrent();
+        if (this == current->second)
+            return static_cast<int32_t>(current->first);
+        return -1;
+    }
+
     inline size_t ThreadPool::getItemCount() const {
         size_t res = 0;
         for(auto& queue : queues_){
-            res += queue.size();
+            res += queue.approx_size();
         }
+        for(auto& deque : deques_){
+            res += deque->size();
+        }
+        for (auto &queue : injectQueues_)
+            res += queue->approx_size();
+        for (auto &slot : nextSlots_)
+            res += slot->node.load(std::memory_order_relaxed) != nullptr;
         return res;
     }
-}
\ No newline at end of file
+
+    inline std::vector<WorkerStat> ThreadPool::getWorkerStats() const
+    {
+        std::vector<WorkerStat> stats(threadNum_);
+        stats.reserve(counters_.size());
+        for (auto i = 0; i < threadNum_; i++)
+        {
+            auto &stat = stats[i];
+            auto &counters = *counters_[i];
+            stat.id = i;
+            stat.node = getWorkerNode(i);
+            // 注入队列中的任务不属于任何worker，只计入ExecutorStat::pendingTaskCount
+            stat.pendingTaskCount = queues_[i].approx_size() + (deques_.empty() ? 0 : deques_[i]->size()) +
+                                    (nextSlots_[i]->node.load(std::memory_order_relaxed) != nullptr);
+            stat.executedTaskCount = counters.executed.load(std::memory_order_relaxed);
+            stat.stealCount = counters.stolen.load(std::memory_order_relaxed);
+            stat.queueLatency = counters.queueLatency.snapshot();
+            stat.runTime = counters.runTime.snapshot();
+        }
+        // 临时worker没有队列，只统计执行和偷取的任务
+        for (size_t i = threadNum_; i < counters_.size(); i++)
+        {
+            auto &stat = stats.emplace_back();
+            auto &counters = *counters_[i];
+            stat.id = i;
+            stat.executedTaskCount = counters.executed.load(std::memory_order_relaxed);
+            stat.stealCount = counters.stolen.load(std::memory_order_relaxed);
+            stat.queueLatency = counters.queueLatency.snapshot();
+            stat.runTime = counters.runTime.snapshot();
+        }
+        return stats;
+    }
+}
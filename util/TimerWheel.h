@@ -0,0 +1,374 @@
+/* A hashed hierarchical timing wheel
+*/
+
+#ifndef ASYNC_FRAMEWORK_TIMER_WHEEL_H
+#define ASYNC_FRAMEWORK_TIMER_WHEEL_H
+
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace async_framework::util
+{
+    // TimerWheel keeps timers in a hashed hierarchical timing wheel (the same
+    // layout as the classic Linux kernel timer base) and fires them from one
+    // timer thread. Adding and cancelling a timer is O(1); a timer costs one
+    // TimerNode, which is recycled through a free list.
+    //
+    // Level 0 has 256 slots of one tick each, levels 1-3 have 64 slots each
+    // covering 2^8, 2^14 and 2^20 ticks per slot. Timers further away than the
+    // top level are parked in the last slot and cascaded again.
+    //
+    // The timer thread sleeps until the next tick that fires a timer or
+    // cascades a non-empty slot, and skips the empty ticks in between, so a
+    // wheel holding only far-away timers does not wake up every tick.
+    //
+    // Callbacks run on the timer thread and should be short, e.g. schedule
+    // the real work into an executor.
+    class TimerWheel
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Duration = std::chrono::microseconds;
+        using Func = std::function<void()>;
+
+    private:
+        struct TimerNode
+        {
+            TimerNode *prev = nullptr;
+            TimerNode *next = nullptr;
+            uint64_t expire = 0;
+            // 每次回收加一，用于判断TimerHandle是否过期
+            uint64_t seq = 0;
+            Func fn = nullptr;
+        };
+
+        // 侵入式双向链表的哨兵节点
+        struct Slot
+        {
+            Slot() { head.prev = head.next = &head; }
+            Slot(const Slot &) = delete;
+            Slot &operator=(const Slot &) = delete;
+
+            bool empty() const { return head.next == &head; }
+            TimerNode head;
+        };
+
+        static constexpr int kRootBits = 8;
+        static constexpr int kLevelBits = 6;
+        static constexpr uint64_t kRootSize = 1 << kRootBits;
+        static constexpr uint64_t kLevelSize = 1 << kLevelBits;
+        static constexpr uint64_t kRootMask = kRootSize - 1;
+        static constexpr uint64_t kLevelMask = kLevelSize - 1;
+        static constexpr int kLevels = 3;
+        static constexpr uint64_t kMaxDelta = (uint64_t(1) << (kRootBits + kLevels * kLevelBits)) - 1;
+
+    public:
+        // Identify a timer returned by add(). A handle becomes stale once the
+        // timer fired or was cancelled.
+        struct TimerHandle
+        {
+            TimerNode *node = nullptr;
+            uint64_t seq = 0;
+        };
+
+        explicit TimerWheel(Duration tick = std::chrono::milliseconds(1))
+            : tick_(tick), start_(Clock::now()), currentTick_(0), count_(0), freeList_(nullptr), stop_(false)
+        {
+            assert(tick_.count() > 0);
+            thread_ = std::thread([this]()
+                                  { this->loop(); });
+        }
+
+        ~TimerWheel()
+        {
+            {
+                std::scoped_lock lock(mutex_);
+                stop_ = true;
+            }
+            cond_.notify_one();
+            if (thread_.joinable())
+                thread_.join();
+            // 未触发的timer直接丢弃
+            auto release = [](Slot &slot)
+            {
+                while (!slot.empty())
+                {
+                    auto node = slot.head.next;
+                    unlink(node);
+                    delete node;
+                }
+            };
+            for (auto &slot : root_)
+                release(slot);
+            for (auto &level : levels_)
+                for (auto &slot : level)
+                    release(slot);
+            while (freeList_)
+            {
+                auto node = freeList_;
+                freeList_ = node->next;
+                delete node;
+            }
+        }
+
+        TimerWheel(const TimerWheel &) = delete;
+        TimerWheel &operator=(const TimerWheel &) = delete;
+
+    public:
+        // Run fn on the timer thread after at least delay.
+        TimerHandle add(Func fn, Duration delay)
+        {
+            auto now = Clock::now();
+            TimerHandle handle;
+            {
+                std::scoped_lock lock(mutex_);
+                if (count_ == 0)
+                {
+                    // 没有timer时可以直接把时间轮拨到当前时刻，避免timer线程追赶空转的tick
+                    currentTick_ = toTick(now);
+                }
+                auto node = allocNode();
+                node->fn = std::move(fn);
+                // 向上取整，保证至少等待delay
+                node->expire = toTick(now + delay + tick_ - Duration(1));
+                if (node->expire <= currentTick_)
+                    node->expire = currentTick_;
+                addNode(node);
+                ++count_;
+                handle = TimerHandle{node, node->seq};
+            }
+            cond_.notify_one();
+            return handle;
+        }
+
+        // Return false if the timer has already fired or been cancelled.
+        bool cancel(const TimerHandle &handle)
+        {
+            if (!handle.node)
+                return false;
+            Func fn;
+            {
+                std::scoped_lock lock(mutex_);
+                auto node = handle.node;
+                if (node->seq != handle.seq || !node->next)
+                    return false;
+                unlink(node);
+                --count_;
+                // 在锁外析构fn
+                fn = std::move(node->fn);
+                freeNode(node);
+            }
+            return true;
+        }
+
+        size_t size() const
+        {
+            std::scoped_lock lock(mutex_);
+            return count_;
+        }
+
+    private:
+        uint64_t toTick(Clock::time_point tp) const
+        {
+            return std::chrono::duration_cast<Duration>(tp - start_).count() / tick_.count();
+        }
+
+        static void unlink(TimerNode *node)
+        {
+            node->prev->next = node->next;
+            node->next->prev = node->prev;
+            node->prev = node->next = nullptr;
+        }
+
+        static void append(Slot &slot, TimerNode *node)
+        {
+            node->prev = slot.head.prev;
+            node->next = &slot.head;
+            slot.head.prev->next = node;
+            slot.head.prev = node;
+        }
+
+        TimerNode *allocNode()
+        {
+            if (!freeList_)
+                return new TimerNode();
+            auto node = freeList_;
+            freeList_ = node->next;
+            node->next = nullptr;
+            return node;
+        }
+
+        void freeNode(TimerNode *node)
+        {
+            node->fn = nullptr;
+            ++node->seq;
+            node->prev = nullptr;
+            node->next = freeList_;
+            freeList_ = node;
+        }
+
+        void addNode(TimerNode *node)
+        {
+            auto expire = node->expire;
+            auto delta = expire - currentTick_;
+            if (expire < currentTick_)
+            {
+                append(root_[currentTick_ & kRootMask], node);
+                return;
+            }
+            if (delta < kRootSize)
+            {
+                append(root_[expire & kRootMask], node);
+                return;
+            }
+            if (delta > kMaxDelta)
+            {
+                // 超出最高层的范围，先放到最远的slot，之后cascade时重新计算
+                expire = currentTick_ + kMaxDelta;
+            }
+            for (int level = 0; level < kLevels; level++)
+            {
+                int shift = kRootBits + (level + 1) * kLevelBits;
+                if (level == kLevels - 1 || delta < (uint64_t(1) << shift))
+                {
+                    auto idx = (expire >> (kRootBits + level * kLevelBits)) & kLevelMask;
+                    append(levels_[level][idx], node);
+                    return;
+                }
+            }
+        }
+
+        // 把上层slot中的timer重新分配到下层，返回该slot的下标
+        uint64_t cascade(int level, uint64_t idx)
+        {
+            auto &slot = levels_[level][idx];
+            while (!slot.empty())
+            {
+                auto node = slot.head.next;
+                unlink(node);
+                addNode(node);
+            }
+            return idx;
+        }
+
+        // 前进一个tick，把到期的timer移到expired中
+        void advance(Slot &expired)
+        {
+            auto index = currentTick_ & kRootMask;
+            if (index == 0)
+            {
+                for (int level = 0; level < kLevels; level++)
+                {
+                    auto idx = (currentTick_ >> (kRootBits + level * kLevelBits)) & kLevelMask;
+                    if (cascade(level, idx) != 0)
+                        break;
+                }
+            }
+            ++currentTick_;
+            auto &slot = root_[index];
+            while (!slot.empty())
+            {
+                auto node = slot.head.next;
+                unlink(node);
+                append(expired, node);
+            }
+        }
+
+        // 下一个需要处理的tick: 有timer到期的root slot，或者要cascade的非空上层slot。
+        // 在这之前的tick什么也不做，可以直接跳过
+        uint64_t nextEventTick() const
+        {
+            auto next = UINT64_MAX;
+            for (uint64_t i = 0; i < kRootSize; i++)
+            {
+                if (!root_[(currentTick_ + i) & kRootMask].empty())
+                {
+                    next = currentTick_ + i;
+                    break;
+                }
+            }
+            // level的slot在tick为2^shift的整数倍、且下标等于该slot时cascade，此时下层的下标都为0
+            for (int level = 0; level < kLevels; level++)
+            {
+                int shift = kRootBits + level * kLevelBits;
+                auto first = (currentTick_ + (uint64_t(1) << shift) - 1) >> shift;
+                for (uint64_t i = 0; i < kLevelSize && ((first + i) << shift) < next; i++)
+                {
+                    if (!levels_[level][(first + i) & kLevelMask].empty())
+                    {
+                        next = (first + i) << shift;
+                        break;
+                    }
+                }
+            }
+            return next;
+        }
+
+        void loop()
+        {
+            std::unique_lock lock(mutex_);
+            while (!stop_)
+            {
+                if (count_ == 0)
+                {
+                    cond_.wait(lock, [this]()
+                               { return stop_ || count_ > 0; });
+                    continue;
+                }
+                auto now = toTick(Clock::now());
+                auto next = nextEventTick();
+                if (next > now)
+                {
+                    // add()会唤醒loop重新计算
+                    cond_.wait_until(lock, start_ + tick_ * next);
+                    continue;
+                }
+                Slot expired;
+                while (currentTick_ <= now)
+                {
+                    next = nextEventTick();
+                    if (next > now)
+                    {
+                        currentTick_ = now + 1;
+                        break;
+                    }
+                    currentTick_ = next;
+                    advance(expired);
+                }
+                while (!expired.empty())
+                {
+                    auto node = expired.head.next;
+                    unlink(node);
+                    --count_;
+                    auto fn = std::move(node->fn);
+                    freeNode(node);
+                    lock.unlock();
+                    fn();
+                    lock.lock();
+                }
+            }
+        }
+
+    private:
+        Duration tick_;
+        Clock::time_point start_;
+        uint64_t currentTick_;
+        size_t count_;
+        std::array<Slot, kRootSize> root_;
+        std::array<std::array<Slot, kLevelSize>, kLevels> levels_;
+        TimerNode *freeList_;
+
+        bool stop_;
+        mutable std::mutex mutex_;
+        std::condition_variable cond_;
+        std::thread thread_;
+    };
+}
+
+#endif
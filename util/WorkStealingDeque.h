@@ -0,0 +1,177 @@
+/* A lock-free Chase-Lev work-stealing deque
+*/
+
+#ifndef ASYNC_FRAMEWORK_WORK_STEALING_DEQUE_H
+#define ASYNC_FRAMEWORK_WORK_STEALING_DEQUE_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include "../util/CacheLine.h"
+
+namespace async_framework::util
+{
+    // WorkStealingDeque implements the Chase-Lev deque described in
+    // "Correct and Efficient Work-Stealing for Weak Memory Models"
+    // (Le, Pop, Cohen, Zappa Nardelli, PPoPP'13).
+    //
+    // Only the owner thread may call push() and pop(), which operate on the
+    // bottom end of the deque. Any thread may call steal(), which takes
+    // elements from the top end. The underlying ring grows on demand; retired
+    // rings are kept until the deque is destroyed since a thief may still be
+    // reading from them.
+    //
+    // T is copied while racing with other thieves, so it must be trivially
+    // copyable. Store pointers for non-trivial payloads.
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    class WorkStealingDeque
+    {
+    private:
+        struct Array
+        {
+            explicit Array(int64_t capacity) : capacity_(capacity), mask_(capacity - 1), buffer_(new std::atomic<T>[capacity])
+            {
+                assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+            }
+
+            ~Array()
+            {
+                delete[] buffer_;
+            }
+
+            T get(int64_t i) const noexcept
+            {
+                return buffer_[i & mask_].load(std::memory_order_relaxed);
+            }
+
+            void put(int64_t i, T item) noexcept
+            {
+                buffer_[i & mask_].store(item, std::memory_order_relaxed);
+            }
+
+            Array *grow(int64_t bottom, int64_t top) const
+            {
+                auto array = new Array(capacity_ * 2);
+                for (auto i = top; i != bottom; ++i)
+                {
+                    array->put(i, get(i));
+                }
+                return array;
+            }
+
+            int64_t capacity_;
+            int64_t mask_;
+            std::atomic<T> *buffer_;
+        };
+
+    public:
+        // capacity必须是2的幂
+        explicit WorkStealingDeque(int64_t capacity = 1024) : top_(0), bottom_(0), array_(new Array(capacity))
+        {
+        }
+
+        ~WorkStealingDeque()
+        {
+            for (auto array : garbage_)
+            {
+                delete array;
+            }
+            delete array_.load(std::memory_order_relaxed);
+        }
+
+        WorkStealingDeque(const WorkStealingDeque &) = delete;
+        WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    public:
+        // Owner only.
+        void push(T item)
+        {
+            auto bottom = bottom_.load(std::memory_order_relaxed);
+            auto top = top_.load(std::memory_order_acquire);
+            auto array = array_.load(std::memory_order_relaxed);
+            if (bottom - top > array->capacity_ - 1)
+            {
+                garbage_.push_back(array);
+                array = array->grow(bottom, top);
+                array_.store(array, std::memory_order_release);
+            }
+            array->put(bottom, item);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom_.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        // Owner only. Return false if the deque is empty or the last element
+        // was taken by a thief.
+        bool pop(T &item)
+        {
+            auto bottom = bottom_.load(std::memory_order_relaxed) - 1;
+            auto array = array_.load(std::memory_order_relaxed);
+            bottom_.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto top = top_.load(std::memory_order_relaxed);
+            if (top > bottom)
+            {
+                bottom_.store(bottom + 1, std::memory_order_relaxed);
+                return false;
+            }
+            T tmp = array->get(bottom);
+            if (top == bottom)
+            {
+                // 只剩最后一个元素，需要和thief竞争
+                bool won = top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+                bottom_.store(bottom + 1, std::memory_order_relaxed);
+                if (!won)
+                    return false;
+            }
+            item = tmp;
+            return true;
+        }
+
+        // Any thread. Return false if the deque is empty or the race for the
+        // top element was lost.
+        bool steal(T &item)
+        {
+            auto top = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            auto bottom = bottom_.load(std::memory_order_acquire);
+            if (top >= bottom)
+            {
+                return false;
+            }
+            auto array = array_.load(std::memory_order_acquire);
+            T tmp = array->get(top);
+            if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                return false;
+            }
+            item = tmp;
+            return true;
+        }
+
+        // Approximate size, may be stale by the time it returns.
+        size_t size() const noexcept
+        {
+            auto bottom = bottom_.load(std::memory_order_relaxed);
+            auto top = top_.load(std::memory_order_relaxed);
+            return bottom > top ? static_cast<size_t>(bottom - top) : 0;
+        }
+
+        bool empty() const noexcept
+        {
+            return size() == 0;
+        }
+
+    private:
+        alignas(kCacheLineSize) std::atomic<int64_t> top_;
+        alignas(kCacheLineSize) std::atomic<int64_t> bottom_;
+        alignas(kCacheLineSize) std::atomic<Array *> array_;
+        // 只有owner线程会访问
+        std::vector<Array *> garbage_;
+    };
+}
+
+#endif
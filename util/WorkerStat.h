@@ -0,0 +1,179 @@
+/* Lock-free per-worker statistics
+*/
+
+#ifndef ASYNC_FRAMEWORK_WORKER_STAT_H
+#define ASYNC_FRAMEWORK_WORKER_STAT_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "../util/CacheLine.h"
+
+namespace async_framework::util
+{
+    inline uint64_t steadyNowNs() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // A copy of LatencyHistogram taken by snapshot(). Values are in
+    // nanoseconds.
+    struct HistogramSnapshot
+    {
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t max = 0;
+
+        double mean() const
+        {
+            return count ? static_cast<double>(sum) / count : 0;
+        }
+
+        // p in [0, 1]. Return the upper bound of the bucket holding the p-th
+        // value, so the error is bounded by the bucket width (1/8 of the value).
+        uint64_t percentile(double p) const;
+
+        void merge(const HistogramSnapshot &other)
+        {
+            if (buckets.size() < other.buckets.size())
+                buckets.resize(other.buckets.size());
+            for (size_t i = 0; i < other.buckets.size(); i++)
+                buckets[i] += other.buckets[i];
+            count += other.count;
+            sum += other.sum;
+            max = (std::max)(max, other.max);
+        }
+    };
+
+    // LatencyHistogram is an HDR-style log-linear histogram. Values below 8
+    // get their own bucket, each power-of-two range above is split into 8
+    // linear sub buckets, which keeps the relative error under 12.5% across
+    // [0, 2^48) ns with a fixed 368 buckets.
+    //
+    // record() must only be called by a single writer (the owning worker).
+    // It uses plain relaxed load/store instead of RMW so it costs no more
+    // than a few cache hits. snapshot() may be called by any thread at any
+    // time and may observe a slightly inconsistent view.
+    class LatencyHistogram
+    {
+    public:
+        static constexpr uint32_t kSubBucketBits = 3;
+        static constexpr uint32_t kSubBuckets = 1 << kSubBucketBits;
+        static constexpr uint32_t kMaxBits = 48;
+        static constexpr uint32_t kBucketCount = (kMaxBits - kSubBucketBits + 1) * kSubBuckets;
+
+        static uint32_t bucketOf(uint64_t value) noexcept
+        {
+            if (value < kSubBuckets)
+                return static_cast<uint32_t>(value);
+            uint32_t exp = std::bit_width(value) - 1;
+            if (exp >= kMaxBits)
+                return kBucketCount - 1;
+            auto sub = static_cast<uint32_t>(value >> (exp - kSubBucketBits)) & (kSubBuckets - 1);
+            return (exp - kSubBucketBits + 1) * kSubBuckets + sub;
+        }
+
+        static uint64_t bucketLowerBound(uint32_t index) noexcept
+        {
+            if (index < kSubBuckets)
+                return index;
+            uint32_t exp = index / kSubBuckets + kSubBucketBits - 1;
+            uint64_t sub = index % kSubBuckets;
+            return (kSubBuckets + sub) << (exp - kSubBucketBits);
+        }
+
+        void record(uint64_t value) noexcept
+        {
+            bump(buckets_[bucketOf(value)], 1);
+            bump(count_, 1);
+            bump(sum_, value);
+            if (value > max_.load(std::memory_order_relaxed))
+                max_.store(value, std::memory_order_relaxed);
+        }
+
+        HistogramSnapshot snapshot() const
+        {
+            HistogramSnapshot snap;
+            snap.buckets.resize(kBucketCount);
+            for (uint32_t i = 0; i < kBucketCount; i++)
+                snap.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+            snap.count = count_.load(std::memory_order_relaxed);
+            snap.sum = sum_.load(std::memory_order_relaxed);
+            snap.max = max_.load(std::memory_order_relaxed);
+            return snap;
+        }
+
+    private:
+        static void bump(std::atomic<uint64_t> &counter, uint64_t n) noexcept
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+
+        std::array<std::atomic<uint64_t>, kBucketCount> buckets_{};
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> sum_{0};
+        std::atomic<uint64_t> max_{0};
+    };
+
+    inline uint64_t HistogramSnapshot::percentile(double p) const
+    {
+        if (count == 0)
+            return 0;
+        auto target = static_cast<uint64_t>(p * count);
+        if (target == 0)
+            target = 1;
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < buckets.size(); i++)
+        {
+            seen += buckets[i];
+            if (seen >= target)
+                return (std::min)(max, LatencyHistogram::bucketLowerBound(i + 1) - 1);
+        }
+        return max;
+    }
+
+    // Live counters of one worker, written only by that worker. Padded to a
+    // cache line so that workers never share a line.
+    struct alignas(kCacheLineSize) WorkerCounters
+    {
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> stolen{0};
+        // 从提交到开始执行的时间
+        LatencyHistogram queueLatency;
+        // 任务执行时间
+        LatencyHistogram runTime;
+
+        void onSteal() noexcept
+        {
+            stolen.store(stolen.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        void onExecuted(uint64_t enqueueNs, uint64_t startNs, uint64_t endNs) noexcept
+        {
+            queueLatency.record(startNs > enqueueNs ? startNs - enqueueNs : 0);
+            runTime.record(endNs - startNs);
+            executed.store(executed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    };
+
+    // A snapshot of one worker.
+    struct WorkerStat
+    {
+        int32_t id = -1;
+        // worker所在的NUMA node编号
+        uint32_t node = 0;
+        size_t pendingTaskCount = 0;
+        uint64_t executedTaskCount = 0;
+        uint64_t stealCount = 0;
+        HistogramSnapshot queueLatency;
+        HistogramSnapshot runTime;
+    };
+}
+
+#endif
@@ -5,13 +5,23 @@
 #define ASYNC_FRAMEWORK_MOVE_ONLY_FUNCTION
 
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <new>
 #include <type_traits>
+#include <utility>
+
+// 调度路径上任务类型(TaskFunc)的内联缓冲大小，编译时可以重新定义
+#ifndef ASYNC_FRAMEWORK_TASK_INLINE_SIZE
+#define ASYNC_FRAMEWORK_TASK_INLINE_SIZE 48
+#endif
 
 namespace async_framework::util
 {
-    template <typename Signature>
+    // InlineSize是内联缓冲的大小，不超过InlineSize且能nothrow移动的callable
+    // 直接存放在内联缓冲中，否则在堆上分配
+    template <typename Signature, size_t InlineSize = 2 * sizeof(void *)>
     class move_only_function;
 
     namespace detail
@@ -59,7 +69,8 @@ namespace async_framework::util
         };
 
         // union也是一种类类型
-        // _any_data至少是8Bytes(64位)，4Bytes(32位)，为了实现对齐，有可能会更大。
+        // _any_data至少能容纳_no_copy_types，Size更大时按Size分配内联缓冲
+        template <size_t Size>
         union [[gnu::may_alias]] _any_data
         {
             void *_m_access() { return &_m_pod_data[0]; }
@@ -77,75 +88,109 @@ namespace async_framework::util
             // data member
             // _m_unused 要求编译器满足alignment requirement
             _no_copy_types _m_unused;
-            char _m_pod_data[sizeof(_no_copy_types)];
+            char _m_pod_data[Size < sizeof(_no_copy_types) ? sizeof(_no_copy_types) : Size];
         };
 
         enum class _manager_operation : uint8_t
         {
             _destroy_functor,
+            // 把source中的functor移动到未初始化的dest中，并析构source中的functor
+            _move_functor,
         };
 
+        template <size_t Size>
         class _function_base
         {
         public:
-            static constexpr size_t _m_max_size = sizeof(_no_copy_types);
-            static constexpr size_t _m_max_align = alignof(_no_copy_types);
+            using _any_data_type = _any_data<Size>;
+            static constexpr size_t _m_max_size = sizeof(_any_data_type);
+            static constexpr size_t _m_max_align = alignof(_any_data_type);
             template <typename Functor>
             class _base_manager
             {
             protected:
-                satic const bool _stored_locally = std::is_trivially_copyable_v<Funtor> &&
-                                                   sizeof(Functor) <= _m_max_size &&
-                                                   alignof(Functor) <= _m_max_align &&
-                                                   (_m_max_align % alignof(Functor) == 0);
-                // 当_local_storage()为true时，在预分配的栈空间_any_data中存储Functor，否则在堆上存储Functor，_any_data中存储指向Functor的指针
+                // 当_local_storage()为true时，在预分配的内联缓冲_any_data中存储Functor，否则在堆上存储Functor，_any_data中存储指向Functor的指针
+                // 内联存储的Functor在move_only_function移动时需要移动构造，因此要求nothrow移动
+                static constexpr bool _stored_locally = std::is_nothrow_move_constructible_v<Functor> &&
+                                                        sizeof(Functor) <= _m_max_size &&
+                                                        alignof(Functor) <= _m_max_align &&
+                                                        (_m_max_align % alignof(Functor) == 0);
 
                 using _local_storage = std::integral_constant<bool, _stored_locally>;
-                static Functor *_m_get_pointer(const _any_data &_source)
+                static Functor *_m_get_pointer(const _any_data_type &_source)
                 {
                     if constexpr (_stored_locally)
                     {
-                        const Functor &f = _source._m_access<Functor>();
+                        const Functor &f = _source.template _m_access<Functor>();
                         return const_cast<Functor *>(std::addressof(f));
                     }
-                    return _source._m_access<Functor *>();
+                    else
+                    {
+                        return _source.template _m_access<Functor *>();
+                    }
                 }
 
                 /*Local Storage*/
-                static void _m_destroy(_any_data &_victim, std::true_type)
+                static void _m_destroy(_any_data_type &_victim, std::true_type)
+                {
+                    _victim.template _m_access<Functor>().~Functor();
+                }
+
+                static void _m_destroy(_any_data_type &_victim, std::false_type)
                 {
-                    _victim._m_access<Functor>().~Functor();
+                    delete _victim.template _m_access<Functor *>();
                 }
 
-                static void _m_destroy(_any_data &_victim, std::false_type)
+                static void _m_move(_any_data_type &_dest, _any_data_type &_source, std::true_type)
                 {
-                    delete _victim._m_access<Functor *>();
+                    auto &f = _source.template _m_access<Functor>();
+                    ::new (_dest._m_access()) Functor(std::move(f));
+                    f.~Functor();
+                }
+
+                // 堆上存储时只需要移动指针
+                static void _m_move(_any_data_type &_dest, _any_data_type &_source, std::false_type)
+                {
+                    _dest.template _m_access<Functor *>() = _source.template _m_access<Functor *>();
                 }
 
             public:
-                static void _m_manager(_any_data &_dest, _any_data &source, _manager_operation _op)
+                static void _m_manager(_any_data_type &_dest, _any_data_type &_source, _manager_operation _op)
                 {
-                    switch (_manager_operation)
+                    switch (_op)
                     {
                     case _manager_operation::_destroy_functor:
                         _m_destroy(_dest, _local_storage());
                         break;
+                    case _manager_operation::_move_functor:
+                        _m_move(_dest, _source, _local_storage());
+                        break;
                     }
                 }
 
-                static void _m_init_functor(_any_data &_functor, Functor &&_f)
+                // 在functor的_m_pod_data构造f，放不下时在堆上构造
+                template <typename Fn>
+                static void _m_init_functor(_any_data_type &_functor, Fn &&_f)
                 {
-                    _m_init_functor(functor, std::move(_functor), _local_storage());
+                    if constexpr (_stored_locally)
+                    {
+                        ::new (_functor._m_access()) Functor(std::forward<Fn>(_f));
+                    }
+                    else
+                    {
+                        _functor.template _m_access<Functor *>() = new Functor(std::forward<Fn>(_f));
+                    }
                 }
 
-                static void _m_init_functor(_any_data &_functor, const Functor &_f)
+                // 实现非空函数判断：1、move_only_function和std::function, 2、函数指针，3、其它类型。
+                template <typename Signature, size_t N>
+                static bool _m_not_empty_function(const move_only_function<Signature, N> &f)
                 {
-                    _m_init_functor(_functor, f, _local_storage());
+                    return static_cast<bool>(f);
                 }
 
-                // 实现非空函数判断：1、move_only_function, 2、函数指针，3、其它类型。
                 template <typename Signature>
-                static bool _m_not_empty_function(const move_only_function<Signature> &f)
+                static bool _m_not_empty_function(const std::function<Signature> &f)
                 {
                     return static_cast<bool>(f);
                 }
@@ -161,31 +206,6 @@ namespace async_framework::util
                 {
                     return true;
                 }
-
-            private:
-                // 在functor的_m_pod_data构造f
-                // 在栈上构造
-                static void _m_init_functor(_any_data &functor, Functor &&f, std::true_type)
-                {
-                    ::new (functor._m_access()) Functor(f);
-                }
-                // 在堆上构造
-                // _any_data为一个指针的大小，如果f不大于一个指针大小，存储在栈上
-                // 否则_any_data存储指向f的指针
-                static void _m_init_functor(_any_data &functor, Functor &&f, std::false_type)
-                {
-                    functor._m_access<Functor *>() = new Functor(std::move(f));
-                }
-
-                static void _m_init_functor(_any_data &functor, const Functor &f, std::true_type)
-                {
-                    ::new (functor._m_access()) Functor(f);
-                }
-
-                static void _m_init_functor(_any_data &functor, const Functor &f, std::false_type)
-                {
-                    functor._m_access<Functor *> = new Functor(f);
-                }
             };
 
             _function_base() : _m_manager(nullptr) {}
@@ -198,26 +218,27 @@ namespace async_framework::util
             }
             bool _m_empty() const { return !_m_manager; }
 
-            using manger_type = void (*)(_any_data &, const _any_data &, _manager_operation);
-            _any_data _m_functor;
-            manger_type _m_manager;
+            using manager_type = void (*)(_any_data_type &, _any_data_type &, _manager_operation);
+            _any_data_type _m_functor;
+            manager_type _m_manager;
         };
 
-        template <typename Signature, typename Functor>
+        template <typename Signature, size_t Size, typename Functor>
         class FunctionHandler;
 
-        template <typename Res, typename Functor, typename... ArgTypes>
-        class FunctionHandler<Res(ArgTypes...), Functor> : public _function_base::_base_manager<Functor>
+        template <typename Res, size_t Size, typename Functor, typename... ArgTypes>
+        class FunctionHandler<Res(ArgTypes...), Size, Functor> : public _function_base<Size>::template _base_manager<Functor>
         {
-            using BaseType = _function_base::_base_manager<Functor>;
+            using BaseType = typename _function_base<Size>::template _base_manager<Functor>;
+            using _any_data_type = _any_data<Size>;
 
         public:
-            static void _m_manager(_any_data &_dest, const _any_data &_source, _manager_operation _op)
+            static void _m_manager(_any_data_type &_dest, _any_data_type &_source, _manager_operation _op)
             {
                 return BaseType::_m_manager(_dest, _source, _op);
             }
 
-            static Res _m_invoke(const _any_data &_functor, ArgTypes &&..._args)
+            static Res _m_invoke(const _any_data_type &_functor, ArgTypes &&..._args)
             {
                 if constexpr (std::is_same_v<Res, void>)
                 {
@@ -229,21 +250,16 @@ namespace async_framework::util
                 }
             }
         };
-
-        template <>
-        class FunctionHandler<void, void>
-        {
-        public:
-            static void _m_manager(_any_data &, const _any_data &, _manager_operation)
-            {
-                return;
-            }
-        };
     } // namespace detail
 
-    template <typename RetType, typename... ArgTypes>
-    class move_only_function<RetType(ArgTypes...)> : private detail::_function_base
+    template <typename RetType, size_t InlineSize, typename... ArgTypes>
+    class move_only_function<RetType(ArgTypes...), InlineSize> : private detail::_function_base<InlineSize>
     {
+        using BaseType = detail::_function_base<InlineSize>;
+        using BaseType::_m_empty;
+        using BaseType::_m_functor;
+        using BaseType::_m_manager;
+
         template <typename Func, typename Res2 = std::invoke_result<Func, ArgTypes...>>
         struct NotMoveOnlyCallable : public detail::RetTypeCheck<Res2, RetType>::type
         {
@@ -270,30 +286,37 @@ namespace async_framework::util
 
     public:
         using result_type = RetType;
+        static constexpr size_t inline_size = BaseType::_m_max_size;
+
         // 默认构造函数创建一个空的function call wrapper
-        move_only_function() noexcept : _function_base() {}
+        move_only_function() noexcept : BaseType(), _m_invoker(nullptr) {}
 
-        move_only_function(std::nullptr_t) noexcept : _function_base() {}
+        move_only_function(std::nullptr_t) noexcept : BaseType(), _m_invoker(nullptr) {}
 
         // delete 拷贝构造函数
         move_only_function(const move_only_function &) = delete;
 
-        move_only_function(move_only_function &&other) noexcept : _function_base()
+        move_only_function(move_only_function &&other) noexcept : BaseType(), _m_invoker(nullptr)
         {
-            other.swap(*this);
+            if (other._m_manager)
+            {
+                other._m_manager(_m_functor, other._m_functor, detail::_manager_operation::_move_functor);
+                _m_manager = std::exchange(other._m_manager, nullptr);
+                _m_invoker = std::exchange(other._m_invoker, nullptr);
+            }
         }
 
         template <typename Functor,
-                  typename = Requires<std::negation<std::is_same<std::remove_reference_t<Functor>, move_only_function>>, void>,
+                  typename = Requires<std::negation<std::is_same<std::decay_t<Functor>, move_only_function>>, void>,
                   typename = Requires<std::negation<IsCStyleFunction<Functor>>, void>,
                   typename = Requires<NotMoveOnlyCallable<Functor>, void>>
-        move_only_function(Functor &&f) : _function_base()
+        move_only_function(Functor &&f) : BaseType(), _m_invoker(nullptr)
         {
-            using MyHandler = detail::FunctionHandler<RetType(ArgTypes...), std::remove_reference_t<Functor>>;
+            using MyHandler = detail::FunctionHandler<RetType(ArgTypes...), InlineSize, std::decay_t<Functor>>;
             if (MyHandler::_m_not_empty_function(f))
             {
-                MyHandler::m_init_function(_m_functor, std::forward<Functor>(f));
-                _m_invoker = &MyHandler::m_invoke;
+                MyHandler::_m_init_functor(_m_functor, std::forward<Functor>(f));
+                _m_invoker = &MyHandler::_m_invoke;
                 _m_manager = &MyHandler::_m_manager;
             }
         }
@@ -301,9 +324,9 @@ namespace async_framework::util
         // fix error: invalid application of 'sizeof' to a function type
         // [-Werror=pointer-arith]
         template <typename Res, typename... Args>
-        move_only_function(Res (&f)(Args...)) : _function_base()
+        move_only_function(Res (&f)(Args...)) : BaseType(), _m_invoker(nullptr)
         {
-            using MyHandler = detail::FunctionHandler<RetType(ArgTypes...), Res (*)(Args...)>;
+            using MyHandler = detail::FunctionHandler<RetType(ArgTypes...), InlineSize, Res (*)(Args...)>;
             if (MyHandler::_m_not_empty_function(&f))
             {
                 MyHandler::_m_init_functor(_m_functor, &f);
@@ -313,7 +336,7 @@ namespace async_framework::util
         }
 
         move_only_function &operator=(const move_only_function &) = delete;
-        move_only_function &operator=(move_only_function &&other)
+        move_only_function &operator=(move_only_function &&other) noexcept
         {
             move_only_function(std::move(other)).swap(*this);
             return *this;
@@ -338,9 +361,18 @@ namespace async_framework::util
             return *this;
         }
 
+        // 内联存储的functor不一定可以按字节拷贝，需要通过manager移动
         void swap(move_only_function &other) noexcept
         {
-            std::swap(_m_functor, other._m_functor);
+            if (this == &other)
+                return;
+            typename BaseType::_any_data_type tmp;
+            if (other._m_manager)
+                other._m_manager(tmp, other._m_functor, detail::_manager_operation::_move_functor);
+            if (_m_manager)
+                _m_manager(other._m_functor, _m_functor, detail::_manager_operation::_move_functor);
+            if (other._m_manager)
+                other._m_manager(_m_functor, tmp, detail::_manager_operation::_move_functor);
             std::swap(_m_manager, other._m_manager);
             std::swap(_m_invoker, other._m_invoker);
         }
@@ -361,7 +393,7 @@ namespace async_framework::util
         }
 
     private:
-        using InvokerType = RetType (*)(const detail::_any_data &, ArgTypes &&...);
+        using InvokerType = RetType (*)(const typename BaseType::_any_data_type &, ArgTypes &&...);
         InvokerType _m_invoker;
     };
 
@@ -400,18 +432,24 @@ namespace async_framework::util
     template <typename Functor, typename Signature = typename detail::_move_only_function_guide_helper<decltype(&Functor::operator())>::type>
     move_only_function(Functor) -> move_only_function<Signature>;
 
-    template <typename Res, typename... Args>
-    inline void swap(move_only_function<Res(Args...)> &_x, move_only_function<Res(Args...)> &_y) noexcept
+    template <typename Res, size_t N, typename... Args>
+    inline void swap(move_only_function<Res(Args...), N> &_x, move_only_function<Res(Args...), N> &_y) noexcept
     {
         _x.swap(_y);
     }
 
-    template <typename Res, typename... Args>
-    inline bool operator==(const move_only_function<Res(Args...)> &f, std::nullptr_t) noexcept
+    template <typename Res, size_t N, typename... Args>
+    inline bool operator==(const move_only_function<Res(Args...), N> &f, std::nullptr_t) noexcept
     {
-        return !static_assert<bool>(f);
+        return !static_cast<bool>(f);
     }
 
+    inline constexpr size_t kTaskInlineSize = ASYNC_FRAMEWORK_TASK_INLINE_SIZE;
+
+    // 调度路径上使用的任务类型。大多数协程恢复、continuation的闭包都能放进内联缓冲，
+    // 提交任务时不需要分配内存
+    using TaskFunc = move_only_function<void(), kTaskInlineSize>;
+
 } // namespace async_framework::util
 
-#endif
\ No newline at end of file
+#endif